@@ -0,0 +1,123 @@
+#include "bench-common.h"
+
+#include "internal.h"
+
+static void
+noop_seat_capabilities(void* data, uint32_t capabilities)
+{
+  UNUSED(data);
+  UNUSED(capabilities);
+}
+
+static void
+noop_pointer_enter(void* data, struct zsurf_view* view, float x, float y)
+{
+  UNUSED(data);
+  UNUSED(view);
+  UNUSED(x);
+  UNUSED(y);
+}
+
+static void
+noop_pointer_motion(void* data, uint32_t time, float x, float y)
+{
+  UNUSED(data);
+  UNUSED(time);
+  UNUSED(x);
+  UNUSED(y);
+}
+
+static void
+noop_pointer_leave(void* data, struct zsurf_view* view)
+{
+  UNUSED(data);
+  UNUSED(view);
+}
+
+static void
+noop_pointer_button(void* data, uint32_t serial, uint32_t time,
+    uint32_t button, enum zsurf_pointer_button_state state)
+{
+  UNUSED(data);
+  UNUSED(serial);
+  UNUSED(time);
+  UNUSED(button);
+  UNUSED(state);
+}
+
+static void
+noop_keyboard_keymap(void* data, struct zsurf_keymap* keymap)
+{
+  UNUSED(data);
+  UNUSED(keymap);
+}
+
+static void
+noop_keyboard_enter(void* data, uint32_t serial, struct zsurf_view* view,
+    uint32_t* keys, uint32_t key_count)
+{
+  UNUSED(data);
+  UNUSED(serial);
+  UNUSED(view);
+  UNUSED(keys);
+  UNUSED(key_count);
+}
+
+static void
+noop_keyboard_leave(void* data, uint32_t serial, struct zsurf_view* view)
+{
+  UNUSED(data);
+  UNUSED(serial);
+  UNUSED(view);
+}
+
+static void
+noop_keyboard_key(
+    void* data, uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
+{
+  UNUSED(data);
+  UNUSED(serial);
+  UNUSED(time);
+  UNUSED(key);
+  UNUSED(state);
+}
+
+static void
+noop_keyboard_modifiers(void* data, uint32_t serial, uint32_t mods_depressed,
+    uint32_t mods_latched, uint32_t mods_locked, uint32_t group)
+{
+  UNUSED(data);
+  UNUSED(serial);
+  UNUSED(mods_depressed);
+  UNUSED(mods_latched);
+  UNUSED(mods_locked);
+  UNUSED(group);
+}
+
+static void
+startup_ready(void* data, bool success)
+{
+  bool* ready = data;
+  UNUSED(success);
+  *ready = true;
+}
+
+const struct zsurf_display_interface bench_display_interface = {
+    .seat_capabilities = noop_seat_capabilities,
+    .pointer_enter = noop_pointer_enter,
+    .pointer_motion = noop_pointer_motion,
+    .pointer_leave = noop_pointer_leave,
+    .pointer_button = noop_pointer_button,
+    .keyboard_keymap = noop_keyboard_keymap,
+    .keyboard_enter = noop_keyboard_enter,
+    .keyboard_leave = noop_keyboard_leave,
+    .keyboard_key = noop_keyboard_key,
+    .keyboard_modifiers = noop_keyboard_modifiers,
+    .ready = startup_ready,
+};
+
+void
+bench_sync(struct zsurf_display* surface_display)
+{
+  wl_display_roundtrip(surface_display->display);
+}
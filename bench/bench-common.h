@@ -0,0 +1,16 @@
+#ifndef ZSURFACE_BENCH_COMMON_H
+#define ZSURFACE_BENCH_COMMON_H
+
+#include <zsurface.h>
+
+/**
+ * ignores every event; ready expects a bool* as the user data
+ */
+extern const struct zsurf_display_interface bench_display_interface;
+
+/**
+ * wait until the compositor has handled every request sent so far
+ */
+void bench_sync(struct zsurf_display* surface_display);
+
+#endif  //  ZSURFACE_BENCH_COMMON_H
@@ -0,0 +1,863 @@
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsurface.h>
+
+#include "bench-common.h"
+#include "internal.h"
+#include "mock.h"
+
+#define BENCH_MAX_SAMPLES 100000
+#define BENCH_WARMUP_BATCHES 8
+
+struct bench {
+  struct zsurf_mock* mock;
+  struct zsurf_display* display;
+  const char* socket;
+  const char* filter;  // nullable, substring of the case names to run
+  uint64_t budget_ns;  // measuring time per case
+  FILE* out;
+  int result_count;
+  uint64_t* samples;
+};
+
+struct bench_case {
+  const char* name;
+  uint32_t batch;         // ops per timed sample
+  uint64_t bytes_per_op;  // 0 if not a throughput case
+  void (*setup)(void* data);     // nullable, untimed, before each sample
+  void (*op)(void* data);        // timed
+  void (*teardown)(void* data);  // nullable, untimed, after each sample
+};
+
+struct bench_texture {
+  struct bench* bench;
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_color_bgra* pixels;
+  uint32_t width, height;
+};
+
+struct bench_convert {
+  struct bench* bench;
+  struct zsurf_toplevel* toplevel;
+  enum zsurf_pixel_format format;
+  enum zsurf_yuv_format yuv_format;
+  uint8_t* pixels;
+  uint32_t width, height;
+};
+
+struct bench_icons {
+  struct bench* bench;
+  struct zsurf_view** views;
+  uint32_t count;
+  struct zsurf_color_bgra* pixels;
+  uint32_t size;
+  uint32_t next;
+  bool atlas;
+  struct zsurf_batch* batch;  // nullable, quads instead of views
+};
+
+struct bench_toplevel {
+  struct bench* bench;
+  struct zsurf_toplevel* toplevel;  // nullable
+  bool pooled;
+};
+
+struct bench_startup {
+  struct bench* bench;
+  struct zsurf_display* display;  // nullable
+  bool async;
+};
+
+static void
+frame_done(void* data, uint32_t callback_time)
+{
+  bool* done = data;
+  UNUSED(callback_time);
+  *done = true;
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static void
+bench_run(struct bench* bench, const struct bench_case* c, void* data)
+{
+  struct zsurf_mock_stats stats;
+  uint64_t start, elapsed, total = 0, sum = 0;
+  uint32_t count = 0;
+
+  if (bench->filter && strstr(c->name, bench->filter) == NULL) return;
+
+  for (int i = 0; i < BENCH_WARMUP_BATCHES; i++) {
+    if (c->setup) c->setup(data);
+    for (uint32_t j = 0; j < c->batch; j++) c->op(data);
+    if (c->teardown) c->teardown(data);
+  }
+
+  bench_sync(bench->display);
+  zsurf_mock_reset_stats(bench->mock);
+
+  // one sample at least, whatever the budget
+  while (count == 0 ||
+         (total < bench->budget_ns && count < BENCH_MAX_SAMPLES)) {
+    if (c->setup) c->setup(data);
+
+    start = zsurf_get_time_ns();
+    for (uint32_t j = 0; j < c->batch; j++) c->op(data);
+    elapsed = zsurf_get_time_ns() - start;
+
+    if (c->teardown) c->teardown(data);
+
+    bench->samples[count++] = elapsed / c->batch;
+    sum += elapsed;
+    total += elapsed;
+  }
+
+  // requests still in flight are counted for this case
+  bench_sync(bench->display);
+  zsurf_mock_get_stats(bench->mock, &stats);
+
+  qsort(bench->samples, count, sizeof *bench->samples, compare_u64);
+
+  uint64_t ops = (uint64_t)count * c->batch;
+  double ns_per_op = (double)sum / ops;
+
+  fprintf(bench->out,
+      "%s\n    {\"name\": \"%s\", \"ops\": %" PRIu64
+      ", \"ns_per_op\": %.1f, \"min_ns\": %" PRIu64 ", \"p50_ns\": %" PRIu64
+      ", \"p99_ns\": %" PRIu64 ", \"requests_per_op\": %.2f",
+      bench->result_count == 0 ? "" : ",", c->name, ops, ns_per_op,
+      bench->samples[0], bench->samples[count / 2],
+      bench->samples[(uint64_t)count * 99 / 100],
+      (double)stats.requests / ops);
+  if (c->bytes_per_op)
+    fprintf(bench->out, ", \"bytes_per_second\": %.0f",
+        (double)c->bytes_per_op * 1e9 / ns_per_op);
+  fprintf(bench->out, "}");
+  fflush(bench->out);
+
+  bench->result_count++;
+}
+
+static struct zsurf_toplevel*
+bench_create_toplevel(struct bench* bench, uint32_t width, uint32_t height)
+{
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_color_bgra* pixels;
+  struct zsurf_view* view;
+
+  toplevel = zsurf_toplevel_create(bench->display, NULL);
+  if (toplevel == NULL) return NULL;
+
+  pixels = calloc((size_t)width * height, sizeof *pixels);
+  view = zsurf_toplevel_get_view(toplevel);
+  zsurf_view_set_texture(view, pixels, width, height);
+  zsurf_view_commit(view);
+  free(pixels);
+
+  // receive the configure of the cuboid window
+  bench_sync(bench->display);
+  bench_sync(bench->display);
+
+  return toplevel;
+}
+
+static void
+texture_set(void* data)
+{
+  struct bench_texture* texture = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(texture->toplevel);
+
+  zsurf_view_set_texture(
+      view, texture->pixels, texture->width, texture->height);
+  zsurf_display_flush(texture->bench->display);
+}
+
+/**
+ * one line of a terminal, scrolled in place and the new line drawn
+ */
+static void
+texture_scroll(void* data)
+{
+  struct bench_texture* texture = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(texture->toplevel);
+  struct zsurf_rect rect = {0, 0, texture->width, texture->height};
+  struct zsurf_color_bgra* buffer;
+  uint32_t line = 16;
+
+  zsurf_view_scroll(view, &rect, -(int32_t)line);
+  buffer =
+      zsurf_view_get_texture_buffer(view, texture->width, texture->height);
+  memcpy(buffer + (size_t)(texture->height - line) * texture->width,
+      texture->pixels, (size_t)line * texture->width * sizeof *buffer);
+  zsurf_display_flush(texture->bench->display);
+}
+
+static void
+texture_layer_setup(void* data)
+{
+  struct bench_texture* texture = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(texture->toplevel);
+
+  // the background, uploaded once
+  zsurf_view_set_texture_layer(
+      view, 0, texture->pixels, texture->width, texture->height);
+  bench_sync(texture->bench->display);
+}
+
+static void
+texture_layer_set(void* data)
+{
+  struct bench_texture* texture = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(texture->toplevel);
+
+  zsurf_view_set_texture_layer(
+      view, 1, texture->pixels, texture->width, texture->height);
+  zsurf_display_flush(texture->bench->display);
+}
+
+static void
+texture_sync(void* data)
+{
+  struct bench_texture* texture = data;
+  bench_sync(texture->bench->display);
+}
+
+static void
+texture_grow_setup(void* data)
+{
+  struct bench_texture* texture = data;
+
+  // a fresh view has a 1px backing store
+  texture->toplevel = zsurf_toplevel_create(texture->bench->display, NULL);
+}
+
+static void
+texture_grow_teardown(void* data)
+{
+  struct bench_texture* texture = data;
+
+  zsurf_toplevel_destroy(texture->toplevel);
+  texture->toplevel = NULL;
+  bench_sync(texture->bench->display);
+}
+
+static void
+texture_shrink_setup(void* data)
+{
+  struct bench_texture* texture = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(texture->toplevel);
+
+  // the backing store keeps the larger capacity from the first sample on
+  zsurf_view_set_texture(
+      view, texture->pixels, texture->width * 2, texture->height * 2);
+  bench_sync(texture->bench->display);
+}
+
+static void
+bench_texture(struct bench* bench)
+{
+  static const uint32_t sizes[][2] = {
+      {64, 64}, {256, 256}, {1024, 1024}, {2048, 2048}};
+  struct bench_texture texture = {.bench = bench};
+  uint64_t bytes;
+  char name[64];
+
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+    texture.width = sizes[i][0];
+    texture.height = sizes[i][1];
+    bytes = (uint64_t)texture.width * texture.height * sizeof *texture.pixels;
+
+    // room for the doubled size of the shrink case
+    texture.pixels = calloc(
+        (size_t)texture.width * texture.height * 4, sizeof *texture.pixels);
+    if (texture.pixels == NULL) continue;
+
+    texture.toplevel = bench_create_toplevel(bench, 1, 1);
+    if (texture.toplevel == NULL) {
+      free(texture.pixels);
+      continue;
+    }
+
+    snprintf(name, sizeof name, "set_texture/%ux%u", texture.width,
+        texture.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            .bytes_per_op = bytes,
+            .op = texture_set,
+            .teardown = texture_sync},
+        &texture);
+
+    snprintf(
+        name, sizeof name, "scroll/%ux%u", texture.width, texture.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            .bytes_per_op = bytes,
+            .op = texture_scroll,
+            .teardown = texture_sync},
+        &texture);
+
+    snprintf(
+        name, sizeof name, "set_layer/%ux%u", texture.width, texture.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            .bytes_per_op = bytes,
+            .setup = texture_layer_setup,
+            .op = texture_layer_set,
+            .teardown = texture_sync},
+        &texture);
+
+    snprintf(name, sizeof name, "resize/shrink/%ux%u", texture.width,
+        texture.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            .bytes_per_op = bytes,
+            .setup = texture_shrink_setup,
+            .op = texture_set,
+            .teardown = texture_sync},
+        &texture);
+
+    zsurf_toplevel_destroy(texture.toplevel);
+    texture.toplevel = NULL;
+
+    snprintf(
+        name, sizeof name, "resize/grow/%ux%u", texture.width, texture.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            .bytes_per_op = bytes,
+            .setup = texture_grow_setup,
+            .op = texture_set,
+            .teardown = texture_grow_teardown},
+        &texture);
+
+    free(texture.pixels);
+  }
+}
+
+static const struct {
+  enum zsurf_pixel_format format;
+  const char* name;
+} bench_pixel_formats[] = {
+    {ZSURF_PIXEL_FORMAT_BGRA8888, "bgra8888"},
+    {ZSURF_PIXEL_FORMAT_RGBA8888, "rgba8888"},
+    {ZSURF_PIXEL_FORMAT_RGB888, "rgb888"},
+    {ZSURF_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED, "rgba8888_premultiplied"},
+    {ZSURF_PIXEL_FORMAT_BGRX8888, "bgrx8888"},
+    {ZSURF_PIXEL_FORMAT_RGB565, "rgb565"},
+    {ZSURF_PIXEL_FORMAT_R8, "r8"},
+};
+
+#define BENCH_PIXEL_FORMAT_COUNT \
+  (sizeof bench_pixel_formats / sizeof *bench_pixel_formats)
+
+static void
+convert_set(void* data)
+{
+  struct bench_convert* convert = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(convert->toplevel);
+
+  zsurf_view_set_texture_format(view, convert->pixels, convert->format, 0,
+      convert->width, convert->height);
+  zsurf_display_flush(convert->bench->display);
+}
+
+static void
+convert_set_yuv(void* data)
+{
+  struct bench_convert* convert = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(convert->toplevel);
+  uint32_t luma = convert->width * convert->height;
+  const uint8_t* planes[3] = {convert->pixels, convert->pixels + luma,
+      convert->pixels + luma + luma / 4};
+  uint32_t strides[3] = {convert->width, convert->width / 2,
+      convert->width / 2};
+
+  if (convert->yuv_format == ZSURF_YUV_FORMAT_NV12)
+    strides[1] = convert->width;
+
+  zsurf_view_set_texture_yuv(view, convert->yuv_format, planes, strides,
+      convert->width, convert->height);
+  zsurf_display_flush(convert->bench->display);
+}
+
+static void
+convert_sync(void* data)
+{
+  struct bench_convert* convert = data;
+  bench_sync(convert->bench->display);
+}
+
+static void
+bench_convert(struct bench* bench)
+{
+  struct bench_convert convert = {
+      .bench = bench, .width = 1024, .height = 1024};
+  size_t size = (size_t)convert.width * convert.height * 4;
+  char name[64];
+
+  convert.pixels = malloc(size);
+  if (convert.pixels == NULL) return;
+  for (size_t i = 0; i < size; i++) convert.pixels[i] = i * 7;
+
+  convert.toplevel = bench_create_toplevel(bench, 1, 1);
+  if (convert.toplevel == NULL) goto out;
+
+  for (size_t f = 0; f < BENCH_PIXEL_FORMAT_COUNT; f++) {
+    convert.format = bench_pixel_formats[f].format;
+    snprintf(name, sizeof name, "set_texture_format/%s/%ux%u",
+        bench_pixel_formats[f].name, convert.width, convert.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            // of the source, compact formats move fewer bytes
+            .bytes_per_op = (uint64_t)convert.width * convert.height *
+                            zsurf_convert_bytes_per_pixel(convert.format),
+            .op = convert_set,
+            .teardown = convert_sync},
+        &convert);
+  }
+
+  for (int f = ZSURF_YUV_FORMAT_NV12; f <= ZSURF_YUV_FORMAT_I420; f++) {
+    convert.yuv_format = f;
+    snprintf(name, sizeof name, "set_texture_yuv/%s/%ux%u",
+        f == ZSURF_YUV_FORMAT_NV12 ? "nv12" : "i420", convert.width,
+        convert.height);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = 1,
+            .bytes_per_op = (uint64_t)convert.width * convert.height * 3 / 2,
+            .op = convert_set_yuv,
+            .teardown = convert_sync},
+        &convert);
+  }
+
+  zsurf_toplevel_destroy(convert.toplevel);
+
+out:
+  free(convert.pixels);
+}
+
+static void
+geometry_update(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+  zsurf_view_update_space_geom(zsurf_toplevel_get_view(toplevel->toplevel));
+}
+
+static void
+geometry_sync(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+  zsurf_display_flush(toplevel->bench->display);
+  bench_sync(toplevel->bench->display);
+}
+
+static void
+pick_view(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+  vec3 origin = {0.01f, 0.02f, 1.0f}, direction = {0.0f, 0.0f, -1.0f};
+  vec2 local_coord;
+  struct zsurf_view* volatile view;
+
+  view = zsurf_toplevel_pick_view(
+      toplevel->toplevel, origin, direction, local_coord);
+  UNUSED(view);
+}
+
+static void
+frame_round_trip(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+  struct zsurf_view* view = zsurf_toplevel_get_view(toplevel->toplevel);
+  bool done = false;
+
+  zsurf_view_add_frame_callback(view, frame_done, &done);
+  zsurf_view_commit(view);
+  while (!done)
+    if (zsurf_display_dispatch(toplevel->bench->display) == -1) break;
+}
+
+static void
+bench_view(struct bench* bench)
+{
+  struct bench_toplevel toplevel = {.bench = bench};
+
+  toplevel.toplevel = bench_create_toplevel(bench, 256, 256);
+  if (toplevel.toplevel == NULL) return;
+
+  bench_run(bench,
+      &(struct bench_case){.name = "update_space_geom",
+          .batch = 16,
+          .op = geometry_update,
+          .teardown = geometry_sync},
+      &toplevel);
+
+  bench_run(bench,
+      &(struct bench_case){
+          .name = "pick_view", .batch = 1024, .op = pick_view},
+      &toplevel);
+
+  bench_run(bench,
+      &(struct bench_case){
+          .name = "frame_round_trip", .batch = 1, .op = frame_round_trip},
+      &toplevel);
+
+  zsurf_toplevel_destroy(toplevel.toplevel);
+}
+
+static void
+icon_set(void* data)
+{
+  struct bench_icons* icons = data;
+  uint32_t index = icons->next++ % icons->count;
+  struct zsurf_view* view = icons->views[index];
+
+  if (icons->batch)
+    zsurf_batch_set_quad_texture(
+        icons->batch, index, icons->pixels, icons->size, icons->size);
+  else if (icons->atlas)
+    zsurf_view_set_texture_atlas(view, icons->pixels, icons->size, icons->size);
+  else
+    zsurf_view_set_texture(view, icons->pixels, icons->size, icons->size);
+}
+
+static void
+icon_sync(void* data)
+{
+  struct bench_icons* icons = data;
+  zsurf_display_flush(icons->bench->display);
+  bench_sync(icons->bench->display);
+}
+
+/**
+ * many small child views, each with its own texture or in the atlas, and
+ * the same number of quads of one batch
+ */
+static void
+bench_icons(struct bench* bench)
+{
+  struct bench_icons icons = {.bench = bench, .count = 256, .size = 32};
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_view* parent;
+  uint32_t created = 0;
+  char name[64];
+
+  icons.views = calloc(icons.count, sizeof *icons.views);
+  icons.pixels = calloc(icons.size * icons.size, sizeof *icons.pixels);
+  if (icons.views == NULL || icons.pixels == NULL) goto out;
+
+  toplevel = bench_create_toplevel(bench, 1024, 1024);
+  if (toplevel == NULL) goto out;
+  parent = zsurf_toplevel_get_view(toplevel);
+
+  for (; created < icons.count; created++) {
+    icons.views[created] =
+        zsurf_view_create(bench->display, toplevel, parent, NULL);
+    if (icons.views[created] == NULL) goto out_views;
+  }
+
+  for (int atlas = 0; atlas <= 1; atlas++) {
+    icons.atlas = atlas;
+    snprintf(name, sizeof name, "icons/%s/%ux%u",
+        atlas ? "atlas" : "own_texture", icons.size, icons.size);
+    bench_run(bench,
+        &(struct bench_case){.name = name,
+            .batch = icons.count,
+            .bytes_per_op = (uint64_t)icons.size * icons.size * 4,
+            .op = icon_set,
+            .teardown = icon_sync},
+        &icons);
+  }
+
+  icons.batch = zsurf_batch_create(parent, icons.count);
+  if (icons.batch == NULL) goto out_views;
+  for (uint32_t i = 0; i < icons.count; i++) {
+    struct zsurf_batch_quad quad = {.sx = i % 32 * icons.size,
+        .sy = i / 32 * icons.size,
+        .width = icons.size,
+        .height = icons.size};
+    zsurf_batch_set_quad(icons.batch, i, &quad);
+  }
+  snprintf(name, sizeof name, "icons/batch/%ux%u", icons.size, icons.size);
+  bench_run(bench,
+      &(struct bench_case){.name = name,
+          .batch = icons.count,
+          .bytes_per_op = (uint64_t)icons.size * icons.size * 4,
+          .op = icon_set,
+          .teardown = icon_sync},
+      &icons);
+  zsurf_batch_destroy(icons.batch);
+
+out_views:
+  while (created-- > 0) zsurf_view_destroy(icons.views[created]);
+  zsurf_toplevel_destroy(toplevel);
+
+out:
+  free(icons.pixels);
+  free(icons.views);
+}
+
+static void
+toplevel_setup(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+
+  if (toplevel->pooled) zsurf_display_fill_view_pool(toplevel->bench->display);
+}
+
+static void
+toplevel_create(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+
+  toplevel->toplevel = zsurf_toplevel_create(toplevel->bench->display, NULL);
+  zsurf_display_flush(toplevel->bench->display);
+}
+
+static void
+toplevel_destroy(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+
+  if (toplevel->toplevel) zsurf_toplevel_destroy(toplevel->toplevel);
+  toplevel->toplevel = NULL;
+  zsurf_display_flush(toplevel->bench->display);
+}
+
+static void
+toplevel_sync(void* data)
+{
+  struct bench_toplevel* toplevel = data;
+  bench_sync(toplevel->bench->display);
+}
+
+static void
+toplevel_create_setup(void* data)
+{
+  toplevel_setup(data);
+  toplevel_create(data);
+  toplevel_sync(data);
+}
+
+static void
+toplevel_destroy_teardown(void* data)
+{
+  toplevel_destroy(data);
+  toplevel_sync(data);
+}
+
+static void
+bench_toplevel(struct bench* bench)
+{
+  struct bench_toplevel toplevel = {.bench = bench};
+
+  for (int pooled = 0; pooled < 2; pooled++) {
+    toplevel.pooled = pooled;
+    zsurf_display_set_view_pool_size(bench->display, pooled ? 4 : 0);
+
+    bench_run(bench,
+        &(struct bench_case){
+            .name = pooled ? "toplevel_create/pooled" : "toplevel_create",
+            .batch = 1,
+            .setup = toplevel_setup,
+            .op = toplevel_create,
+            .teardown = toplevel_destroy_teardown},
+        &toplevel);
+
+    bench_run(bench,
+        &(struct bench_case){
+            .name = pooled ? "toplevel_destroy/pooled" : "toplevel_destroy",
+            .batch = 1,
+            .setup = toplevel_create_setup,
+            .op = toplevel_destroy,
+            .teardown = toplevel_sync},
+        &toplevel);
+  }
+
+  zsurf_display_set_view_pool_size(bench->display, 0);
+}
+
+static void
+display_create(void* data)
+{
+  struct bench_startup* startup = data;
+  bool ready = false;
+
+  if (!startup->async) {
+    startup->display = zsurf_display_create(
+        startup->bench->socket, &bench_display_interface, &ready);
+    return;
+  }
+
+  startup->display = zsurf_display_create_async(
+      startup->bench->socket, &bench_display_interface, &ready);
+  while (startup->display && !ready)
+    if (zsurf_display_dispatch(startup->display) == -1) break;
+}
+
+static void
+display_create_async(void* data)
+{
+  struct bench_startup* startup = data;
+  bool ready = false;
+
+  startup->display = zsurf_display_create_async(
+      startup->bench->socket, &bench_display_interface, &ready);
+}
+
+static void
+display_destroy(void* data)
+{
+  struct bench_startup* startup = data;
+
+  if (startup->display) zsurf_display_destroy(startup->display);
+  startup->display = NULL;
+}
+
+static void
+bench_startup(struct bench* bench)
+{
+  struct bench_startup startup = {.bench = bench};
+
+  bench_run(bench,
+      &(struct bench_case){.name = "display_create",
+          .batch = 1,
+          .op = display_create,
+          .teardown = display_destroy},
+      &startup);
+
+  startup.async = true;
+  bench_run(bench,
+      &(struct bench_case){.name = "display_create_async/ready",
+          .batch = 1,
+          .op = display_create,
+          .teardown = display_destroy},
+      &startup);
+
+  bench_run(bench,
+      &(struct bench_case){.name = "display_create_async/return",
+          .batch = 1,
+          .op = display_create_async,
+          .teardown = display_destroy},
+      &startup);
+}
+
+static void
+print_usage(const char* program)
+{
+  fprintf(stderr,
+      "usage: %s [options]\n"
+      "  -o, --output PATH      write the JSON results to PATH, stdout if -\n"
+      "  -t, --time MS          measuring time per case, > 0 (default 200)\n"
+      "  -f, --filter TEXT      only run cases whose name contains TEXT\n",
+      program);
+}
+
+int
+main(int argc, char* argv[])
+{
+  struct zsurf_mock_options options = {.frame_rate = 0};
+  const struct option long_options[] = {
+      {"output", required_argument, NULL, 'o'},
+      {"time", required_argument, NULL, 't'},
+      {"filter", required_argument, NULL, 'f'},
+      {"help", no_argument, NULL, 'h'},
+      {0, 0, 0, 0},
+  };
+  struct bench bench = {.out = stdout, .budget_ns = 200000000};
+  const char* output = NULL;
+  bool ready = false;
+  int c, ret = EXIT_FAILURE;
+
+  while ((c = getopt_long(argc, argv, "o:t:f:h", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'o':
+        output = optarg;
+        break;
+      case 't':
+        bench.budget_ns = strtoull(optarg, NULL, 10) * 1000000;
+        if (bench.budget_ns == 0) {
+          print_usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'f':
+        bench.filter = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  bench.samples = calloc(BENCH_MAX_SAMPLES, sizeof *bench.samples);
+  if (bench.samples == NULL) goto err;
+
+  bench.mock = zsurf_mock_create(&options);
+  if (bench.mock == NULL) {
+    fprintf(stderr, "failed to create the mock compositor\n");
+    goto err_mock;
+  }
+  bench.socket = zsurf_mock_get_socket(bench.mock);
+
+  if (zsurf_mock_start(bench.mock) != 0) goto err_start;
+
+  bench.display =
+      zsurf_display_create(bench.socket, &bench_display_interface, &ready);
+  if (bench.display == NULL) {
+    fprintf(stderr, "failed to connect to the mock compositor\n");
+    goto err_display;
+  }
+
+  if (output && strcmp(output, "-") != 0) {
+    bench.out = fopen(output, "w");
+    if (bench.out == NULL) {
+      perror(output);
+      goto err_output;
+    }
+  }
+
+  fprintf(bench.out, "{\n  \"version\": \"%s\",\n  \"results\": [",
+      ZSURFACE_VERSION);
+
+  bench_texture(&bench);
+  bench_convert(&bench);
+  bench_view(&bench);
+  bench_icons(&bench);
+  bench_toplevel(&bench);
+  bench_startup(&bench);
+
+  fprintf(bench.out, "\n  ]\n}\n");
+
+  if (bench.out != stdout) fclose(bench.out);
+
+  ret = EXIT_SUCCESS;
+
+err_output:
+  zsurf_display_destroy(bench.display);
+
+err_display:
+  zsurf_mock_stop(bench.mock);
+
+err_start:
+  zsurf_mock_destroy(bench.mock);
+
+err_mock:
+  free(bench.samples);
+
+err:
+  return ret;
+}
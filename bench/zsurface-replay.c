@@ -0,0 +1,626 @@
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsurface.h>
+
+#include "bench-common.h"
+#include "internal.h"
+#include "mock.h"
+
+#define REPLAY_MAX_WORDS 64
+
+struct replay_table {
+  void** items;  // indexed by the recorded id
+  uint32_t capacity;
+};
+
+struct replay {
+  struct zsurf_display* display;
+  bool max_speed;
+
+  struct replay_table toplevels;
+  struct replay_table batches;
+
+  struct zsurf_color_bgra* pixels;  // recordings carry no pixel data
+  size_t pixel_capacity;
+
+  uint64_t requests;
+  uint64_t events;
+  uint64_t skipped;  // records of unknown objects or types
+};
+
+static void
+print_usage(const char* program)
+{
+  fprintf(stderr,
+      "usage: %s [options] RECORDING\n"
+      "  -m, --max-speed        do not wait for the recorded timestamps\n"
+      "  -f, --frame-rate HZ    frame clock of the mock, 0 answers on commit\n"
+      "                         (default 60)\n"
+      "  -s, --socket NAME      replay against this compositor, not the mock\n"
+      "  -o, --output PATH      write the results as JSON to PATH\n",
+      program);
+}
+
+static void
+noop_frame(void* data, uint32_t callback_time)
+{
+  UNUSED(data);
+  UNUSED(callback_time);
+}
+
+/**
+ * dispatch what the compositor sent until deadline_ns, or once without
+ * blocking if it has passed
+ */
+static int
+replay_pump(struct replay* replay, uint64_t deadline_ns)
+{
+  struct zsurf_display* display = replay->display;
+  struct pollfd pfd = {.fd = zsurf_display_get_fd(display), .events = POLLIN};
+  struct timespec timeout;
+  uint64_t now;
+  int ret;
+
+  do {
+    if (zsurf_display_dispatch_pending(display) == -1) return -1;
+    zsurf_display_flush(display);
+
+    now = zsurf_get_time_ns();
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 0;
+    if (deadline_ns > now) {
+      timeout.tv_sec = (deadline_ns - now) / 1000000000;
+      timeout.tv_nsec = (deadline_ns - now) % 1000000000;
+    }
+
+    if (zsurf_display_prepare_read(display) == -1) continue;
+
+    ret = ppoll(&pfd, 1, &timeout, NULL);
+    if (ret > 0) {
+      if (zsurf_display_read_events(display) == -1) return -1;
+    } else {
+      zsurf_display_cancel_read(display);
+    }
+  } while (zsurf_get_time_ns() < deadline_ns);
+
+  return zsurf_display_dispatch_pending(display);
+}
+
+static void*
+replay_table_get(struct replay_table* table, uint32_t id)
+{
+  return id < table->capacity ? table->items[id] : NULL;
+}
+
+static int
+replay_table_set(struct replay_table* table, uint32_t id, void* item)
+{
+  void** items;
+  uint32_t capacity;
+
+  if (id >= table->capacity) {
+    capacity = table->capacity ? table->capacity : 16;
+    while (capacity <= id) capacity *= 2;
+    items = realloc(table->items, capacity * sizeof *items);
+    if (items == NULL) return -1;
+    memset(&items[table->capacity], 0,
+        (capacity - table->capacity) * sizeof *items);
+    table->items = items;
+    table->capacity = capacity;
+  }
+
+  table->items[id] = item;
+
+  return 0;
+}
+
+static struct zsurf_color_bgra*
+replay_pixels(struct replay* replay, uint32_t width, uint32_t height)
+{
+  size_t count = (size_t)width * height;
+  struct zsurf_color_bgra* pixels;
+
+  if (count > replay->pixel_capacity) {
+    pixels = realloc(replay->pixels, count * sizeof *pixels);
+    if (pixels == NULL) return NULL;
+    memset(&pixels[replay->pixel_capacity], 0x80,
+        (count - replay->pixel_capacity) * sizeof *pixels);
+    replay->pixels = pixels;
+    replay->pixel_capacity = count;
+  }
+
+  return replay->pixels;
+}
+
+static void
+replay_array(struct wl_array* array, union zsurf_record_word* words, int count)
+{
+  array->size = count * sizeof *words;
+  array->alloc = 0;
+  array->data = words;
+}
+
+/**
+ * set the texture through the call that was recorded
+ */
+static int
+replay_set_texture(struct replay* replay, struct zsurf_view* view,
+    union zsurf_record_word* words, int count)
+{
+  uint32_t kind, format, width, height, luma;
+  struct zsurf_color_bgra* pixels;
+  const uint8_t* planes[3];
+  uint32_t strides[3];
+
+  if (count < 4) return 1;
+  kind = words[0].u;
+  format = words[1].u;
+  width = words[2].u;
+  height = words[3].u;
+
+  // 4 bytes per pixel hold any format
+  pixels = replay_pixels(replay, width, height);
+  if (pixels == NULL) return -1;
+
+  switch (kind) {
+    case ZSURF_RECORD_TEXTURE_FORMAT:
+      return zsurf_view_set_texture_format(
+          view, pixels, format, 0, width, height);
+    case ZSURF_RECORD_TEXTURE_YUV:
+      luma = width * height;
+      planes[0] = (const uint8_t*)pixels;
+      planes[1] = planes[0] + luma;
+      planes[2] = planes[1] + luma / 4;
+      strides[0] = width;
+      strides[1] = format == ZSURF_YUV_FORMAT_NV12 ? width : width / 2;
+      strides[2] = width / 2;
+      return zsurf_view_set_texture_yuv(
+          view, format, planes, strides, width, height);
+    case ZSURF_RECORD_TEXTURE_LAYER:
+      // lost layers are not an error of the replay
+      if (zsurf_view_set_texture_layer(view, format, pixels, width, height) < 0)
+        return -1;
+      return 0;
+    case ZSURF_RECORD_TEXTURE_ATLAS:
+      return zsurf_view_set_texture_atlas(view, pixels, width, height);
+    case ZSURF_RECORD_TEXTURE_BUFFER:
+      return zsurf_view_get_texture_buffer(view, width, height) ? 0 : -1;
+    default:
+      return 1;
+  }
+}
+
+static int
+replay_batch_request(struct replay* replay,
+    struct zsurf_record_header* header, union zsurf_record_word* words,
+    int count)
+{
+  struct zsurf_batch* batch = replay_table_get(&replay->batches, header->id);
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_color_bgra* pixels;
+  struct zsurf_batch_quad quad;
+
+  if (header->type == ZSURF_RECORD_BATCH_CREATE) {
+    if (count < 2) return 1;
+    toplevel = replay_table_get(&replay->toplevels, words[0].u);
+    if (toplevel == NULL) return 1;
+    batch = zsurf_batch_create(zsurf_toplevel_get_view(toplevel), words[1].u);
+    if (batch == NULL) return -1;
+    return replay_table_set(&replay->batches, header->id, batch);
+  }
+
+  if (batch == NULL) return 1;
+
+  // an index out of range failed in the recording as well
+  switch (header->type) {
+    case ZSURF_RECORD_BATCH_DESTROY:
+      zsurf_batch_destroy(batch);
+      replay->batches.items[header->id] = NULL;
+      return 0;
+    case ZSURF_RECORD_BATCH_SET_QUAD:
+      if (count < 10) return 1;
+      quad = (struct zsurf_batch_quad){.sx = (int32_t)words[1].u,
+          .sy = (int32_t)words[2].u,
+          .width = words[3].u,
+          .height = words[4].u,
+          .source = {words[5].u, words[6].u, words[7].u, words[8].u},
+          .z = (int32_t)words[9].u};
+      zsurf_batch_set_quad(batch, words[0].u, &quad);
+      return 0;
+    case ZSURF_RECORD_BATCH_SET_QUAD_TEXTURE:
+      if (count < 3) return 1;
+      pixels = replay_pixels(replay, words[1].u, words[2].u);
+      if (pixels == NULL) return -1;
+      zsurf_batch_set_quad_texture(
+          batch, words[0].u, pixels, words[1].u, words[2].u);
+      return 0;
+    case ZSURF_RECORD_BATCH_CLEAR_QUAD:
+      if (count < 1) return 1;
+      zsurf_batch_clear_quad(batch, words[0].u);
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+static int
+replay_request(struct replay* replay, struct zsurf_record_header* header,
+    union zsurf_record_word* words, int count)
+{
+  struct zsurf_toplevel* toplevel =
+      replay_table_get(&replay->toplevels, header->id);
+  struct zsurf_color_bgra* pixels;
+  struct zsurf_view* view;
+  struct zsurf_rect rect;
+
+  if (header->type == ZSURF_RECORD_TOPLEVEL_CREATE) {
+    toplevel = zsurf_toplevel_create(replay->display, NULL);
+    if (toplevel == NULL) return -1;
+    return replay_table_set(&replay->toplevels, header->id, toplevel);
+  }
+
+  if (header->type >= ZSURF_RECORD_BATCH_CREATE)
+    return replay_batch_request(replay, header, words, count);
+
+  if (header->type == ZSURF_RECORD_SET_CURSOR) {
+    if (count < 4) return 1;
+    if (words[0].u == 0 || words[1].u == 0) {
+      zsurf_display_set_cursor(replay->display, NULL, 0, 0, 0, 0);
+      return 0;
+    }
+    pixels = replay_pixels(replay, words[0].u, words[1].u);
+    if (pixels == NULL) return -1;
+    zsurf_display_set_cursor(replay->display, pixels, words[0].u, words[1].u,
+        (int32_t)words[2].u, (int32_t)words[3].u);
+    return 0;
+  }
+
+  if (toplevel == NULL) return 1;
+  view = zsurf_toplevel_get_view(toplevel);
+
+  switch (header->type) {
+    case ZSURF_RECORD_TOPLEVEL_DESTROY:
+      zsurf_toplevel_destroy(toplevel);
+      replay->toplevels.items[header->id] = NULL;
+      return 0;
+    case ZSURF_RECORD_TOPLEVEL_MOVE:
+      if (count < 1) return 1;
+      zsurf_toplevel_move(toplevel, words[0].u);
+      return 0;
+    case ZSURF_RECORD_VIEW_SET_TEXTURE:
+      return replay_set_texture(replay, view, words, count);
+    case ZSURF_RECORD_VIEW_COMMIT:
+      zsurf_view_commit(view);
+      return 0;
+    case ZSURF_RECORD_VIEW_FRAME:
+      zsurf_view_add_frame_callback(view, noop_frame, NULL);
+      return 0;
+    case ZSURF_RECORD_VIEW_SCROLL:
+      if (count < 5) return 1;
+      rect = (struct zsurf_rect){
+          words[0].u, words[1].u, words[2].u, words[3].u};
+      // a refused scroll was refused in the recording as well
+      zsurf_view_scroll(view, &rect, (int32_t)words[4].u);
+      return 0;
+    case ZSURF_RECORD_VIEW_SET_SOURCE:
+      if (count < 4) return 1;
+      zsurf_view_set_source(
+          view, words[0].f, words[1].f, words[2].f, words[3].f);
+      return 0;
+    case ZSURF_RECORD_VIEW_COLOR_TRANSFORM:
+      if (count < 9) return 1;
+      zsurf_view_set_color_transform(view, words[0].f,
+          (const float[4]){words[1].f, words[2].f, words[3].f, words[4].f},
+          (const float[4]){words[5].f, words[6].f, words[7].f, words[8].f});
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+/**
+ * events are handed to the library's own listeners, as if the compositor
+ * had sent them
+ */
+static int
+replay_event(struct replay* replay, struct zsurf_record_header* header,
+    union zsurf_record_word* words, int count)
+{
+  struct zsurf_display* display = replay->display;
+  struct zsurf_toplevel* toplevel =
+      replay_table_get(&replay->toplevels, header->id);
+  const struct zgn_ray_listener* ray = &zsurf_display_ray_listener;
+  const struct zgn_keyboard_listener* keyboard =
+      &zsurf_display_keyboard_listener;
+  const struct zgn_cuboid_window_listener* cuboid_window =
+      &zsurf_toplevel_cuboid_window_listener;
+  struct wl_array a, b;
+
+  switch (header->type) {
+    case ZSURF_RECORD_RAY_ENTER:
+      if (toplevel == NULL || count < 7) return 1;
+      replay_array(&a, &words[1], 3);
+      replay_array(&b, &words[4], 3);
+      ray->enter(display, display->ray, words[0].u, toplevel->virtual_object,
+          &a, &b);
+      return 0;
+    case ZSURF_RECORD_RAY_LEAVE:
+      if (toplevel == NULL || count < 1) return 1;
+      ray->leave(display, display->ray, words[0].u, toplevel->virtual_object);
+      return 0;
+    case ZSURF_RECORD_RAY_MOTION:
+      if (count < 7) return 1;
+      replay_array(&a, &words[1], 3);
+      replay_array(&b, &words[4], 3);
+      ray->motion(display, display->ray, words[0].u, &a, &b);
+      return 0;
+    case ZSURF_RECORD_RAY_BUTTON:
+      if (count < 4) return 1;
+      ray->button(display, display->ray, words[0].u, words[1].u, words[2].u,
+          words[3].u);
+      return 0;
+    case ZSURF_RECORD_KEYBOARD_ENTER:
+      if (toplevel == NULL || count < 1) return 1;
+      replay_array(&a, &words[1], count - 1);
+      keyboard->enter(display, display->keyboard, words[0].u,
+          toplevel->virtual_object, &a);
+      return 0;
+    case ZSURF_RECORD_KEYBOARD_LEAVE:
+      if (toplevel == NULL || count < 1) return 1;
+      keyboard->leave(display, display->keyboard, words[0].u,
+          toplevel->virtual_object);
+      return 0;
+    case ZSURF_RECORD_KEYBOARD_KEY:
+      if (count < 4) return 1;
+      keyboard->key(display, display->keyboard, words[0].u, words[1].u,
+          words[2].u, words[3].u);
+      return 0;
+    case ZSURF_RECORD_KEYBOARD_MODIFIERS:
+      if (count < 5) return 1;
+      keyboard->modifiers(display, display->keyboard, words[0].u, words[1].u,
+          words[2].u, words[3].u, words[4].u);
+      return 0;
+    case ZSURF_RECORD_CONFIGURE:
+      if (toplevel == NULL || toplevel->cuboid_window == NULL || count < 8)
+        return 1;
+      replay_array(&a, &words[1], 3);
+      replay_array(&b, &words[4], 4);
+      cuboid_window->configure(
+          toplevel, toplevel->cuboid_window, words[0].u, &a, &b);
+      return 0;
+    case ZSURF_RECORD_MOVED:
+      if (toplevel == NULL || toplevel->cuboid_window == NULL || count < 3)
+        return 1;
+      replay_array(&a, &words[0], 3);
+      cuboid_window->moved(toplevel, toplevel->cuboid_window, &a);
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+static int
+replay_run(struct replay* replay, const char* data, size_t size,
+    uint64_t* recorded_ns)
+{
+  const struct zsurf_record_file_header* file_header = (const void*)data;
+  struct zsurf_record_header header;
+  union zsurf_record_word words[REPLAY_MAX_WORDS];
+  uint64_t start = zsurf_get_time_ns();
+  size_t offset = sizeof *file_header;
+  int count, ret;
+
+  if (size < sizeof *file_header ||
+      file_header->magic != ZSURF_RECORD_MAGIC ||
+      file_header->version != ZSURF_RECORD_VERSION) {
+    fprintf(stderr, "not a zsurface recording of version %d\n",
+        ZSURF_RECORD_VERSION);
+    return -1;
+  }
+
+  while (offset + sizeof header <= size) {
+    memcpy(&header, data + offset, sizeof header);
+    offset += sizeof header;
+    if (offset + header.size > size) break;  // cut off by a crash
+
+    count = header.size / sizeof *words;
+    if (count > REPLAY_MAX_WORDS) count = REPLAY_MAX_WORDS;
+    memcpy(words, data + offset, count * sizeof *words);
+    offset += header.size;
+    *recorded_ns = header.time_ns;
+
+    if (replay_pump(replay, replay->max_speed ? 0 : start + header.time_ns) ==
+        -1) {
+      fprintf(stderr, "lost the connection to the compositor\n");
+      return -1;
+    }
+
+    if (header.type < ZSURF_RECORD_RAY_ENTER) {
+      ret = replay_request(replay, &header, words, count);
+      if (ret == 0) replay->requests++;
+    } else {
+      ret = replay_event(replay, &header, words, count);
+      if (ret == 0) replay->events++;
+    }
+
+    if (ret < 0) {
+      fprintf(stderr, "failed to replay a record of type %u\n", header.type);
+      return -1;
+    }
+    if (ret > 0) replay->skipped++;
+  }
+
+  bench_sync(replay->display);
+
+  return 0;
+}
+
+static char*
+read_file(const char* path, size_t* size)
+{
+  FILE* file;
+  char* data;
+  long length;
+
+  file = fopen(path, "r");
+  if (file == NULL) goto err;
+
+  if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0 ||
+      fseek(file, 0, SEEK_SET) != 0)
+    goto err_size;
+
+  data = malloc(length ? length : 1);
+  if (data == NULL) goto err_size;
+
+  if (fread(data, 1, length, file) != (size_t)length) goto err_read;
+
+  fclose(file);
+  *size = length;
+
+  return data;
+
+err_read:
+  free(data);
+
+err_size:
+  fclose(file);
+
+err:
+  return NULL;
+}
+
+int
+main(int argc, char* argv[])
+{
+  struct zsurf_mock_options options = {.frame_rate = 60};
+  const struct option long_options[] = {
+      {"max-speed", no_argument, NULL, 'm'},
+      {"frame-rate", required_argument, NULL, 'f'},
+      {"socket", required_argument, NULL, 's'},
+      {"output", required_argument, NULL, 'o'},
+      {"help", no_argument, NULL, 'h'},
+      {0, 0, 0, 0},
+  };
+  struct replay replay = {0};
+  struct zsurf_mock* mock = NULL;
+  struct zsurf_mock_stats stats = {0};
+  const char *socket = NULL, *output = NULL;
+  uint64_t start, wall_ns, recorded_ns = 0;
+  bool ready = false;
+  FILE* out = stdout;
+  size_t size;
+  char* data;
+  int c, ret = EXIT_FAILURE;
+
+  while ((c = getopt_long(argc, argv, "mf:s:o:h", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'm':
+        replay.max_speed = true;
+        break;
+      case 'f':
+        options.frame_rate = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        socket = optarg;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if (optind + 1 != argc) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  data = read_file(argv[optind], &size);
+  if (data == NULL) {
+    perror(argv[optind]);
+    goto err;
+  }
+
+  if (socket == NULL) {
+    mock = zsurf_mock_create(&options);
+    if (mock == NULL) {
+      fprintf(stderr, "failed to create the mock compositor\n");
+      goto err_mock;
+    }
+    if (zsurf_mock_start(mock) != 0) goto err_start;
+    socket = zsurf_mock_get_socket(mock);
+  }
+
+  replay.display =
+      zsurf_display_create(socket, &bench_display_interface, &ready);
+  if (replay.display == NULL) {
+    fprintf(stderr, "failed to connect to %s\n", socket);
+    goto err_display;
+  }
+  bench_sync(replay.display);  // seat capabilities and the keymap
+
+  if (mock) zsurf_mock_reset_stats(mock);
+
+  start = zsurf_get_time_ns();
+  if (replay_run(&replay, data, size, &recorded_ns) != 0) goto err_run;
+  wall_ns = zsurf_get_time_ns() - start;
+
+  if (mock) zsurf_mock_get_stats(mock, &stats);
+
+  if (output) {
+    out = fopen(output, "w");
+    if (out == NULL) {
+      perror(output);
+      goto err_run;
+    }
+  }
+
+  fprintf(out,
+      "{\n  \"max_speed\": %s,\n  \"requests\": %" PRIu64
+      ",\n  \"events\": %" PRIu64 ",\n  \"skipped\": %" PRIu64
+      ",\n  \"recorded_ns\": %" PRIu64 ",\n  \"wall_ns\": %" PRIu64,
+      replay.max_speed ? "true" : "false", replay.requests, replay.events,
+      replay.skipped, recorded_ns, wall_ns);
+  if (mock)
+    fprintf(out,
+        ",\n  \"compositor\": {\"requests\": %" PRIu64 ", \"events\": %" PRIu64
+        ", \"commits\": %" PRIu64 ", \"frame_callbacks\": %" PRIu64 "}",
+        stats.requests, stats.events, stats.commits, stats.frame_callbacks);
+  fprintf(out, "\n}\n");
+
+  if (out != stdout) fclose(out);
+
+  ret = EXIT_SUCCESS;
+
+err_run:
+  // batches go before their parents
+  for (uint32_t i = 0; i < replay.batches.capacity; i++)
+    if (replay.batches.items[i]) zsurf_batch_destroy(replay.batches.items[i]);
+  free(replay.batches.items);
+  for (uint32_t i = 0; i < replay.toplevels.capacity; i++)
+    if (replay.toplevels.items[i])
+      zsurf_toplevel_destroy(replay.toplevels.items[i]);
+  free(replay.toplevels.items);
+  free(replay.pixels);
+  zsurf_display_destroy(replay.display);
+
+err_display:
+  if (mock) zsurf_mock_stop(mock);
+
+err_start:
+  if (mock) zsurf_mock_destroy(mock);
+
+err_mock:
+  free(data);
+
+err:
+  return ret;
+}
@@ -0,0 +1,505 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "bench-common.h"
+#include "internal.h"
+#include "mock.h"
+
+#define SCALE_MAX_COUNTS 8
+#define SCALE_ROOT_SIZE 64
+#define SCALE_CHILD_SIZE 16
+
+// the mock runs in the same process, its side is included
+struct scale_usage {
+  uint64_t fds;
+  uint64_t mappings;
+  uint64_t rss_bytes;
+};
+
+struct scale_run {
+  uint32_t toplevel_count;
+  uint32_t child_count;  // per toplevel
+  uint64_t views;
+
+  struct scale_usage usage;  // growth while building the scene
+  uint64_t build_ns;
+  uint64_t destroy_ns;
+
+  uint32_t frames;
+  double requests_per_frame;
+  double events_per_frame;
+  double client_cpu_ns_per_frame;   // calling thread only
+  double process_cpu_ns_per_frame;  // includes the mock
+  double wall_ns_per_frame;
+};
+
+struct scale_toplevel {
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_view** children;
+};
+
+struct scale {
+  struct zsurf_mock* mock;
+  struct zsurf_display* display;
+  struct zsurf_color_bgra* pixels;  // SCALE_ROOT_SIZE^2, shared by all views
+  uint32_t frames;
+  double threshold;  // per-view growth ratio considered superlinear
+};
+
+static uint64_t
+get_cpu_time_ns(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+scale_get_usage(struct scale_usage* usage)
+{
+  struct dirent* entry;
+  DIR* dir;
+  FILE* file;
+  long pages;
+  int c;
+
+  usage->fds = 0;
+  dir = opendir("/proc/self/fd");
+  if (dir) {
+    while ((entry = readdir(dir)))
+      if (entry->d_name[0] != '.') usage->fds++;
+    closedir(dir);
+  }
+
+  usage->mappings = 0;
+  file = fopen("/proc/self/maps", "r");
+  if (file) {
+    while ((c = fgetc(file)) != EOF)
+      if (c == '\n') usage->mappings++;
+    fclose(file);
+  }
+
+  usage->rss_bytes = 0;
+  file = fopen("/proc/self/statm", "r");
+  if (file) {
+    if (fscanf(file, "%*s %ld", &pages) == 1)
+      usage->rss_bytes = (uint64_t)pages * sysconf(_SC_PAGESIZE);
+    fclose(file);
+  }
+}
+
+static void
+frame_done(void* data, uint32_t callback_time)
+{
+  uint32_t* done = data;
+  UNUSED(callback_time);
+  (*done)++;
+}
+
+static int
+scale_build(struct scale* scale, struct scale_toplevel* toplevels,
+    struct scale_run* run)
+{
+  struct zsurf_view *root, *child;
+
+  for (uint32_t i = 0; i < run->toplevel_count; i++) {
+    struct scale_toplevel* t = &toplevels[i];
+
+    t->toplevel = zsurf_toplevel_create(scale->display, NULL);
+    if (t->toplevel == NULL) return -1;
+
+    root = zsurf_toplevel_get_view(t->toplevel);
+    zsurf_view_set_texture(
+        root, scale->pixels, SCALE_ROOT_SIZE, SCALE_ROOT_SIZE);
+
+    t->children = calloc(run->child_count, sizeof *t->children);
+    if (run->child_count > 0 && t->children == NULL) return -1;
+
+    for (uint32_t j = 0; j < run->child_count; j++) {
+      child = zsurf_view_create(scale->display, t->toplevel, root, NULL);
+      if (child == NULL) return -1;
+      t->children[j] = child;
+
+      zsurf_view_set_texture(
+          child, scale->pixels, SCALE_CHILD_SIZE, SCALE_CHILD_SIZE);
+      zsurf_view_update_surface_pos(child,
+          (j * SCALE_CHILD_SIZE) % SCALE_ROOT_SIZE,
+          (j * SCALE_CHILD_SIZE / SCALE_ROOT_SIZE * SCALE_CHILD_SIZE) %
+              SCALE_ROOT_SIZE);
+    }
+
+    zsurf_view_commit(root);
+
+    // keep the socket buffer from filling up
+    bench_sync(scale->display);
+  }
+
+  // receive the configure events, which lay out every child view
+  bench_sync(scale->display);
+
+  return 0;
+}
+
+static void
+scale_destroy(struct scale_toplevel* toplevels, struct scale_run* run)
+{
+  for (uint32_t i = 0; i < run->toplevel_count; i++) {
+    struct scale_toplevel* t = &toplevels[i];
+
+    for (uint32_t j = 0; t->children && j < run->child_count; j++)
+      if (t->children[j]) zsurf_view_destroy(t->children[j]);
+    free(t->children);
+    t->children = NULL;
+
+    if (t->toplevel) zsurf_toplevel_destroy(t->toplevel);
+    t->toplevel = NULL;
+  }
+}
+
+static int
+scale_animate_frame(struct scale* scale, struct scale_toplevel* toplevels,
+    struct scale_run* run, uint32_t frame)
+{
+  struct zsurf_view *root, *child;
+  uint32_t done = 0;
+
+  for (uint32_t i = 0; i < run->toplevel_count; i++) {
+    struct scale_toplevel* t = &toplevels[i];
+    root = zsurf_toplevel_get_view(t->toplevel);
+
+    for (uint32_t j = 0; j < run->child_count; j++) {
+      child = t->children[j];
+      zsurf_view_update_surface_pos(child,
+          (child->surface_geometry.sx + 1) %
+              (SCALE_ROOT_SIZE - SCALE_CHILD_SIZE),
+          child->surface_geometry.sy);
+      zsurf_view_update_space_geom(child);
+    }
+
+    // a different texel each frame, the size stays the same
+    scale->pixels[frame % (SCALE_ROOT_SIZE * SCALE_ROOT_SIZE)].r++;
+    zsurf_view_set_texture(
+        root, scale->pixels, SCALE_ROOT_SIZE, SCALE_ROOT_SIZE);
+
+    zsurf_view_add_frame_callback(root, frame_done, &done);
+    zsurf_view_commit(root);
+
+    if (zsurf_display_flush(scale->display) == -1) bench_sync(scale->display);
+  }
+
+  while (done < run->toplevel_count)
+    if (zsurf_display_dispatch(scale->display) == -1) return -1;
+
+  return 0;
+}
+
+static int
+scale_run(struct scale* scale, struct scale_run* run)
+{
+  struct scale_toplevel* toplevels;
+  struct scale_usage before, after;
+  struct zsurf_mock_stats stats;
+  uint64_t start, wall, client_cpu, process_cpu;
+  int ret = -1;
+
+  toplevels = calloc(run->toplevel_count, sizeof *toplevels);
+  if (toplevels == NULL) return -1;
+
+  run->views = (uint64_t)run->toplevel_count * (run->child_count + 1);
+
+  scale_get_usage(&before);
+  start = zsurf_get_time_ns();
+  if (scale_build(scale, toplevels, run) != 0) goto out;
+  run->build_ns = zsurf_get_time_ns() - start;
+  scale_get_usage(&after);
+
+  run->usage.fds = after.fds - before.fds;
+  run->usage.mappings = after.mappings - before.mappings;
+  run->usage.rss_bytes =
+      after.rss_bytes > before.rss_bytes ? after.rss_bytes - before.rss_bytes
+                                         : 0;
+
+  // warm up so that the first frame's cuboid window setup is not counted
+  if (scale_animate_frame(scale, toplevels, run, 0) != 0) goto out;
+  bench_sync(scale->display);
+  zsurf_mock_reset_stats(scale->mock);
+
+  wall = zsurf_get_time_ns();
+  client_cpu = get_cpu_time_ns(CLOCK_THREAD_CPUTIME_ID);
+  process_cpu = get_cpu_time_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+  for (uint32_t frame = 1; frame <= scale->frames; frame++)
+    if (scale_animate_frame(scale, toplevels, run, frame) != 0) goto out;
+
+  wall = zsurf_get_time_ns() - wall;
+  client_cpu = get_cpu_time_ns(CLOCK_THREAD_CPUTIME_ID) - client_cpu;
+  process_cpu = get_cpu_time_ns(CLOCK_PROCESS_CPUTIME_ID) - process_cpu;
+
+  bench_sync(scale->display);
+  zsurf_mock_get_stats(scale->mock, &stats);
+
+  run->frames = scale->frames;
+  run->requests_per_frame = (double)stats.requests / scale->frames;
+  run->events_per_frame = (double)stats.events / scale->frames;
+  run->client_cpu_ns_per_frame = (double)client_cpu / scale->frames;
+  run->process_cpu_ns_per_frame = (double)process_cpu / scale->frames;
+  run->wall_ns_per_frame = (double)wall / scale->frames;
+
+  ret = 0;
+
+out:
+  start = zsurf_get_time_ns();
+  scale_destroy(toplevels, run);
+  bench_sync(scale->display);
+  run->destroy_ns = zsurf_get_time_ns() - start;
+  free(toplevels);
+
+  return ret;
+}
+
+static void
+write_run(FILE* out, struct scale_run* run, bool first)
+{
+  fprintf(out,
+      "%s\n    {\"toplevels\": %u, \"children\": %u, \"views\": %" PRIu64
+      ", \"fds\": %" PRIu64 ", \"mappings\": %" PRIu64
+      ", \"rss_bytes\": %" PRIu64 ", \"build_ns\": %" PRIu64
+      ", \"destroy_ns\": %" PRIu64
+      ", \"frames\": %u, \"requests_per_frame\": %.1f"
+      ", \"events_per_frame\": %.1f, \"client_cpu_ns_per_frame\": %.0f"
+      ", \"process_cpu_ns_per_frame\": %.0f, \"wall_ns_per_frame\": %.0f}",
+      first ? "" : ",", run->toplevel_count, run->child_count, run->views,
+      run->usage.fds, run->usage.mappings, run->usage.rss_bytes,
+      run->build_ns, run->destroy_ns, run->frames, run->requests_per_frame,
+      run->events_per_frame, run->client_cpu_ns_per_frame,
+      run->process_cpu_ns_per_frame, run->wall_ns_per_frame);
+}
+
+/**
+ * Compare each metric per view between the smallest and the largest scene.
+ * return the number of metrics whose per-view cost grew beyond the threshold
+ */
+static int
+write_flags(FILE* out, struct scale_run* runs, int count, double threshold)
+{
+  struct scale_run *small = &runs[0], *large = &runs[0];
+  int flagged = 0;
+
+  for (int i = 1; i < count; i++) {
+    if (runs[i].views < small->views) small = &runs[i];
+    if (runs[i].views > large->views) large = &runs[i];
+  }
+
+  struct {
+    const char* name;
+    double small, large;
+  } metrics[] = {
+      {"fds", small->usage.fds, large->usage.fds},
+      {"mappings", small->usage.mappings, large->usage.mappings},
+      {"rss_bytes", small->usage.rss_bytes, large->usage.rss_bytes},
+      {"build_ns", small->build_ns, large->build_ns},
+      {"destroy_ns", small->destroy_ns, large->destroy_ns},
+      {"requests_per_frame", small->requests_per_frame,
+          large->requests_per_frame},
+      {"client_cpu_ns_per_frame", small->client_cpu_ns_per_frame,
+          large->client_cpu_ns_per_frame},
+  };
+
+  fprintf(out, "\n  ],\n  \"superlinear\": [");
+
+  for (size_t i = 0; i < sizeof metrics / sizeof metrics[0]; i++) {
+    if (large->views == small->views || metrics[i].small <= 0) continue;
+
+    double ratio = (metrics[i].large / large->views) /
+                   (metrics[i].small / small->views);
+    if (ratio <= threshold) continue;
+
+    fprintf(out,
+        "%s\n    {\"metric\": \"%s\", \"per_view_ratio\": %.2f, "
+        "\"small_views\": %" PRIu64 ", \"large_views\": %" PRIu64 "}",
+        flagged == 0 ? "" : ",", metrics[i].name, ratio, small->views,
+        large->views);
+    flagged++;
+  }
+
+  fprintf(out, "%s]\n}\n", flagged == 0 ? "" : "\n  ");
+
+  return flagged;
+}
+
+static void
+raise_fd_limit(void)
+{
+  struct rlimit limit;
+
+  // every view holds a memfd
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+static void
+print_usage(const char* program)
+{
+  fprintf(stderr,
+      "usage: %s [options]\n"
+      "  -n, --toplevels LIST   toplevel counts (default 1,16,128,512)\n"
+      "  -m, --children LIST    child views per toplevel (default 0,4,16)\n"
+      "  -F, --frames N         animated frames per scene (default 60)\n"
+      "  -T, --threshold X      per-view growth flagged as superlinear "
+      "(default 2.0)\n"
+      "  -s, --strict           exit with 2 when anything is flagged\n"
+      "  -o, --output PATH      write the JSON results to PATH\n",
+      program);
+}
+
+static int
+parse_list(const char* text, uint32_t* values, int max)
+{
+  char* end;
+  int count = 0;
+
+  while (*text && count < max) {
+    values[count++] = strtoul(text, &end, 10);
+    if (*end != ',') break;
+    text = end + 1;
+  }
+
+  return count;
+}
+
+int
+main(int argc, char* argv[])
+{
+  struct zsurf_mock_options options = {.frame_rate = 0};
+  const struct option long_options[] = {
+      {"toplevels", required_argument, NULL, 'n'},
+      {"children", required_argument, NULL, 'm'},
+      {"frames", required_argument, NULL, 'F'},
+      {"threshold", required_argument, NULL, 'T'},
+      {"strict", no_argument, NULL, 's'},
+      {"output", required_argument, NULL, 'o'},
+      {"help", no_argument, NULL, 'h'},
+      {0, 0, 0, 0},
+  };
+  struct scale scale = {.frames = 60, .threshold = 2.0};
+  struct scale_run runs[SCALE_MAX_COUNTS * SCALE_MAX_COUNTS];
+  uint32_t toplevel_counts[SCALE_MAX_COUNTS] = {1, 16, 128, 512};
+  uint32_t child_counts[SCALE_MAX_COUNTS] = {0, 4, 16};
+  int toplevel_count = 4, child_count = 3, run_count = 0, flagged;
+  bool strict = false, ready = false;
+  const char* output = NULL;
+  FILE* out = stdout;
+  int c, ret = EXIT_FAILURE;
+
+  while ((c = getopt_long(argc, argv, "n:m:F:T:so:h", long_options, NULL)) !=
+         -1) {
+    switch (c) {
+      case 'n':
+        toplevel_count = parse_list(optarg, toplevel_counts, SCALE_MAX_COUNTS);
+        break;
+      case 'm':
+        child_count = parse_list(optarg, child_counts, SCALE_MAX_COUNTS);
+        break;
+      case 'F':
+        scale.frames = strtoul(optarg, NULL, 10);
+        break;
+      case 'T':
+        scale.threshold = strtod(optarg, NULL);
+        break;
+      case 's':
+        strict = true;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if (scale.frames == 0) scale.frames = 1;
+
+  raise_fd_limit();
+
+  scale.pixels =
+      calloc(SCALE_ROOT_SIZE * SCALE_ROOT_SIZE, sizeof *scale.pixels);
+  if (scale.pixels == NULL) goto err;
+
+  scale.mock = zsurf_mock_create(&options);
+  if (scale.mock == NULL) {
+    fprintf(stderr, "failed to create the mock compositor\n");
+    goto err_mock;
+  }
+
+  if (zsurf_mock_start(scale.mock) != 0) goto err_start;
+
+  scale.display = zsurf_display_create(
+      zsurf_mock_get_socket(scale.mock), &bench_display_interface, &ready);
+  if (scale.display == NULL) {
+    fprintf(stderr, "failed to connect to the mock compositor\n");
+    goto err_display;
+  }
+
+  if (output) {
+    out = fopen(output, "w");
+    if (out == NULL) {
+      perror(output);
+      goto err_output;
+    }
+  }
+
+  fprintf(out, "{\n  \"runs\": [");
+
+  for (int i = 0; i < toplevel_count; i++) {
+    for (int j = 0; j < child_count; j++) {
+      struct scale_run* run = &runs[run_count];
+
+      memset(run, 0, sizeof *run);
+      run->toplevel_count = toplevel_counts[i];
+      run->child_count = child_counts[j];
+
+      if (scale_run(&scale, run) != 0) {
+        fprintf(stderr, "scene of %u toplevels with %u children failed\n",
+            run->toplevel_count, run->child_count);
+        continue;
+      }
+
+      write_run(out, run, run_count == 0);
+      fflush(out);
+      run_count++;
+    }
+  }
+
+  flagged = run_count > 0 ? write_flags(out, runs, run_count, scale.threshold)
+                          : 0;
+  if (run_count == 0) fprintf(out, "\n  ]\n}\n");
+
+  if (out != stdout) fclose(out);
+
+  if (run_count > 0) ret = strict && flagged > 0 ? 2 : EXIT_SUCCESS;
+
+err_output:
+  zsurf_display_destroy(scale.display);
+
+err_display:
+  zsurf_mock_stop(scale.mock);
+
+err_start:
+  zsurf_mock_destroy(scale.mock);
+
+err_mock:
+  free(scale.pixels);
+
+err:
+  return ret;
+}
@@ -78,12 +78,10 @@ pointer_button(void *data, uint32_t serial, uint32_t time, uint32_t button,
 }
 
 static void
-keyboard_keymap(void *data, uint32_t format, int fd, uint32_t size)
+keyboard_keymap(void *data, struct zsurf_keymap *keymap)
 {
   (void)data;
-  (void)format;
-  (void)fd;
-  (void)size;
+  (void)keymap;
 }
 
 static void
@@ -1,6 +1,7 @@
 #ifndef ZSURFACE_H
 #define ZSURFACE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 enum zsurf_seat_capability {
@@ -13,12 +14,19 @@ enum zsurf_pointer_button_state {
   ZSURF_POINTER_BUTTON_STATE_PRESSED = 1,
 };
 
+enum zsurf_keyboard_key_state {
+  ZSURF_KEYBOARD_KEY_STATE_RELEASED = 0,
+  ZSURF_KEYBOARD_KEY_STATE_PRESSED = 1,
+};
+
 struct zsurf_view;
 
 struct zsurf_toplevel;
 
 struct zsurf_display;
 
+struct zsurf_keymap;
+
 struct zsurf_color_bgra {
   uint8_t b, g, r, a;
 };
@@ -38,17 +46,232 @@ int zsurf_view_set_texture(struct zsurf_view* view,
     struct zsurf_color_bgra* data, uint32_t width, uint32_t height);
 
 /**
+ * Pixel formats named by their byte order in memory. Unless premultiplied,
+ * color is not multiplied by alpha, as in zsurf_color_bgra. BGRX8888, RGB565
+ * and R8 are sent to the compositor as they are when it supports them, and
+ * are converted to BGRA8888 otherwise.
+ */
+enum zsurf_pixel_format {
+  ZSURF_PIXEL_FORMAT_BGRA8888 = 0,  // struct zsurf_color_bgra
+  ZSURF_PIXEL_FORMAT_RGBA8888,
+  ZSURF_PIXEL_FORMAT_RGB888,  // opaque, 3 bytes per pixel
+  ZSURF_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED,
+  ZSURF_PIXEL_FORMAT_BGRX8888,  // opaque, the 4th byte is ignored
+  ZSURF_PIXEL_FORMAT_RGB565,    // opaque, little endian, red in the top bits
+  ZSURF_PIXEL_FORMAT_R8,        // gray
+};
+
+/**
+ * Like zsurf_view_set_texture, converting data of the given format on the
+ * way. stride is the number of bytes between rows, 0 for packed rows.
+ * return -1 when failed to truncate a shared memory file or the format is
+ * unknown
+ */
+int zsurf_view_set_texture_format(struct zsurf_view* view, const void* data,
+    enum zsurf_pixel_format format, uint32_t stride, uint32_t width,
+    uint32_t height);
+
+enum zsurf_yuv_format {
+  ZSURF_YUV_FORMAT_NV12 = 0,  // y plane, then interleaved u v plane
+  ZSURF_YUV_FORMAT_I420,      // y, u and v planes
+};
+
+/**
+ * Upload 4:2:0 video frames in BT.601 limited range. The planes go to the
+ * compositor as they are and are converted to rgb by its shader; when it
+ * lacks R8 textures they are converted on the cpu instead. NV12 uses the
+ * first two planes. width and height must be even.
+ * return -1 when failed to truncate a shared memory file or the size is odd
+ */
+int zsurf_view_set_texture_yuv(struct zsurf_view* view,
+    enum zsurf_yuv_format format, const uint8_t* const planes[3],
+    const uint32_t strides[3], uint32_t width, uint32_t height);
+
+// larger textures cannot go to the atlas
+#define ZSURF_ATLAS_MAX_SIZE 256
+
+/**
+ * Like zsurf_view_set_texture for small textures such as cursors, icons and
+ * badges: the pixels are packed into a texture shared by the display's small
+ * views, so hundreds of them upload a handful of textures. Placing a view
+ * can repack a shared texture into a new one; other views keep showing the
+ * old one until their toplevel commits. The other zsurf_view_set_texture
+ * functions take the view out of the atlas.
+ * return -1 when width or height is over ZSURF_ATLAS_MAX_SIZE or failed to
+ * create a shared texture
+ */
+int zsurf_view_set_texture_atlas(struct zsurf_view* view,
+    const struct zsurf_color_bgra* data, uint32_t width, uint32_t height);
+
+#define ZSURF_VIEW_MAX_LAYERS 4
+
+/**
+ * Set one layer of a view made of up to ZSURF_VIEW_MAX_LAYERS bgra layers of
+ * the same size, blended over each other from layer 0 up on the compositor's
+ * GPU. Only the given layer is copied, so a static background is uploaded
+ * once while a small overlay changes every frame. Layers added by this call
+ * and all other layers on a size change start transparent. The other
+ * zsurf_view_set_texture functions go back to a single layer. A layered view
+ * is kept out of memory budget reclaim.
+ * return -1 when failed to truncate a shared memory file or layer is too
+ * large, 1 when the view was reclaimed before and the other layers were
+ * cleared; set them again then
+ */
+int zsurf_view_set_texture_layer(struct zsurf_view* view, uint32_t layer,
+    const struct zsurf_color_bgra* data, uint32_t width, uint32_t height);
+
+/**
+ * Transform the colors of the view on the compositor's GPU, without touching
+ * the texture: rgba * multiply + add, clamped, then alpha * opacity. multiply
+ * and add are rgba, NULL for the identity. Shown on the next commit.
+ */
+void zsurf_view_set_color_transform(struct zsurf_view* view, float opacity,
+    const float multiply[4], const float add[4]);
+
+/**
+ * Show only the given rectangle of the texture, in texture pixels, stretched
+ * over the view. Panning or zooming a texture uploaded once then costs a
+ * vertex buffer update. Pointer coordinates are reported in the texture's
+ * pixels. A width or height of 0 shows the whole texture again.
+ */
+void zsurf_view_set_source(
+    struct zsurf_view* view, float x, float y, float width, float height);
+
+/**
+ * Resize the texture to width x height bgra pixels, packed, and return its
+ * shared memory to draw into before the next commit. The previous contents
+ * stay when the size does not change, and the view is then kept out of
+ * memory budget reclaim. They are transparent if the view was reclaimed
+ * before this call, after a zsurf_view_set_texture; draw everything then.
  * return NULL when failed to trancate a shared memory file
  */
 struct zsurf_color_bgra* zsurf_view_get_texture_buffer(
     struct zsurf_view* view, uint32_t width, uint32_t height);
 
+struct zsurf_rect {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+};
+
+/**
+ * Move the pixels of rect inside the texture dy rows down, up when negative,
+ * without uploading them again. Pixels moved out of rect are dropped, the
+ * exposed strip keeps its old contents for the app to draw through
+ * zsurf_view_get_texture_buffer. Shown on the next commit. Like that
+ * function, it keeps the view out of memory budget reclaim.
+ * return -1 when rect is out of the texture or the texture is yuv or layered,
+ * or when the view was reclaimed before; draw everything again then
+ */
+int zsurf_view_scroll(
+    struct zsurf_view* view, const struct zsurf_rect* rect, int32_t dy);
+
 void zsurf_view_commit(struct zsurf_view* view);
 
+struct zsurf_batch;
+
+struct zsurf_batch_quad {
+  int32_t sx;  // top left, in the parent's surface pixels
+  int32_t sy;
+  uint32_t width;  // in the parent's surface pixels
+  uint32_t height;
+  struct zsurf_rect source;  // of the quad's texture, 0 width for all of it
+  int32_t z;                 // above the batch, larger is nearer
+};
+
+/**
+ * Draw up to capacity textured quads over parent with one component, one
+ * vertex buffer and one texture shared by the quads, instead of a view each.
+ * Quads are not picked, pointer events go to parent in its surface pixels.
+ * Changes are shown with the next commit of the toplevel. Destroy the batch
+ * before its parent.
+ * return NULL when failed to create its shared memory
+ */
+struct zsurf_batch* zsurf_batch_create(
+    struct zsurf_view* parent, uint32_t capacity);
+
+void zsurf_batch_destroy(struct zsurf_batch* batch);
+
+/**
+ * Place quad index; only its 6 vertices are rewritten. A quad without a
+ * texture is not drawn.
+ * return -1 when index is not below the capacity
+ */
+int zsurf_batch_set_quad(struct zsurf_batch* batch, uint32_t index,
+    const struct zsurf_batch_quad* quad);
+
+/**
+ * Set the bgra texture of quad index, up to ZSURF_ATLAS_MAX_SIZE square.
+ * return -1 when index is not below the capacity, the texture is too large
+ * or the batch's texture is full
+ */
+int zsurf_batch_set_quad_texture(struct zsurf_batch* batch, uint32_t index,
+    const struct zsurf_color_bgra* data, uint32_t width, uint32_t height);
+
+/**
+ * stop drawing quad index and free its part of the batch's texture
+ */
+void zsurf_batch_clear_quad(struct zsurf_batch* batch, uint32_t index);
+
+struct zsurf_memory_stats {
+  uint64_t reserved_bytes;   // shared memory backing the views
+  uint64_t used_bytes;       // part of it holding the current contents
+  uint64_t in_flight_bytes;  // textures the compositor has not released yet
+};
+
+void zsurf_view_get_memory_stats(
+    struct zsurf_view* view, struct zsurf_memory_stats* stats);
+
+/**
+ * return NULL while the toplevel waits for its display to be ready
+ */
 struct zsurf_view* zsurf_toplevel_get_view(struct zsurf_toplevel* topelevel);
 
 void zsurf_toplevel_move(struct zsurf_toplevel* toplevel, uint32_t serial);
 
+/**
+ * Time from an input event delivered to the toplevel until the compositor
+ * presents the first commit that follows it, both on the compositor's clock.
+ * Percentiles have a resolution of 1ms and saturate at 255ms.
+ */
+struct zsurf_latency_stats {
+  uint64_t count;    // inputs matched to a presented frame
+  uint64_t dropped;  // inputs not measured, too many frames were pending
+  uint32_t min_ms;
+  uint32_t max_ms;
+  double mean_ms;
+  uint32_t p50_ms;
+  uint32_t p90_ms;
+  uint32_t p99_ms;
+};
+
+void zsurf_toplevel_get_latency_stats(
+    struct zsurf_toplevel* toplevel, struct zsurf_latency_stats* stats);
+
+void zsurf_toplevel_reset_latency_stats(struct zsurf_toplevel* toplevel);
+
+/**
+ * Adapt the resolution to the app's render time, from a frame callback to
+ * the next commit of the toplevel: the scale goes down when frames take
+ * longer than target_us and back up, toward 1, when they take well below
+ * it. Render the toplevel and its children at their size times
+ * zsurf_toplevel_get_resolution_scale; the cuboid keeps its physical size
+ * and pointer coordinates are in the smaller texture's pixels. The scale
+ * changes at most every 16 frames. target_us 0 turns it off and the scale
+ * back to 1.
+ */
+void zsurf_toplevel_set_adaptive_resolution(
+    struct zsurf_toplevel* toplevel, uint32_t target_us, float min_scale);
+
+float zsurf_toplevel_get_resolution_scale(struct zsurf_toplevel* toplevel);
+
+/**
+ * Before an async display is ready, the toplevel is queued and its view is
+ * built right before ready is reported. It stays without a view if the
+ * display fails to start or the view fails to build. A toplevel still queued
+ * when its display is destroyed can only be destroyed.
+ */
 struct zsurf_toplevel* zsurf_toplevel_create(
     struct zsurf_display* surface_display, void* view_user_data);
 
@@ -63,7 +286,10 @@ struct zsurf_display_interface {
   void (*pointer_button)(void* data, uint32_t serial, uint32_t time,
       uint32_t button, enum zsurf_pointer_button_state state);
 
-  void (*keyboard_keymap)(void* data, uint32_t format, int fd, uint32_t size);
+  /**
+   * called when the keymap changes, a keymap sent again is not reported
+   */
+  void (*keyboard_keymap)(void* data, struct zsurf_keymap* keymap);
   void (*keyboard_enter)(void* data, uint32_t serial, struct zsurf_view* view,
       uint32_t* keys, uint32_t key_count);
   void (*keyboard_leave)(void* data, uint32_t serial, struct zsurf_view* view);
@@ -72,8 +298,50 @@ struct zsurf_display_interface {
   void (*keyboard_modifiers)(void* data, uint32_t serial,
       uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked,
       uint32_t group);
+
+  /**
+   * only for zsurf_display_create_async, can be NULL. success is false when
+   * the compositor lacks a required global or a queued toplevel failed to
+   * build its view; destroy the display then.
+   */
+  void (*ready)(void* data, bool success);
+
+  /**
+   * can be NULL. called once when the reserved memory stays above the budget
+   * after idle views have been reclaimed, again after it went below.
+   */
+  void (*memory_budget_exceeded)(
+      void* data, uint64_t reserved_bytes, uint64_t budget_bytes);
 };
 
+/**
+ * Read-only mapping of the keymap sent by the compositor. The pointer stays
+ * valid while the keymap is the current one.
+ */
+const char* zsurf_keymap_get_data(struct zsurf_keymap* keymap, uint32_t* size);
+
+/**
+ * same as the keymap format enum of wl_keyboard
+ */
+uint32_t zsurf_keymap_get_format(struct zsurf_keymap* keymap);
+
+/**
+ * changes only when the compositor sends a keymap with different content
+ */
+uint64_t zsurf_keymap_get_generation(struct zsurf_keymap* keymap);
+
+/**
+ * key is an evdev keycode as given to keyboard_key.
+ * return the level 0 keysym of the first layout, 0 (NoSymbol) if none
+ */
+uint32_t zsurf_keymap_key_get_keysym(struct zsurf_keymap* keymap, uint32_t key);
+
+/**
+ * return NULL before the compositor sent a keymap
+ */
+struct zsurf_keymap* zsurf_display_get_keymap(
+    struct zsurf_display* surface_display);
+
 /**
  * data param can be NULL
  */
@@ -81,9 +349,39 @@ void zsurf_display_set_cursor(struct zsurf_display* surface_display,
     struct zsurf_color_bgra* data, uint32_t width, uint32_t height,
     int32_t hotspot_x, int32_t hotspot_y);
 
+/**
+ * Repeat the last pressed key through keyboard_key. rate is in repeats per
+ * second, 0 disables repeating (the default); delay is in milliseconds.
+ */
+void zsurf_display_set_keyboard_repeat(
+    struct zsurf_display* surface_display, int32_t rate, int32_t delay);
+
+/**
+ * Keep up to size views prebuilt for zsurf_toplevel_create and
+ * zsurf_display_set_cursor. The pool is refilled one view at a time when
+ * zsurf_display_dispatch or a display group is about to wait, and destroyed
+ * views are recycled into it.
+ */
+void zsurf_display_set_view_pool_size(
+    struct zsurf_display* surface_display, uint32_t size);
+
+/**
+ * build every missing pooled view now.
+ * return -1 when the display is not ready or failed to build a view
+ */
+int zsurf_display_fill_view_pool(struct zsurf_display* surface_display);
+
 struct zsurf_display* zsurf_display_create(const char* socket,
     const struct zsurf_display_interface* interface, void* user_data);
 
+/**
+ * Return right after connecting, without waiting for the compositor. Dispatch
+ * the display as usual; toplevels created before ready is reported are
+ * queued until then.
+ */
+struct zsurf_display* zsurf_display_create_async(const char* socket,
+    const struct zsurf_display_interface* interface, void* user_data);
+
 void zsurf_display_destroy(struct zsurf_display* z_display);
 
 int zsurf_display_prepare_read(struct zsurf_display* z_display);
@@ -96,8 +394,145 @@ void zsurf_display_cancel_read(struct zsurf_display* z_display);
 
 int zsurf_display_read_events(struct zsurf_display* z_display);
 
+/**
+ * the fd becomes readable when either the connection or an internal timer
+ * needs dispatching
+ */
 int zsurf_display_get_fd(struct zsurf_display* z_display);
 
 int zsurf_display_dispatch(struct zsurf_display* z_display);
 
+struct zsurf_display_group;
+
+/**
+ * counters are only updated while the display is dispatched by a group
+ */
+struct zsurf_display_stats {
+  uint64_t wakeups;     // times the display fd was reported readable
+  uint64_t dispatches;  // dispatch passes over the connection
+  uint64_t events;      // events dispatched
+  uint64_t dispatch_time_ns;
+  uint64_t max_dispatch_time_ns;
+  int error;  // errno of the fatal connection error, 0 if none
+};
+
+void zsurf_display_get_stats(
+    struct zsurf_display* z_display, struct zsurf_display_stats* stats);
+
+/**
+ * Log the events the display receives and the requests made through it to a
+ * compact binary file that zsurface-replay can play back. Pixel data is not
+ * recorded. Setting ZSURFACE_RECORD=path records the first display created.
+ * return -1 when failed to open path
+ */
+int zsurf_display_record_start(
+    struct zsurf_display* surface_display, const char* path);
+
+void zsurf_display_record_stop(struct zsurf_display* surface_display);
+
+/**
+ * Toplevels that do not have the ray and got no input for idle_ms have
+ * their frame callbacks held back, so that they draw at about fraction of
+ * the compositor's frame rate. Input restores the full rate at once. A
+ * fraction of 1, the default, turns throttling off.
+ */
+void zsurf_display_set_idle_throttle(
+    struct zsurf_display* surface_display, uint32_t idle_ms, float fraction);
+
+void zsurf_display_get_memory_stats(struct zsurf_display* surface_display,
+    struct zsurf_memory_stats* stats);
+
+/**
+ * Above budget_bytes of reserved memory, the texture store of pooled views
+ * and of views that have not drawn or asked for a frame for a second is
+ * handed back to the kernel. The compositor keeps showing what it got; the
+ * store comes back on the next zsurf_view_set_texture. Views drawn in place
+ * through zsurf_view_get_texture_buffer, zsurf_view_scroll or
+ * zsurf_view_set_texture_layer are not reclaimed until set with
+ * zsurf_view_set_texture again. 0 disables the budget.
+ */
+void zsurf_display_set_memory_budget(
+    struct zsurf_display* surface_display, uint64_t budget_bytes);
+
+/**
+ * reclaim every idle view now. return the number of bytes handed back
+ */
+uint64_t zsurf_display_reclaim_memory(struct zsurf_display* surface_display);
+
+struct zsurf_display_group* zsurf_display_group_create(void);
+
+void zsurf_display_group_destroy(struct zsurf_display_group* group);
+
+/**
+ * return -1 when failed to add the display to the epoll set
+ */
+int zsurf_display_group_add(
+    struct zsurf_display_group* group, struct zsurf_display* z_display);
+
+void zsurf_display_group_remove(
+    struct zsurf_display_group* group, struct zsurf_display* z_display);
+
+/**
+ * epoll fd of the group, readable when any member needs dispatching
+ */
+int zsurf_display_group_get_fd(struct zsurf_display_group* group);
+
+/**
+ * Flush and read every member, then dispatch the ready ones in round-robin
+ * order. timeout is in milliseconds as in epoll_wait, -1 blocks.
+ * return the number of dispatched displays, -1 when epoll failed. A member
+ * whose connection breaks is dropped from the epoll set and reports the
+ * error through its stats.
+ */
+int zsurf_display_group_dispatch(
+    struct zsurf_display_group* group, int timeout);
+
+enum zsurf_log_level {
+  ZSURF_LOG_LEVEL_ERROR = 0,
+  ZSURF_LOG_LEVEL_WARN = 1,
+  ZSURF_LOG_LEVEL_INFO = 2,
+  ZSURF_LOG_LEVEL_DEBUG = 3,
+};
+
+/**
+ * message is not NUL terminated and usually ends with a newline
+ */
+typedef void (*zsurf_log_sink_func_t)(void* data, enum zsurf_log_level level,
+    const char* message, uint32_t length);
+
+/**
+ * Messages above level are dropped before formatting. The default is info,
+ * or the ZSURFACE_LOG_LEVEL environment variable (error, warn, info, debug).
+ */
+void zsurf_log_set_level(enum zsurf_log_level level);
+
+/**
+ * Messages are buffered per thread and handed to sink on flush. sink can be
+ * NULL to write to stderr, the default. The sink is called with an internal
+ * lock held and must not log.
+ */
+void zsurf_log_set_sink(zsurf_log_sink_func_t sink, void* data);
+
+/**
+ * Hand every buffered message to the sink. Also done when a display
+ * dispatches, on errors, when a thread's buffer runs full, and at exit.
+ */
+void zsurf_log_flush(void);
+
+/**
+ * Record the library's hot paths (commit, texture copy, resize, geometry
+ * update, frame callback, input dispatch and pick) into per-thread rings.
+ * Setting ZSURFACE_TRACE=path in the environment enables recording at load
+ * and dumps to path at exit. No-op when built with -Dtrace=false.
+ */
+void zsurf_trace_set_enabled(bool enabled);
+
+/**
+ * Write the recorded events as Chrome trace JSON. Timestamps are
+ * CLOCK_MONOTONIC in microseconds, so spans of the app taken from the same
+ * clock line up.
+ * return -1 when failed to write the file or tracing is compiled out
+ */
+int zsurf_trace_dump(const char* path);
+
 #endif  //  ZSURFACE_H
@@ -0,0 +1,105 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mock.h"
+
+static struct zsurf_mock* mock;
+
+static void
+print_usage(const char* program)
+{
+  fprintf(stderr,
+      "usage: %s [options]\n"
+      "  -s, --socket NAME      socket name, a free wayland-N by default\n"
+      "  -f, --frame-rate HZ    frame clock, 0 answers on commit (default 60)\n"
+      "  -r, --ray-rate HZ      ray motions per second (default 0)\n"
+      "  -k, --key-rate HZ      key events per second (default 0)\n"
+      "  -o, --stats PATH       write the stats as JSON to PATH on exit\n",
+      program);
+}
+
+static void
+handle_signal(int signal_number)
+{
+  (void)signal_number;
+  zsurf_mock_stop(mock);
+}
+
+int
+main(int argc, char* argv[])
+{
+  struct zsurf_mock_options options = {
+      .socket = NULL,
+      .frame_rate = 60,
+      .ray_rate = 0,
+      .key_rate = 0,
+  };
+  const struct option long_options[] = {
+      {"socket", required_argument, NULL, 's'},
+      {"frame-rate", required_argument, NULL, 'f'},
+      {"ray-rate", required_argument, NULL, 'r'},
+      {"key-rate", required_argument, NULL, 'k'},
+      {"stats", required_argument, NULL, 'o'},
+      {"help", no_argument, NULL, 'h'},
+      {0, 0, 0, 0},
+  };
+  struct sigaction action = {.sa_handler = handle_signal};
+  const char* stats_path = NULL;
+  FILE* file;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "s:f:r:k:o:h", long_options, NULL)) !=
+         -1) {
+    switch (c) {
+      case 's':
+        options.socket = optarg;
+        break;
+      case 'f':
+        options.frame_rate = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        options.ray_rate = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        options.key_rate = strtoul(optarg, NULL, 10);
+        break;
+      case 'o':
+        stats_path = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  mock = zsurf_mock_create(&options);
+  if (mock == NULL) {
+    fprintf(stderr, "failed to create the mock compositor\n");
+    return EXIT_FAILURE;
+  }
+
+  // wl_display_terminate only writes to an eventfd, safe in a handler
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  printf("%s\n", zsurf_mock_get_socket(mock));
+  fflush(stdout);
+
+  zsurf_mock_run(mock);
+
+  if (stats_path) {
+    file = fopen(stats_path, "w");
+    if (file) {
+      zsurf_mock_write_stats_json(mock, file);
+      fclose(file);
+    } else {
+      perror(stats_path);
+    }
+  }
+
+  zsurf_mock_destroy(mock);
+
+  return EXIT_SUCCESS;
+}
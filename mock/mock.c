@@ -0,0 +1,844 @@
+#define _GNU_SOURCE
+
+#include "mock.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server.h>
+#include <zigen-opengl-server-protocol.h>
+#include <zigen-server-protocol.h>
+#include <zigen-shell-server-protocol.h>
+
+#define MOCK_MAX_MESSAGES 256  // power of two
+#define MOCK_KEY_CODE 30       // KEY_A
+#define MOCK_BUTTON_PERIOD 30  // ray motions between button presses
+#define UNUSED(x) ((void)x)
+
+static const char mock_keymap[] =
+    "xkb_keymap {\n"
+    "  xkb_keycodes \"mock\" { minimum = 8; maximum = 255; <AC01> = 38; };\n"
+    "  xkb_types \"mock\" {\n"
+    "    type \"ONE_LEVEL\" {\n"
+    "      modifiers = none; level_name[Level1] = \"Any\";\n"
+    "    };\n"
+    "  };\n"
+    "  xkb_compatibility \"mock\" { };\n"
+    "  xkb_symbols \"mock\" { key <AC01> { [ a ] }; };\n"
+    "};\n";
+
+struct mock_message_entry {
+  const struct wl_message* message;  // NULL if the slot is empty
+  struct zsurf_mock_message_stats stats;
+};
+
+struct mock_global {
+  struct zsurf_mock* mock;
+  const struct wl_interface* interface;
+};
+
+struct mock_object {
+  struct zsurf_mock* mock;
+  struct wl_resource* resource;
+  struct wl_list link;  // one of the object lists of zsurf_mock, or empty
+
+  // zgn_virtual_object
+  struct wl_list frame_list;            // wl_callback resources
+  struct wl_list committed_frame_list;  // wl_callback resources
+
+  // zgn_cuboid_window
+  struct mock_object* virtual_object;  // nullable
+  float half_size[3];
+  float quaternion[4];
+
+  // zgn_ray, zgn_keyboard
+  struct mock_object* entered;  // nullable, virtual object with the focus
+  uint64_t step;
+};
+
+struct zsurf_mock {
+  struct wl_display* display;
+  struct wl_event_loop* loop;
+  const char* socket;
+  struct zsurf_mock_options options;
+  struct wl_protocol_logger* logger;
+  struct mock_global globals[4];
+
+  struct wl_list virtual_object_list;
+  struct wl_list cuboid_window_list;
+  struct wl_list ray_list;
+  struct wl_list keyboard_list;
+
+  int frame_fd, ray_fd, key_fd;  // -1 if disabled
+  struct wl_event_source *frame_source, *ray_source, *key_source;
+
+  pthread_t thread;
+  bool thread_running;
+
+  pthread_mutex_t stats_lock;
+  struct zsurf_mock_stats stats;
+  struct mock_message_entry messages[MOCK_MAX_MESSAGES];
+};
+
+static uint64_t
+mock_get_time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t
+mock_get_time_ms(void)
+{
+  return (uint32_t)(mock_get_time_ns() / 1000000);
+}
+
+/**
+ * call with stats_lock held. return NULL when the table is full
+ */
+static struct zsurf_mock_message_stats*
+mock_message_stats(struct zsurf_mock* mock, const struct wl_message* message,
+    const char* interface, enum zsurf_mock_direction direction)
+{
+  uint32_t index = ((uintptr_t)message >> 4) & (MOCK_MAX_MESSAGES - 1);
+
+  for (int i = 0; i < MOCK_MAX_MESSAGES; i++) {
+    struct mock_message_entry* entry = &mock->messages[index];
+    if (entry->message == message) return &entry->stats;
+    if (entry->message == NULL) {
+      entry->message = message;
+      entry->stats.interface = interface;
+      entry->stats.message = message->name;
+      entry->stats.direction = direction;
+      return &entry->stats;
+    }
+    index = (index + 1) & (MOCK_MAX_MESSAGES - 1);
+  }
+
+  return NULL;
+}
+
+static void
+mock_protocol_logger(void* data, enum wl_protocol_logger_type type,
+    const struct wl_protocol_logger_message* message)
+{
+  struct zsurf_mock* mock = data;
+  struct zsurf_mock_message_stats* stats;
+  enum zsurf_mock_direction direction = type == WL_PROTOCOL_LOGGER_REQUEST
+                                            ? ZSURF_MOCK_DIRECTION_REQUEST
+                                            : ZSURF_MOCK_DIRECTION_EVENT;
+  uint64_t now = mock_get_time_ns();
+
+  pthread_mutex_lock(&mock->stats_lock);
+
+  if (direction == ZSURF_MOCK_DIRECTION_REQUEST)
+    mock->stats.requests++;
+  else
+    mock->stats.events++;
+
+  stats = mock_message_stats(mock, message->message,
+      wl_resource_get_class(message->resource), direction);
+  if (stats) {
+    if (stats->count == 0) stats->first_ns = now;
+    stats->last_ns = now;
+    stats->count++;
+  }
+
+  pthread_mutex_unlock(&mock->stats_lock);
+}
+
+static void
+mock_record_handle_time(struct zsurf_mock* mock,
+    const struct wl_message* message, const char* interface, uint64_t elapsed)
+{
+  struct zsurf_mock_message_stats* stats;
+
+  pthread_mutex_lock(&mock->stats_lock);
+  mock->stats.request_time_ns += elapsed;
+  stats = mock_message_stats(
+      mock, message, interface, ZSURF_MOCK_DIRECTION_REQUEST);
+  if (stats) stats->handle_time_ns += elapsed;
+  pthread_mutex_unlock(&mock->stats_lock);
+}
+
+static void
+mock_stats_add(struct zsurf_mock* mock, uint64_t* counter, uint64_t value)
+{
+  pthread_mutex_lock(&mock->stats_lock);
+  *counter += value;
+  pthread_mutex_unlock(&mock->stats_lock);
+}
+
+static void
+mock_destroy_callbacks(struct wl_list* list)
+{
+  while (!wl_list_empty(list))
+    wl_resource_destroy(wl_resource_from_link(list->next));
+}
+
+static void
+mock_callback_destroy(struct wl_resource* resource)
+{
+  wl_list_remove(wl_resource_get_link(resource));
+}
+
+static uint64_t
+mock_send_frame_done(struct mock_object* virtual_object, uint32_t time)
+{
+  struct wl_list* list = &virtual_object->committed_frame_list;
+  struct wl_resource* callback;
+  uint64_t count = 0;
+
+  while (!wl_list_empty(list)) {
+    callback = wl_resource_from_link(list->next);
+    wl_callback_send_done(callback, time);
+    wl_resource_destroy(callback);
+    count++;
+  }
+
+  return count;
+}
+
+static void
+mock_object_destroy(struct wl_resource* resource)
+{
+  struct mock_object* object = wl_resource_get_user_data(resource);
+  struct zsurf_mock* mock = object->mock;
+  struct mock_object* other;
+
+  wl_list_remove(&object->link);
+
+  if (wl_resource_get_class(resource) ==
+      zgn_virtual_object_interface.name) {
+    mock_destroy_callbacks(&object->frame_list);
+    mock_destroy_callbacks(&object->committed_frame_list);
+
+    wl_list_for_each(other, &mock->cuboid_window_list, link)
+    {
+      if (other->virtual_object == object) other->virtual_object = NULL;
+    }
+    wl_list_for_each(other, &mock->ray_list, link)
+    {
+      if (other->entered == object) other->entered = NULL;
+    }
+    wl_list_for_each(other, &mock->keyboard_list, link)
+    {
+      if (other->entered == object) other->entered = NULL;
+    }
+  }
+
+  free(object);
+}
+
+static void
+mock_send_configure(struct mock_object* cuboid_window)
+{
+  struct zsurf_mock* mock = cuboid_window->mock;
+  struct wl_array half_size = {
+      .size = sizeof cuboid_window->half_size,
+      .data = cuboid_window->half_size,
+  };
+  struct wl_array quaternion = {
+      .size = sizeof cuboid_window->quaternion,
+      .data = cuboid_window->quaternion,
+  };
+
+  zgn_cuboid_window_send_configure(cuboid_window->resource,
+      wl_display_next_serial(mock->display), &half_size, &quaternion);
+}
+
+static void
+mock_send_keymap(struct mock_object* keyboard)
+{
+  int fd;
+  void* data;
+
+  fd = memfd_create("zsurface-mock-keymap", MFD_CLOEXEC);
+  if (fd < 0) return;
+
+  if (ftruncate(fd, sizeof mock_keymap) < 0) goto out;
+
+  data = mmap(NULL, sizeof mock_keymap, PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) goto out;
+  memcpy(data, mock_keymap, sizeof mock_keymap);
+  munmap(data, sizeof mock_keymap);
+
+  zgn_keyboard_send_keymap(keyboard->resource, 1,  // xkb_v1
+      fd, sizeof mock_keymap);
+
+out:
+  close(fd);
+}
+
+static int mock_dispatch(const void* implementation, void* target,
+    uint32_t opcode, const struct wl_message* message,
+    union wl_argument* args);
+
+static struct wl_resource*
+mock_create_resource(struct zsurf_mock* mock, struct wl_client* client,
+    const struct wl_interface* interface, int version, uint32_t id)
+{
+  struct wl_resource* resource;
+  struct mock_object* object;
+
+  if (version > interface->version) version = interface->version;
+
+  resource = wl_resource_create(client, interface, version, id);
+  if (resource == NULL) goto err;
+
+  if (interface == &wl_callback_interface) {
+    wl_resource_set_implementation(
+        resource, NULL, NULL, mock_callback_destroy);
+    wl_list_init(wl_resource_get_link(resource));
+    return resource;
+  }
+
+  object = calloc(1, sizeof *object);
+  if (object == NULL) goto err_object;
+
+  object->mock = mock;
+  object->resource = resource;
+  wl_list_init(&object->link);
+  wl_list_init(&object->frame_list);
+  wl_list_init(&object->committed_frame_list);
+
+  wl_resource_set_dispatcher(
+      resource, mock_dispatch, mock, object, mock_object_destroy);
+
+  if (interface == &zgn_virtual_object_interface) {
+    wl_list_insert(&mock->virtual_object_list, &object->link);
+  } else if (interface == &zgn_cuboid_window_interface) {
+    wl_list_insert(&mock->cuboid_window_list, &object->link);
+  } else if (interface == &zgn_ray_interface) {
+    wl_list_insert(&mock->ray_list, &object->link);
+  } else if (interface == &zgn_keyboard_interface) {
+    wl_list_insert(&mock->keyboard_list, &object->link);
+    mock_send_keymap(object);
+  }
+
+  return resource;
+
+err_object:
+  wl_resource_destroy(resource);
+
+err:
+  wl_client_post_no_memory(client);
+  return NULL;
+}
+
+static void
+mock_virtual_object_commit(struct mock_object* virtual_object)
+{
+  struct zsurf_mock* mock = virtual_object->mock;
+  uint64_t count;
+
+  wl_list_insert_list(
+      virtual_object->committed_frame_list.prev, &virtual_object->frame_list);
+  wl_list_init(&virtual_object->frame_list);
+
+  mock_stats_add(mock, &mock->stats.commits, 1);
+
+  if (mock->options.frame_rate != 0) return;
+
+  count = mock_send_frame_done(virtual_object, mock_get_time_ms());
+  if (count == 0) return;
+
+  pthread_mutex_lock(&mock->stats_lock);
+  mock->stats.frames++;
+  mock->stats.frame_callbacks += count;
+  pthread_mutex_unlock(&mock->stats_lock);
+}
+
+static void
+mock_handle_request(struct zsurf_mock* mock, struct wl_resource* resource,
+    const struct wl_message* message, union wl_argument* args)
+{
+  struct mock_object* object = wl_resource_get_user_data(resource);
+  struct wl_client* client = wl_resource_get_client(resource);
+  struct wl_resource *created = NULL, *object_arg = NULL;
+  struct wl_array* array_args[2] = {NULL, NULL};
+  const char* interface = wl_resource_get_class(resource);
+  int array_count = 0;
+
+  // walk the signature to create new objects and pick up arguments
+  for (int i = 0, arg = 0; message->signature[i]; i++) {
+    char type = message->signature[i];
+    if (type == '?' || (type >= '0' && type <= '9')) continue;
+
+    if (type == 'h') {
+      close(args[arg].h);  // fd contents are never read
+    } else if (type == 'n' && message->types[arg]) {
+      created = mock_create_resource(mock, client, message->types[arg],
+          wl_resource_get_version(resource), args[arg].n);
+      if (created == NULL) break;
+    } else if (type == 'o' && object_arg == NULL) {
+      object_arg = (struct wl_resource*)args[arg].o;
+    } else if (type == 'a' && array_count < 2) {
+      array_args[array_count++] = args[arg].a;
+    }
+    arg++;
+  }
+
+  if (strcmp(message->name, "destroy") == 0 ||
+      strcmp(message->name, "release") == 0) {
+    wl_resource_destroy(resource);
+  } else if (interface == zgn_virtual_object_interface.name) {
+    if (strcmp(message->name, "frame") == 0 && created)
+      wl_list_insert(
+          object->frame_list.prev, wl_resource_get_link(created));
+    else if (strcmp(message->name, "commit") == 0)
+      mock_virtual_object_commit(object);
+  } else if (interface == zgn_opengl_texture_interface.name &&
+             strcmp(message->name, "attach_2d") == 0 && object_arg) {
+    // uploads are immediate here, the client may reuse the buffer at once
+    wl_buffer_send_release(object_arg);
+  } else if (interface == zgn_shell_interface.name &&
+             strcmp(message->name, "get_cuboid_window") == 0 && created &&
+             object_arg) {
+    struct mock_object* cuboid_window = wl_resource_get_user_data(created);
+    float* quaternion = cuboid_window->quaternion;
+
+    cuboid_window->virtual_object = wl_resource_get_user_data(object_arg);
+    quaternion[0] = quaternion[1] = quaternion[2] = 0;
+    quaternion[3] = 1;
+    if (array_args[0] &&
+        array_args[0]->size == sizeof cuboid_window->half_size)
+      memcpy(cuboid_window->half_size, array_args[0]->data,
+          sizeof cuboid_window->half_size);
+    if (array_args[1] && array_args[1]->size == sizeof(float) * 4)
+      memcpy(quaternion, array_args[1]->data, sizeof(float) * 4);
+
+    mock_send_configure(cuboid_window);
+  } else if (interface == zgn_cuboid_window_interface.name &&
+             strcmp(message->name, "rotate") == 0) {
+    if (array_args[0] && array_args[0]->size == sizeof object->quaternion) {
+      memcpy(object->quaternion, array_args[0]->data,
+          sizeof object->quaternion);
+      mock_send_configure(object);
+    }
+  }
+}
+
+static int
+mock_dispatch(const void* implementation, void* target, uint32_t opcode,
+    const struct wl_message* message, union wl_argument* args)
+{
+  UNUSED(opcode);
+  struct zsurf_mock* mock = (struct zsurf_mock*)implementation;
+  struct wl_resource* resource = target;
+  const char* interface = wl_resource_get_class(resource);
+  uint64_t start = mock_get_time_ns();
+
+  mock_handle_request(mock, resource, message, args);
+
+  // the resource may be destroyed by now
+  mock_record_handle_time(
+      mock, message, interface, mock_get_time_ns() - start);
+
+  return 0;
+}
+
+static void
+mock_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id)
+{
+  struct mock_global* global = data;
+  struct wl_resource* resource;
+
+  resource = mock_create_resource(
+      global->mock, client, global->interface, version, id);
+  if (resource == NULL) return;
+
+  if (global->interface == &zgn_seat_interface)
+    zgn_seat_send_capabilities(
+        resource, ZGN_SEAT_CAPABILITY_RAY | ZGN_SEAT_CAPABILITY_KEYBOARD);
+}
+
+/**
+ * return the cuboid window input is synthesized for, NULL if none
+ */
+static struct mock_object*
+mock_input_target(struct zsurf_mock* mock)
+{
+  struct mock_object* cuboid_window;
+
+  wl_list_for_each(cuboid_window, &mock->cuboid_window_list, link)
+  {
+    if (cuboid_window->virtual_object) return cuboid_window;
+  }
+
+  return NULL;
+}
+
+static int
+mock_read_timer(int fd)
+{
+  uint64_t expirations;
+  return read(fd, &expirations, sizeof expirations) == sizeof expirations ? 0
+                                                                          : -1;
+}
+
+static int
+mock_frame_tick(int fd, uint32_t mask, void* data)
+{
+  UNUSED(mask);
+  struct zsurf_mock* mock = data;
+  struct mock_object* virtual_object;
+  uint32_t time = mock_get_time_ms();
+  uint64_t count = 0;
+
+  if (mock_read_timer(fd) != 0) return 0;
+
+  wl_list_for_each(virtual_object, &mock->virtual_object_list, link)
+      count += mock_send_frame_done(virtual_object, time);
+
+  if (count == 0) return 0;
+
+  pthread_mutex_lock(&mock->stats_lock);
+  mock->stats.frames++;
+  mock->stats.frame_callbacks += count;
+  pthread_mutex_unlock(&mock->stats_lock);
+
+  return 0;
+}
+
+static int
+mock_ray_tick(int fd, uint32_t mask, void* data)
+{
+  UNUSED(mask);
+  struct zsurf_mock* mock = data;
+  struct mock_object *target, *ray;
+  struct wl_client* client;
+  float origin[3], direction[3] = {0, 0, -1};
+  struct wl_array origin_array = {.size = sizeof origin, .data = origin};
+  struct wl_array direction_array = {
+      .size = sizeof direction, .data = direction};
+  uint32_t time = mock_get_time_ms();
+
+  if (mock_read_timer(fd) != 0) return 0;
+
+  target = mock_input_target(mock);
+  if (target == NULL) return 0;
+  client = wl_resource_get_client(target->resource);
+
+  wl_list_for_each(ray, &mock->ray_list, link)
+  {
+    if (wl_resource_get_client(ray->resource) != client) continue;
+
+    // sweep a Lissajous curve inside the window
+    float phase = (float)ray->step * 0.05f;
+    origin[0] = target->half_size[0] * 0.6f * sinf(phase);
+    origin[1] = target->half_size[1] * 0.6f * cosf(phase * 0.7f);
+    origin[2] = 0.5f;
+
+    if (ray->entered != target->virtual_object) {
+      if (ray->entered)
+        zgn_ray_send_leave(ray->resource,
+            wl_display_next_serial(mock->display), ray->entered->resource);
+      zgn_ray_send_enter(ray->resource, wl_display_next_serial(mock->display),
+          target->virtual_object->resource, &origin_array, &direction_array);
+      ray->entered = target->virtual_object;
+    }
+
+    zgn_ray_send_motion(ray->resource, time, &origin_array, &direction_array);
+
+    if (ray->step % MOCK_BUTTON_PERIOD == 0 ||
+        ray->step % MOCK_BUTTON_PERIOD == 1)
+      zgn_ray_send_button(ray->resource,
+          wl_display_next_serial(mock->display), time, 0x110,  // BTN_LEFT
+          ray->step % MOCK_BUTTON_PERIOD == 0);
+
+    ray->step++;
+  }
+
+  return 0;
+}
+
+static int
+mock_key_tick(int fd, uint32_t mask, void* data)
+{
+  UNUSED(mask);
+  struct zsurf_mock* mock = data;
+  struct mock_object *target, *keyboard;
+  struct wl_client* client;
+  struct wl_array keys = {0};
+
+  if (mock_read_timer(fd) != 0) return 0;
+
+  target = mock_input_target(mock);
+  if (target == NULL) return 0;
+  client = wl_resource_get_client(target->resource);
+
+  wl_list_for_each(keyboard, &mock->keyboard_list, link)
+  {
+    if (wl_resource_get_client(keyboard->resource) != client) continue;
+
+    if (keyboard->entered != target->virtual_object) {
+      if (keyboard->entered)
+        zgn_keyboard_send_leave(keyboard->resource,
+            wl_display_next_serial(mock->display),
+            keyboard->entered->resource);
+      zgn_keyboard_send_enter(keyboard->resource,
+          wl_display_next_serial(mock->display),
+          target->virtual_object->resource, &keys);
+      keyboard->entered = target->virtual_object;
+      keyboard->step = 0;
+    }
+
+    zgn_keyboard_send_key(keyboard->resource,
+        wl_display_next_serial(mock->display), mock_get_time_ms(),
+        MOCK_KEY_CODE, keyboard->step % 2 == 0);
+    keyboard->step++;
+  }
+
+  return 0;
+}
+
+static int
+mock_add_clock(struct zsurf_mock* mock, uint32_t rate,
+    wl_event_loop_fd_func_t func, struct wl_event_source** source)
+{
+  struct itimerspec its = {0};
+  int fd;
+
+  if (rate == 0) return -1;
+
+  fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (fd < 0) return -1;
+
+  its.it_interval.tv_sec = 0;
+  its.it_interval.tv_nsec = 1000000000 / rate;
+  if (rate == 1) {
+    its.it_interval.tv_sec = 1;
+    its.it_interval.tv_nsec = 0;
+  }
+  its.it_value = its.it_interval;
+
+  if (timerfd_settime(fd, 0, &its, NULL) != 0) goto err;
+
+  *source = wl_event_loop_add_fd(mock->loop, fd, WL_EVENT_READABLE, func, mock);
+  if (*source == NULL) goto err;
+
+  return fd;
+
+err:
+  close(fd);
+  return -1;
+}
+
+static void
+mock_remove_clock(int fd, struct wl_event_source* source)
+{
+  if (fd < 0) return;
+  wl_event_source_remove(source);
+  close(fd);
+}
+
+struct zsurf_mock*
+zsurf_mock_create(const struct zsurf_mock_options* options)
+{
+  struct zsurf_mock* mock;
+  const struct wl_interface* interfaces[] = {
+      &zgn_compositor_interface,
+      &zgn_seat_interface,
+      &zgn_shell_interface,
+      &zgn_opengl_interface,
+  };
+
+  mock = calloc(1, sizeof *mock);
+  if (mock == NULL) goto err;
+
+  mock->options = *options;
+
+  mock->display = wl_display_create();
+  if (mock->display == NULL) goto err_display;
+
+  mock->loop = wl_display_get_event_loop(mock->display);
+
+  if (options->socket) {
+    if (wl_display_add_socket(mock->display, options->socket) != 0)
+      goto err_socket;
+    mock->socket = options->socket;
+  } else {
+    mock->socket = wl_display_add_socket_auto(mock->display);
+    if (mock->socket == NULL) goto err_socket;
+  }
+
+  if (wl_display_init_shm(mock->display) != 0) goto err_socket;
+  // the compact texture formats zsurface uses when they are advertised
+  if (wl_display_add_shm_format(mock->display, WL_SHM_FORMAT_RGB565) == NULL ||
+      wl_display_add_shm_format(mock->display, WL_SHM_FORMAT_R8) == NULL)
+    goto err_socket;
+
+  for (int i = 0; i < 4; i++) {
+    mock->globals[i].mock = mock;
+    mock->globals[i].interface = interfaces[i];
+    if (wl_global_create(mock->display, interfaces[i], interfaces[i]->version,
+            &mock->globals[i], mock_bind) == NULL)
+      goto err_socket;
+  }
+
+  wl_list_init(&mock->virtual_object_list);
+  wl_list_init(&mock->cuboid_window_list);
+  wl_list_init(&mock->ray_list);
+  wl_list_init(&mock->keyboard_list);
+
+  pthread_mutex_init(&mock->stats_lock, NULL);
+
+  mock->logger = wl_display_add_protocol_logger(
+      mock->display, mock_protocol_logger, mock);
+
+  mock->frame_fd = mock_add_clock(
+      mock, options->frame_rate, mock_frame_tick, &mock->frame_source);
+  mock->ray_fd =
+      mock_add_clock(mock, options->ray_rate, mock_ray_tick, &mock->ray_source);
+  mock->key_fd =
+      mock_add_clock(mock, options->key_rate, mock_key_tick, &mock->key_source);
+
+  return mock;
+
+err_socket:
+  wl_display_destroy(mock->display);
+
+err_display:
+  free(mock);
+
+err:
+  return NULL;
+}
+
+void
+zsurf_mock_destroy(struct zsurf_mock* mock)
+{
+  if (mock->thread_running) zsurf_mock_stop(mock);
+
+  wl_display_destroy_clients(mock->display);
+  mock_remove_clock(mock->frame_fd, mock->frame_source);
+  mock_remove_clock(mock->ray_fd, mock->ray_source);
+  mock_remove_clock(mock->key_fd, mock->key_source);
+  if (mock->logger) wl_protocol_logger_destroy(mock->logger);
+  wl_display_destroy(mock->display);
+  pthread_mutex_destroy(&mock->stats_lock);
+  free(mock);
+}
+
+const char*
+zsurf_mock_get_socket(struct zsurf_mock* mock)
+{
+  return mock->socket;
+}
+
+void
+zsurf_mock_run(struct zsurf_mock* mock)
+{
+  wl_display_run(mock->display);
+}
+
+static void*
+mock_thread_main(void* data)
+{
+  zsurf_mock_run(data);
+  return NULL;
+}
+
+int
+zsurf_mock_start(struct zsurf_mock* mock)
+{
+  if (pthread_create(&mock->thread, NULL, mock_thread_main, mock) != 0)
+    return -1;
+
+  mock->thread_running = true;
+
+  return 0;
+}
+
+void
+zsurf_mock_stop(struct zsurf_mock* mock)
+{
+  wl_display_terminate(mock->display);
+
+  if (mock->thread_running) {
+    pthread_join(mock->thread, NULL);
+    mock->thread_running = false;
+  }
+}
+
+void
+zsurf_mock_get_stats(struct zsurf_mock* mock, struct zsurf_mock_stats* stats)
+{
+  pthread_mutex_lock(&mock->stats_lock);
+  *stats = mock->stats;
+  pthread_mutex_unlock(&mock->stats_lock);
+}
+
+int
+zsurf_mock_get_message_stats(
+    struct zsurf_mock* mock, struct zsurf_mock_message_stats* out, int max)
+{
+  int count = 0;
+
+  pthread_mutex_lock(&mock->stats_lock);
+  for (int i = 0; i < MOCK_MAX_MESSAGES && count < max; i++) {
+    if (mock->messages[i].message && mock->messages[i].stats.count > 0)
+      out[count++] = mock->messages[i].stats;
+  }
+  pthread_mutex_unlock(&mock->stats_lock);
+
+  return count;
+}
+
+void
+zsurf_mock_reset_stats(struct zsurf_mock* mock)
+{
+  pthread_mutex_lock(&mock->stats_lock);
+  memset(&mock->stats, 0, sizeof mock->stats);
+  for (int i = 0; i < MOCK_MAX_MESSAGES; i++) {
+    struct zsurf_mock_message_stats* stats = &mock->messages[i].stats;
+    stats->count = 0;
+    stats->handle_time_ns = 0;
+    stats->first_ns = 0;
+    stats->last_ns = 0;
+  }
+  pthread_mutex_unlock(&mock->stats_lock);
+}
+
+void
+zsurf_mock_write_stats_json(struct zsurf_mock* mock, FILE* file)
+{
+  struct zsurf_mock_stats stats;
+  struct zsurf_mock_message_stats messages[MOCK_MAX_MESSAGES];
+  int count;
+
+  zsurf_mock_get_stats(mock, &stats);
+  count = zsurf_mock_get_message_stats(mock, messages, MOCK_MAX_MESSAGES);
+
+  fprintf(file,
+      "{\"requests\": %" PRIu64 ", \"events\": %" PRIu64
+      ", \"commits\": %" PRIu64 ", \"frames\": %" PRIu64
+      ", \"frame_callbacks\": %" PRIu64 ", \"request_time_ns\": %" PRIu64
+      ", \"messages\": [",
+      stats.requests, stats.events, stats.commits, stats.frames,
+      stats.frame_callbacks, stats.request_time_ns);
+
+  for (int i = 0; i < count; i++) {
+    fprintf(file,
+        "%s\n  {\"interface\": \"%s\", \"message\": \"%s\", "
+        "\"direction\": \"%s\", \"count\": %" PRIu64
+        ", \"handle_time_ns\": %" PRIu64 ", \"first_ns\": %" PRIu64
+        ", \"last_ns\": %" PRIu64 "}",
+        i == 0 ? "" : ",", messages[i].interface, messages[i].message,
+        messages[i].direction == ZSURF_MOCK_DIRECTION_REQUEST ? "request"
+                                                              : "event",
+        messages[i].count, messages[i].handle_time_ns, messages[i].first_ns,
+        messages[i].last_ns);
+  }
+
+  fprintf(file, "]}\n");
+}
@@ -0,0 +1,86 @@
+#ifndef ZSURFACE_MOCK_H
+#define ZSURFACE_MOCK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Headless zigen compositor. It advertises zgn_compositor, zgn_seat,
+ * zgn_shell, wl_shm and zgn_opengl, counts every request it receives and
+ * answers frame callbacks on its own clock without touching a GPU.
+ */
+struct zsurf_mock;
+
+struct zsurf_mock_options {
+  const char* socket;   // NULL picks a free wayland-N name
+  uint32_t frame_rate;  // frame clock in Hz, 0 answers callbacks on commit
+  uint32_t ray_rate;    // synthesized ray motions per second, 0 disables
+  uint32_t key_rate;    // synthesized key events per second, 0 disables
+};
+
+enum zsurf_mock_direction {
+  ZSURF_MOCK_DIRECTION_REQUEST = 0,
+  ZSURF_MOCK_DIRECTION_EVENT = 1,
+};
+
+struct zsurf_mock_message_stats {
+  const char* interface;
+  const char* message;
+  enum zsurf_mock_direction direction;
+  uint64_t count;
+  uint64_t handle_time_ns;  // requests of zigen objects only
+  uint64_t first_ns;        // CLOCK_MONOTONIC
+  uint64_t last_ns;
+};
+
+struct zsurf_mock_stats {
+  uint64_t requests;
+  uint64_t events;
+  uint64_t commits;
+  uint64_t frames;           // frame clock ticks that answered a callback
+  uint64_t frame_callbacks;  // done events sent
+  uint64_t request_time_ns;  // spent handling requests of zigen objects
+};
+
+/**
+ * return NULL when failed to create the display or its socket
+ */
+struct zsurf_mock* zsurf_mock_create(const struct zsurf_mock_options* options);
+
+void zsurf_mock_destroy(struct zsurf_mock* mock);
+
+const char* zsurf_mock_get_socket(struct zsurf_mock* mock);
+
+/**
+ * run the event loop on the calling thread until zsurf_mock_stop
+ */
+void zsurf_mock_run(struct zsurf_mock* mock);
+
+/**
+ * run the event loop on a new thread.
+ * return -1 when failed to create the thread
+ */
+int zsurf_mock_start(struct zsurf_mock* mock);
+
+/**
+ * can be called from any thread, joins the thread of zsurf_mock_start
+ */
+void zsurf_mock_stop(struct zsurf_mock* mock);
+
+/**
+ * the stats functions can be called from any thread
+ */
+void zsurf_mock_get_stats(
+    struct zsurf_mock* mock, struct zsurf_mock_stats* stats);
+
+/**
+ * copy at most max entries. return the number of copied entries
+ */
+int zsurf_mock_get_message_stats(
+    struct zsurf_mock* mock, struct zsurf_mock_message_stats* out, int max);
+
+void zsurf_mock_reset_stats(struct zsurf_mock* mock);
+
+void zsurf_mock_write_stats_json(struct zsurf_mock* mock, FILE* file);
+
+#endif  //  ZSURFACE_MOCK_H
@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+
+#include "alloc-count.h"
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <zsurface.h>
+
+// frames looked at: the hook, the allocator entry, the caller and its caller
+#define ALLOC_COUNT_DEPTH 4
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+static _Thread_local bool in_hook;
+static void* library_base;  // NULL while not counting
+static uint64_t count;
+
+static void
+alloc_count_record(void)
+{
+  void* frames[ALLOC_COUNT_DEPTH];
+  Dl_info info;
+  int depth;
+
+  if (__atomic_load_n(&library_base, __ATOMIC_RELAXED) == NULL || in_hook)
+    return;
+
+  in_hook = true;
+  depth = backtrace(frames, ALLOC_COUNT_DEPTH);
+  for (int i = 0; i < depth; i++) {
+    if (dladdr(frames[i], &info) && info.dli_fbase == library_base) {
+      __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+      break;
+    }
+  }
+  in_hook = false;
+}
+
+void*
+malloc(size_t size)
+{
+  alloc_count_record();
+  return __libc_malloc(size);
+}
+
+void*
+calloc(size_t nmemb, size_t size)
+{
+  alloc_count_record();
+  return __libc_calloc(nmemb, size);
+}
+
+void*
+realloc(void* ptr, size_t size)
+{
+  alloc_count_record();
+  return __libc_realloc(ptr, size);
+}
+
+void
+alloc_count_start(void)
+{
+  void (*symbol)(struct zsurf_view*) = zsurf_view_commit;
+  void *address, *frames[1];
+  Dl_info info;
+
+  // the first backtrace loads the unwinder, which allocates
+  backtrace(frames, 1);
+
+  memcpy(&address, &symbol, sizeof address);
+  if (dladdr(address, &info) == 0) return;
+
+  __atomic_store_n(&count, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&library_base, info.dli_fbase, __ATOMIC_RELAXED);
+}
+
+uint64_t
+alloc_count_stop(void)
+{
+  __atomic_store_n(&library_base, NULL, __ATOMIC_RELAXED);
+  return __atomic_load_n(&count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,18 @@
+#ifndef ZSURFACE_TESTS_ALLOC_COUNT_H
+#define ZSURFACE_TESTS_ALLOC_COUNT_H
+
+#include <stdint.h>
+
+/**
+ * Start counting malloc, calloc and realloc calls made by libzsurface, either
+ * directly or through a helper such as wl_array_add. Allocations libwayland
+ * makes for its own proxies and closures are not counted.
+ */
+void alloc_count_start(void);
+
+/**
+ * return the number of allocations since alloc_count_start
+ */
+uint64_t alloc_count_stop(void);
+
+#endif  //  ZSURFACE_TESTS_ALLOC_COUNT_H
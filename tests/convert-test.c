@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define MAX_WIDTH 67
+#define PAD 5  // bytes added to a padded stride
+
+static const struct {
+  enum zsurf_pixel_format format;
+  const char* name;
+} pixel_formats[] = {
+    {ZSURF_PIXEL_FORMAT_BGRA8888, "bgra8888"},
+    {ZSURF_PIXEL_FORMAT_RGBA8888, "rgba8888"},
+    {ZSURF_PIXEL_FORMAT_RGB888, "rgb888"},
+    {ZSURF_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED, "rgba8888_premultiplied"},
+    {ZSURF_PIXEL_FORMAT_BGRX8888, "bgrx8888"},
+    {ZSURF_PIXEL_FORMAT_RGB565, "rgb565"},
+    {ZSURF_PIXEL_FORMAT_R8, "r8"},
+};
+
+#define PIXEL_FORMAT_COUNT (sizeof pixel_formats / sizeof *pixel_formats)
+
+static uint8_t
+unpremultiply(uint8_t c, uint8_t a)
+{
+  if (c > a) c = a;
+  return a ? (c * 255 + a / 2) / a : 0;
+}
+
+/**
+ * Every (color, alpha) pair through the premultiplied kernel of every level,
+ * each channel taking all 256 values.
+ */
+static int
+check_unpremultiply(void)
+{
+  enum { count = 256 * 256 };
+  uint8_t* src = malloc(count * 4);
+  struct zsurf_color_bgra* dst = malloc(count * sizeof *dst);
+  zsurf_convert_row_func_t row;
+  int failures = 0;
+
+  if (src == NULL || dst == NULL) {
+    free(src);
+    free(dst);
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint8_t c = i & 0xff;
+    src[i * 4 + 0] = c;
+    src[i * 4 + 1] = c + 85;
+    src[i * 4 + 2] = c + 170;
+    src[i * 4 + 3] = i >> 8;
+  }
+
+  for (int level = ZSURF_CONVERT_LEVEL_SCALAR;
+       level <= (int)zsurf_convert_get_level(); level++) {
+    row = zsurf_convert_get_row_func(
+        ZSURF_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED, level);
+    memset(dst, 0, count * sizeof *dst);
+    row(dst, src, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+      const uint8_t* s = src + i * 4;
+      struct zsurf_color_bgra expected = {unpremultiply(s[2], s[3]),
+          unpremultiply(s[1], s[3]), unpremultiply(s[0], s[3]), s[3]};
+
+      if (memcmp(&dst[i], &expected, sizeof expected) != 0) {
+        fprintf(stderr,
+            "unpremultiply at level %d: rgba %u %u %u %u gave bgra %u %u %u "
+            "%u\n",
+            level, s[0], s[1], s[2], s[3], dst[i].b, dst[i].g, dst[i].r,
+            dst[i].a);
+        failures++;
+        break;
+      }
+    }
+  }
+
+  free(src);
+  free(dst);
+  return failures;
+}
+
+/**
+ * every kernel the cpu supports gives the bytes of the scalar one, for every
+ * row length around the vector widths
+ */
+static int
+check_row_funcs(void)
+{
+  uint8_t src[MAX_WIDTH * 4];
+  struct zsurf_color_bgra expected[MAX_WIDTH], actual[MAX_WIDTH];
+  zsurf_convert_row_func_t scalar, row;
+  int failures = 0;
+
+  srand(1);
+  for (size_t f = 0; f < PIXEL_FORMAT_COUNT; f++) {
+    enum zsurf_pixel_format format = pixel_formats[f].format;
+    scalar = zsurf_convert_get_row_func(format, ZSURF_CONVERT_LEVEL_SCALAR);
+
+    for (int level = ZSURF_CONVERT_LEVEL_SCALAR + 1;
+         level <= (int)zsurf_convert_get_level(); level++) {
+      row = zsurf_convert_get_row_func(format, level);
+
+      for (uint32_t width = 0; width <= MAX_WIDTH; width++) {
+        for (size_t i = 0; i < sizeof src; i++) src[i] = rand();
+        memset(expected, 0, sizeof expected);
+        memset(actual, 0, sizeof actual);
+
+        scalar(expected, src, width);
+        row(actual, src, width);
+
+        if (memcmp(expected, actual, sizeof expected) != 0) {
+          fprintf(stderr, "%s at level %d differs for width %u\n",
+              pixel_formats[f].name, level, width);
+          failures++;
+        }
+      }
+    }
+  }
+
+  return failures;
+}
+
+/**
+ * Convert an image with the given strides into dst_format and compare every
+ * row with the scalar kernel, or with the source bytes when dst_format holds
+ * the format as is. Bytes past the last row must stay untouched.
+ */
+static int
+check_image(size_t f, enum wl_shm_format dst_format, uint32_t width,
+    uint32_t height, uint32_t src_pad, uint32_t dst_pad)
+{
+  enum zsurf_pixel_format format = pixel_formats[f].format;
+  bool as_is = dst_format != WL_SHM_FORMAT_ARGB8888 ||
+               format == ZSURF_PIXEL_FORMAT_BGRA8888;
+  uint32_t src_row = width * zsurf_convert_bytes_per_pixel(format);
+  uint32_t dst_row = width * zsurf_convert_shm_bytes_per_pixel(dst_format);
+  uint32_t src_stride = src_row + src_pad, dst_stride = dst_row + dst_pad;
+  size_t dst_size = (size_t)dst_stride * height + 16;
+  uint8_t *src, *dst, expected[MAX_WIDTH * 4];
+  zsurf_convert_row_func_t scalar;
+  int failures = 0;
+
+  src = malloc((size_t)src_stride * height);
+  dst = malloc(dst_size);
+  if (src == NULL || dst == NULL) {
+    free(src);
+    free(dst);
+    return 1;
+  }
+
+  for (size_t i = 0; i < (size_t)src_stride * height; i++) src[i] = rand();
+  memset(dst, 0xa5, dst_size);
+
+  zsurf_convert(dst, dst_stride, dst_format, src, format, src_stride, width,
+      height);
+
+  scalar = zsurf_convert_get_row_func(format, ZSURF_CONVERT_LEVEL_SCALAR);
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* s = src + (size_t)src_stride * y;
+
+    if (as_is)
+      memcpy(expected, s, src_row);
+    else
+      scalar(expected, s, width);
+
+    if (memcmp(dst + (size_t)dst_stride * y, expected, dst_row) != 0) {
+      failures++;
+      break;
+    }
+  }
+
+  for (size_t i = (size_t)dst_stride * (height - 1) + dst_row; i < dst_size;
+       i++) {
+    if (dst[i] != 0xa5) {
+      failures++;
+      break;
+    }
+  }
+
+  if (failures)
+    fprintf(stderr,
+        "zsurf_convert of %s into shm format 0x%x differs for %ux%u, src "
+        "pad %u, dst pad %u\n",
+        pixel_formats[f].name, dst_format, width, height, src_pad, dst_pad);
+
+  free(src);
+  free(dst);
+  return failures;
+}
+
+/**
+ * zsurf_convert on packed rows, which are one long row, on padded strides,
+ * and into each shm format holding a format as is
+ */
+static int
+check_convert(void)
+{
+  static const uint32_t sizes[][2] = {{1, 1}, {37, 5}, {MAX_WIDTH, 3}};
+  static const uint32_t pads[][2] = {{0, 0}, {PAD, 0}, {0, PAD}, {PAD, PAD}};
+  enum wl_shm_format dst_formats[2];
+  int failures = 0;
+
+  srand(2);
+  for (size_t f = 0; f < PIXEL_FORMAT_COUNT; f++) {
+    dst_formats[0] = WL_SHM_FORMAT_ARGB8888;
+    dst_formats[1] =
+        zsurf_convert_texture_format(UINT32_MAX, pixel_formats[f].format);
+
+    for (size_t d = 0; d < 2; d++) {
+      for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+        for (size_t p = 0; p < sizeof pads / sizeof *pads; p++) {
+          failures += check_image(f, dst_formats[d], sizes[s][0],
+              sizes[s][1], pads[p][0], pads[p][1]);
+        }
+      }
+    }
+  }
+
+  return failures;
+}
+
+int
+main(void)
+{
+  int failures = 0;
+
+  failures += check_unpremultiply();
+  failures += check_row_funcs();
+  failures += check_convert();
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define TARGET_NS 8000000
+
+/**
+ * feed frames for the given load to the controller, render time growing with
+ * the pixel count and 10% noise. return the last smoothed render time
+ */
+static uint64_t
+run(struct zsurf_resolution* resolution, uint64_t full_ns)
+{
+  uint64_t ns = 0;
+
+  for (int i = 0; i < 1000; i++) {
+    float noise = 0.9f + (rand() % 201) / 1000.0f;
+    ns = full_ns * resolution->scale * resolution->scale * noise;
+    zsurf_resolution_sample(resolution, ns);
+  }
+
+  return resolution->average_ns;
+}
+
+/**
+ * A load twice the target must settle inside the target's band with a few
+ * changes, and the scale must come back to 1 once the load goes away.
+ */
+int
+main(void)
+{
+  struct zsurf_resolution resolution;
+  uint64_t heavy;
+  uint32_t heavy_changes;
+  int failures = 0;
+
+  srand(1);
+  zsurf_resolution_init(&resolution);
+  resolution.target_ns = TARGET_NS;
+  resolution.min_scale = 0.25f;
+
+  heavy = run(&resolution, TARGET_NS * 2);
+  heavy_changes = resolution.changes;
+
+  if (heavy < TARGET_NS * 0.7 || heavy > TARGET_NS * 1.1) {
+    fprintf(stderr, "heavy load settled at %" PRIu64 " ns, scale %.3f\n",
+        heavy, resolution.scale);
+    failures++;
+  }
+
+  if (heavy_changes > 4) {
+    fprintf(stderr, "heavy load changed the scale %u times\n", heavy_changes);
+    failures++;
+  }
+
+  run(&resolution, TARGET_NS / 4);
+
+  if (resolution.scale != 1.0f) {
+    fprintf(stderr, "light load left the scale at %.3f\n", resolution.scale);
+    failures++;
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <zsurface.h>
+
+#include "bench-common.h"
+#include "mock.h"
+
+struct startup {
+  bool ready;
+  bool success;
+};
+
+static void
+startup_ready(void* data, bool success)
+{
+  struct startup* startup = data;
+
+  startup->ready = true;
+  startup->success = success;
+}
+
+/**
+ * the toplevel is queued behind the startup and must have its view once
+ * ready is reported
+ */
+static int
+check_queued(
+    const char* socket, const struct zsurf_display_interface* interface)
+{
+  struct startup startup = {0};
+  struct zsurf_display* display;
+  struct zsurf_toplevel* toplevel;
+  int failures = 0;
+
+  display = zsurf_display_create_async(socket, interface, &startup);
+  if (display == NULL) return 1;
+
+  toplevel = zsurf_toplevel_create(display, NULL);
+  if (toplevel == NULL) {
+    zsurf_display_destroy(display);
+    return 1;
+  }
+
+  if (zsurf_toplevel_get_view(toplevel) != NULL) {
+    fprintf(stderr, "toplevel has a view before ready\n");
+    failures++;
+  }
+
+  while (!startup.ready)
+    if (zsurf_display_dispatch(display) == -1) break;
+
+  if (!startup.success) {
+    fprintf(stderr, "startup did not succeed\n");
+    failures++;
+  } else if (zsurf_toplevel_get_view(toplevel) == NULL) {
+    fprintf(stderr, "queued toplevel has no view after ready\n");
+    failures++;
+  }
+
+  zsurf_toplevel_destroy(toplevel);
+  zsurf_display_destroy(display);
+
+  return failures;
+}
+
+/**
+ * a toplevel still queued outlives its display
+ */
+static int
+check_destroyed_while_queued(
+    const char* socket, const struct zsurf_display_interface* interface)
+{
+  struct startup startup = {0};
+  struct zsurf_display* display;
+  struct zsurf_toplevel* toplevel;
+
+  display = zsurf_display_create_async(socket, interface, &startup);
+  if (display == NULL) return 1;
+
+  toplevel = zsurf_toplevel_create(display, NULL);
+  zsurf_display_destroy(display);
+  if (toplevel == NULL) return 1;
+
+  zsurf_toplevel_destroy(toplevel);
+
+  return 0;
+}
+
+int
+main(void)
+{
+  struct zsurf_mock_options options = {.frame_rate = 0};
+  struct zsurf_display_interface interface = bench_display_interface;
+  struct zsurf_mock* mock;
+  const char* socket;
+  int failures = 0;
+
+  interface.ready = startup_ready;
+
+  mock = zsurf_mock_create(&options);
+  if (mock == NULL) {
+    fprintf(stderr, "failed to create the mock compositor\n");
+    return EXIT_FAILURE;
+  }
+  socket = zsurf_mock_get_socket(mock);
+
+  if (zsurf_mock_start(mock) != 0) {
+    zsurf_mock_destroy(mock);
+    return EXIT_FAILURE;
+  }
+
+  failures += check_queued(socket, &interface);
+  failures += check_destroyed_while_queued(socket, &interface);
+
+  zsurf_mock_stop(mock);
+  zsurf_mock_destroy(mock);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <zsurface.h>
+
+#include "alloc-count.h"
+#include "bench-common.h"
+#include "internal.h"
+#include "mock.h"
+
+#define WARMUP_FRAMES 8
+#define STEADY_FRAMES 256
+#define SIZE 64
+
+static void
+frame_done(void* data, uint32_t callback_time)
+{
+  bool* done = data;
+  UNUSED(callback_time);
+  *done = true;
+}
+
+/**
+ * move the child, touch one pixel and wait for the frame
+ */
+static int
+steady_frame(struct zsurf_display* display, struct zsurf_toplevel* toplevel,
+    struct zsurf_view* child, struct zsurf_color_bgra* pixels, uint32_t frame)
+{
+  struct zsurf_view* view = zsurf_toplevel_get_view(toplevel);
+  bool done = false;
+
+  zsurf_view_update_surface_pos(child, frame % SIZE, 0);
+  zsurf_view_update_space_geom(child);
+  pixels[frame % (SIZE * SIZE)].g++;
+  zsurf_view_set_texture(view, pixels, SIZE, SIZE);
+
+  zsurf_view_add_frame_callback(view, frame_done, &done);
+  zsurf_view_commit(view);
+  while (!done)
+    if (zsurf_display_dispatch(display) == -1) return -1;
+
+  return 0;
+}
+
+/**
+ * A frame that changes no size must not allocate inside the library once its
+ * pools are warm.
+ */
+static int
+run(struct zsurf_display* display)
+{
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_color_bgra* pixels;
+  struct zsurf_view* child;
+  uint64_t count;
+  int ret = EXIT_FAILURE;
+
+  pixels = calloc(SIZE * SIZE, sizeof *pixels);
+  if (pixels == NULL) return EXIT_FAILURE;
+
+  toplevel = zsurf_toplevel_create(display, NULL);
+  if (toplevel == NULL) goto out;
+
+  child = zsurf_view_create(
+      display, toplevel, zsurf_toplevel_get_view(toplevel), NULL);
+  if (child == NULL) goto out_toplevel;
+  zsurf_view_set_texture(child, pixels, 16, 16);
+
+  // receive the configure of the cuboid window
+  bench_sync(display);
+  bench_sync(display);
+
+  for (uint32_t frame = 0; frame < WARMUP_FRAMES; frame++)
+    if (steady_frame(display, toplevel, child, pixels, frame) != 0)
+      goto out_child;
+
+  alloc_count_start();
+  for (uint32_t frame = 0; frame < STEADY_FRAMES; frame++) {
+    if (steady_frame(display, toplevel, child, pixels, frame) != 0) {
+      alloc_count_stop();
+      goto out_child;
+    }
+  }
+  count = alloc_count_stop();
+
+  if (count > 0) {
+    fprintf(stderr, "%" PRIu64 " allocations in %u steady frames\n", count,
+        STEADY_FRAMES);
+    goto out_child;
+  }
+
+  ret = EXIT_SUCCESS;
+
+out_child:
+  zsurf_view_destroy(child);
+
+out_toplevel:
+  zsurf_toplevel_destroy(toplevel);
+
+out:
+  free(pixels);
+  return ret;
+}
+
+int
+main(void)
+{
+  struct zsurf_mock_options options = {.frame_rate = 0};
+  struct zsurf_display* display;
+  struct zsurf_mock* mock;
+  bool ready = false;
+  int ret = EXIT_FAILURE;
+
+  mock = zsurf_mock_create(&options);
+  if (mock == NULL) {
+    fprintf(stderr, "failed to create the mock compositor\n");
+    goto err;
+  }
+
+  if (zsurf_mock_start(mock) != 0) goto err_start;
+
+  display = zsurf_display_create(
+      zsurf_mock_get_socket(mock), &bench_display_interface, &ready);
+  if (display == NULL) {
+    fprintf(stderr, "failed to connect to the mock compositor\n");
+    goto err_display;
+  }
+
+  ret = run(display);
+
+  zsurf_display_destroy(display);
+
+err_display:
+  zsurf_mock_stop(mock);
+
+err_start:
+  zsurf_mock_destroy(mock);
+
+err:
+  return ret;
+}
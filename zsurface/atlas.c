@@ -0,0 +1,532 @@
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define ZSURF_ATLAS_PAGE_STRIDE (ZSURF_ATLAS_PAGE_SIZE * 4)
+#define ZSURF_ATLAS_PAGE_BYTES \
+  ((size_t)ZSURF_ATLAS_PAGE_STRIDE * ZSURF_ATLAS_PAGE_SIZE)
+
+static inline struct zsurf_color_bgra*
+zsurf_atlas_entry_row(struct zsurf_atlas_entry* entry, uint32_t row)
+{
+  uint8_t* data = entry->page->data;
+  return (struct zsurf_color_bgra*)(data + (size_t)(entry->y + row) *
+                                               ZSURF_ATLAS_PAGE_STRIDE) +
+         entry->x;
+}
+
+static void
+zsurf_atlas_page_reset(struct zsurf_atlas_page* page)
+{
+  page->skyline[0] = (struct zsurf_atlas_segment){0, 0, ZSURF_ATLAS_PAGE_SIZE};
+  page->segment_count = 1;
+}
+
+struct zsurf_atlas_page*
+zsurf_atlas_page_create(struct zsurf_display* surface_display)
+{
+  struct zsurf_atlas_page* page;
+
+  page = zalloc(sizeof *page);
+  if (page == NULL) goto err;
+
+  page->fd = zsurf_create_shared_fd(ZSURF_ATLAS_PAGE_BYTES);
+  if (page->fd < 0) goto err_fd;
+
+  page->data = mmap(NULL, ZSURF_ATLAS_PAGE_BYTES, PROT_READ | PROT_WRITE,
+      MAP_SHARED, page->fd, 0);
+  if (page->data == MAP_FAILED) goto err_mmap;
+
+  page->pool = wl_shm_create_pool(
+      surface_display->shm, page->fd, ZSURF_ATLAS_PAGE_BYTES);
+  page->buffer = wl_shm_pool_create_buffer(page->pool, 0,
+      ZSURF_ATLAS_PAGE_SIZE, ZSURF_ATLAS_PAGE_SIZE, ZSURF_ATLAS_PAGE_STRIDE,
+      WL_SHM_FORMAT_ARGB8888);
+  page->texture = zgn_opengl_create_texture(surface_display->opengl);
+
+  page->surface_display = surface_display;
+  wl_list_init(&page->link);
+  wl_list_init(&page->entry_list);
+  wl_list_init(&page->hold_list);
+  zsurf_atlas_page_reset(page);
+
+  // the whole page is one texture whatever it holds
+  surface_display->memory.stats.reserved_bytes += ZSURF_ATLAS_PAGE_BYTES;
+  surface_display->memory.stats.used_bytes += ZSURF_ATLAS_PAGE_BYTES;
+  zsurf_display_check_memory_budget(surface_display);
+
+  return page;
+
+err_mmap:
+  close(page->fd);
+
+err_fd:
+  free(page);
+
+err:
+  return NULL;
+}
+
+void
+zsurf_atlas_page_destroy(struct zsurf_atlas_page* page)
+{
+  struct zsurf_display* surface_display = page->surface_display;
+
+  surface_display->memory.stats.reserved_bytes -= ZSURF_ATLAS_PAGE_BYTES;
+  surface_display->memory.stats.used_bytes -= ZSURF_ATLAS_PAGE_BYTES;
+
+  zgn_opengl_texture_destroy(page->texture);
+  wl_buffer_destroy(page->buffer);
+  wl_shm_pool_destroy(page->pool);
+  munmap(page->data, ZSURF_ATLAS_PAGE_BYTES);
+  close(page->fd);
+  free(page);
+}
+
+/**
+ * Bottom left skyline fit: the segment whose top, over the width of the
+ * rectangle, is lowest. return the segment index, -1 if nothing fits
+ */
+static int
+zsurf_atlas_page_find(struct zsurf_atlas_page* page, uint32_t width,
+    uint32_t height, uint32_t* x, uint32_t* y)
+{
+  uint32_t best_top = UINT32_MAX, best_width = UINT32_MAX;
+  int best = -1;
+
+  for (uint32_t i = 0; i < page->segment_count; i++) {
+    uint32_t left = page->skyline[i].x, top = 0, covered = 0;
+
+    if (left + width > ZSURF_ATLAS_PAGE_SIZE) break;
+
+    for (uint32_t j = i; covered < width; j++) {
+      if (page->skyline[j].y > top) top = page->skyline[j].y;
+      covered += page->skyline[j].width;
+    }
+    if (top + height > ZSURF_ATLAS_PAGE_SIZE) continue;
+
+    if (top + height < best_top ||
+        (top + height == best_top && page->skyline[i].width < best_width)) {
+      best = i;
+      best_top = top + height;
+      best_width = page->skyline[i].width;
+      *x = left;
+      *y = top;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * raise the skyline over the rectangle placed at segment index
+ */
+static void
+zsurf_atlas_page_raise(struct zsurf_atlas_page* page, int index,
+    uint32_t width, uint32_t height, uint32_t y)
+{
+  struct zsurf_atlas_segment* skyline = page->skyline;
+  uint32_t x = skyline[index].x, end = x + width;
+  uint32_t i = index, j;
+
+  // drop the segments the rectangle covers, cut the last one it ends in
+  for (j = i; j < page->segment_count; j++) {
+    uint32_t segment_end = skyline[j].x + skyline[j].width;
+    if (segment_end > end) {
+      skyline[j].width = segment_end - end;
+      skyline[j].x = end;
+      break;
+    }
+  }
+  memmove(&skyline[i + 1], &skyline[j],
+      (page->segment_count - j) * sizeof *skyline);
+  page->segment_count = page->segment_count - j + i + 1;
+  skyline[i] = (struct zsurf_atlas_segment){x, y + height, width};
+
+  // neighbours at the same height become one segment
+  if (i + 1 < page->segment_count && skyline[i + 1].y == skyline[i].y) {
+    skyline[i].width += skyline[i + 1].width;
+    memmove(&skyline[i + 1], &skyline[i + 2],
+        (page->segment_count - i - 2) * sizeof *skyline);
+    page->segment_count--;
+  }
+  if (i > 0 && skyline[i - 1].y == skyline[i].y) {
+    skyline[i - 1].width += skyline[i].width;
+    memmove(&skyline[i], &skyline[i + 1],
+        (page->segment_count - i - 1) * sizeof *skyline);
+    page->segment_count--;
+  }
+}
+
+static bool
+zsurf_atlas_page_insert(
+    struct zsurf_atlas_page* page, struct zsurf_atlas_entry* entry)
+{
+  uint32_t width = entry->width + ZSURF_ATLAS_PADDING;
+  uint32_t height = entry->height + ZSURF_ATLAS_PADDING;
+  uint32_t x, y;
+  int index;
+
+  index = zsurf_atlas_page_find(page, width, height, &x, &y);
+  if (index < 0) return false;
+
+  zsurf_atlas_page_raise(page, index, width, height, y);
+
+  entry->page = page;
+  entry->x = x;
+  entry->y = y;
+  page->used_area += (uint64_t)width * height;
+  wl_list_insert(page->entry_list.prev, &entry->link);
+
+  return true;
+}
+
+static void
+zsurf_atlas_page_attach(struct zsurf_atlas_page* page)
+{
+  zgn_opengl_texture_attach_2d(page->texture, page->buffer);
+}
+
+static int
+compare_entry_height(const void* a, const void* b)
+{
+  const struct zsurf_atlas_entry* x = *(struct zsurf_atlas_entry* const*)a;
+  const struct zsurf_atlas_entry* y = *(struct zsurf_atlas_entry* const*)b;
+
+  return x->height < y->height ? 1 : x->height > y->height ? -1 : 0;
+}
+
+/**
+ * Pack the entries of the page again, tallest first, to merge the holes
+ * that removed entries left under the skyline. The entries go to target,
+ * the page itself or an empty one, and are told they moved.
+ * return -1 when out of memory or the entries do not fit packed that way,
+ * both pages are unchanged then
+ */
+static int
+zsurf_atlas_page_defragment(
+    struct zsurf_atlas_page* page, struct zsurf_atlas_page* target)
+{
+  uint32_t count = wl_list_length(&page->entry_list), i = 0;
+  struct zsurf_atlas_entry **entries, *entry, old;
+  struct zsurf_atlas_page* packed;
+  struct zsurf_color_bgra *pixels = NULL, *p;
+  uint32_t(*places)[2];
+  size_t pixel_count = 0;
+  uint64_t trace = zsurf_trace_begin();
+
+  entries = calloc(count, sizeof *entries);
+  places = calloc(count, sizeof *places);
+  packed = malloc(sizeof *packed);
+  if ((count > 0 && (entries == NULL || places == NULL)) || packed == NULL)
+    goto err;
+
+  wl_list_for_each(entry, &page->entry_list, link)
+  {
+    entries[i++] = entry;
+    pixel_count += (size_t)entry->width * entry->height;
+  }
+  qsort(entries, count, sizeof *entries, compare_entry_height);
+
+  // pack on the side first, a heuristic packing may not fit what did before
+  zsurf_atlas_page_reset(packed);
+  for (i = 0; i < count; i++) {
+    uint32_t width = entries[i]->width + ZSURF_ATLAS_PADDING;
+    uint32_t height = entries[i]->height + ZSURF_ATLAS_PADDING;
+    int index = zsurf_atlas_page_find(
+        packed, width, height, &places[i][0], &places[i][1]);
+    if (index < 0) goto err;
+    zsurf_atlas_page_raise(packed, index, width, height, places[i][1]);
+  }
+
+  if (target == page) {
+    pixels = malloc(pixel_count * sizeof *pixels);
+    if (pixels == NULL && pixel_count > 0) goto err;
+
+    // new places overlap old ones, move every entry out first
+    p = pixels;
+    for (i = 0; i < count; i++) {
+      entry = entries[i];
+      for (uint32_t row = 0; row < entry->height; row++, p += entry->width)
+        memcpy(p, zsurf_atlas_entry_row(entry, row),
+            entry->width * sizeof *pixels);
+    }
+    memset(page->data, 0, ZSURF_ATLAS_PAGE_BYTES);
+  }
+
+  memcpy(target->skyline, packed->skyline,
+      packed->segment_count * sizeof *packed->skyline);
+  target->segment_count = packed->segment_count;
+
+  p = pixels;
+  for (i = 0; i < count; i++) {
+    entry = entries[i];
+    old = *entry;
+    entry->x = places[i][0];
+    entry->y = places[i][1];
+
+    if (target != page) {
+      uint64_t area = (uint64_t)(entry->width + ZSURF_ATLAS_PADDING) *
+                      (entry->height + ZSURF_ATLAS_PADDING);
+      wl_list_remove(&entry->link);
+      wl_list_insert(target->entry_list.prev, &entry->link);
+      page->used_area -= area;
+      target->used_area += area;
+      entry->page = target;
+    }
+
+    for (uint32_t row = 0; row < entry->height; row++) {
+      memcpy(zsurf_atlas_entry_row(entry, row),
+          p ? p : zsurf_atlas_entry_row(&old, row),
+          entry->width * sizeof *pixels);
+      if (p) p += entry->width;
+    }
+    entry->moved(entry);
+  }
+
+  zsurf_atlas_page_attach(target);
+
+  free(pixels);
+  free(packed);
+  free(places);
+  free(entries);
+
+  zsurf_trace_end(
+      ZSURF_TRACE_TEXTURE_COPY, trace, pixel_count * sizeof *pixels);
+
+  return 0;
+
+err:
+  free(packed);
+  free(places);
+  free(entries);
+
+  return -1;
+}
+
+bool
+zsurf_atlas_page_place(struct zsurf_atlas_page* page,
+    struct zsurf_atlas_entry* entry, uint32_t width, uint32_t height)
+{
+  uint64_t area = (uint64_t)(width + ZSURF_ATLAS_PADDING) *
+                  (height + ZSURF_ATLAS_PADDING);
+
+  entry->width = width;
+  entry->height = height;
+
+  if (zsurf_atlas_page_insert(page, entry)) return true;
+
+  // the holes of removed entries may hold it once merged
+  if ((uint64_t)ZSURF_ATLAS_PAGE_SIZE * ZSURF_ATLAS_PAGE_SIZE -
+          page->used_area <
+      area)
+    return false;
+  if (zsurf_atlas_page_defragment(page, page) != 0) return false;
+
+  return zsurf_atlas_page_insert(page, entry);
+}
+
+void
+zsurf_atlas_page_remove(struct zsurf_atlas_entry* entry)
+{
+  struct zsurf_atlas_page* page = entry->page;
+
+  wl_list_remove(&entry->link);
+  page->used_area -= (uint64_t)(entry->width + ZSURF_ATLAS_PADDING) *
+                     (entry->height + ZSURF_ATLAS_PADDING);
+  entry->page = NULL;
+
+  if (wl_list_empty(&page->entry_list)) zsurf_atlas_page_reset(page);
+}
+
+void
+zsurf_atlas_init(struct zsurf_atlas* atlas)
+{
+  wl_list_init(&atlas->page_list);
+  wl_list_init(&atlas->retired_list);
+  atlas->page_count = 0;
+}
+
+void
+zsurf_atlas_fini(struct zsurf_display* surface_display)
+{
+  struct zsurf_atlas_page *page, *tmp;
+  struct zsurf_atlas_entry *entry, *entry_tmp;
+
+  wl_list_for_each_safe(page, tmp, &surface_display->atlas.page_list, link)
+  {
+    wl_list_remove(&page->link);
+    zsurf_atlas_page_destroy(page);
+  }
+
+  wl_list_for_each_safe(page, tmp, &surface_display->atlas.retired_list, link)
+  {
+    wl_list_for_each_safe(entry, entry_tmp, &page->hold_list, hold_link)
+    {
+      wl_list_remove(&entry->hold_link);
+      entry->held = NULL;
+    }
+    wl_list_remove(&page->link);
+    zsurf_atlas_page_destroy(page);
+  }
+}
+
+static void
+zsurf_atlas_destroy_unheld(struct zsurf_atlas_page* page)
+{
+  if (!wl_list_empty(&page->hold_list)) return;
+
+  wl_list_remove(&page->link);
+  zsurf_atlas_page_destroy(page);
+}
+
+/**
+ * Repack the entries of the page into a fresh page that takes its place.
+ * Their views only show the new page once their own toplevel commits, so
+ * the old page is retired unchanged and kept until every one has.
+ * return NULL when failed, the page is unchanged then
+ */
+static struct zsurf_atlas_page*
+zsurf_atlas_repack(struct zsurf_atlas* atlas, struct zsurf_atlas_page* page)
+{
+  struct zsurf_atlas_page* fresh;
+  struct zsurf_atlas_entry* entry;
+
+  fresh = zsurf_atlas_page_create(page->surface_display);
+  if (fresh == NULL) return NULL;
+
+  if (zsurf_atlas_page_defragment(page, fresh) != 0) {
+    zsurf_atlas_page_destroy(fresh);
+    return NULL;
+  }
+
+  wl_list_insert(&page->link, &fresh->link);
+  wl_list_remove(&page->link);
+  wl_list_insert(&atlas->retired_list, &page->link);
+
+  // an entry moved again before committing still shows the oldest page
+  wl_list_for_each(entry, &fresh->entry_list, link)
+  {
+    if (entry->held) continue;
+    entry->held = page;
+    wl_list_insert(&page->hold_list, &entry->hold_link);
+  }
+  zsurf_atlas_destroy_unheld(page);
+
+  return fresh;
+}
+
+int
+zsurf_atlas_place(struct zsurf_display* surface_display,
+    struct zsurf_atlas_entry* entry, uint32_t width, uint32_t height)
+{
+  struct zsurf_atlas* atlas = &surface_display->atlas;
+  struct zsurf_atlas_page *page, *tmp;
+  uint64_t area = (uint64_t)(width + ZSURF_ATLAS_PADDING) *
+                  (height + ZSURF_ATLAS_PADDING);
+
+  if (entry->page) {
+    if (entry->width == width && entry->height == height) return 0;
+    zsurf_atlas_remove(entry);
+  }
+
+  // try every page as it is before repacking any
+  entry->width = width;
+  entry->height = height;
+  wl_list_for_each(page, &atlas->page_list, link)
+  {
+    if (zsurf_atlas_page_insert(page, entry)) return 0;
+  }
+
+  // the holes of removed entries may hold it once merged
+  wl_list_for_each_safe(page, tmp, &atlas->page_list, link)
+  {
+    if ((uint64_t)ZSURF_ATLAS_PAGE_SIZE * ZSURF_ATLAS_PAGE_SIZE -
+            page->used_area <
+        area)
+      continue;
+    page = zsurf_atlas_repack(atlas, page);
+    if (page && zsurf_atlas_page_insert(page, entry)) return 0;
+  }
+
+  page = zsurf_atlas_page_create(surface_display);
+  if (page == NULL) return -1;
+  wl_list_insert(atlas->page_list.prev, &page->link);
+  atlas->page_count++;
+
+  zsurf_atlas_page_insert(page, entry);
+
+  return 0;
+}
+
+void
+zsurf_atlas_remove(struct zsurf_atlas_entry* entry)
+{
+  struct zsurf_atlas_page* page = entry->page;
+  struct zsurf_atlas* atlas = &page->surface_display->atlas;
+
+  zsurf_atlas_page_remove(entry);
+
+  // one empty page is kept for the next small view
+  if (wl_list_empty(&page->entry_list) && atlas->page_count > 1) {
+    wl_list_remove(&page->link);
+    atlas->page_count--;
+    zsurf_atlas_page_destroy(page);
+  }
+}
+
+void
+zsurf_atlas_release(struct zsurf_atlas_entry* entry)
+{
+  struct zsurf_atlas_page* page = entry->held;
+
+  if (page == NULL) return;
+
+  wl_list_remove(&entry->hold_link);
+  entry->held = NULL;
+  zsurf_atlas_destroy_unheld(page);
+}
+
+void
+zsurf_atlas_commit(struct zsurf_toplevel* toplevel)
+{
+  struct zsurf_atlas* atlas = &toplevel->surface_display->atlas;
+  struct zsurf_atlas_page *page, *tmp;
+  struct zsurf_atlas_entry *entry, *entry_tmp;
+
+  wl_list_for_each_safe(page, tmp, &atlas->retired_list, link)
+  {
+    wl_list_for_each_safe(entry, entry_tmp, &page->hold_list, hold_link)
+    {
+      if (entry->toplevel != toplevel) continue;
+      wl_list_remove(&entry->hold_link);
+      entry->held = NULL;
+    }
+    zsurf_atlas_destroy_unheld(page);
+  }
+}
+
+void
+zsurf_atlas_write(
+    struct zsurf_atlas_entry* entry, const struct zsurf_color_bgra* data)
+{
+  for (uint32_t row = 0; row < entry->height; row++)
+    memcpy(zsurf_atlas_entry_row(entry, row), data + row * entry->width,
+        entry->width * sizeof *data);
+
+  zsurf_atlas_page_attach(entry->page);
+}
+
+void
+zsurf_atlas_uv(struct zsurf_atlas_entry* entry, vec2 uv0, vec2 uv1)
+{
+  float scale = 1.0f / ZSURF_ATLAS_PAGE_SIZE;
+
+  uv0[0] = (entry->x + uv0[0] * entry->width) * scale;
+  uv0[1] = (entry->y + uv0[1] * entry->height) * scale;
+  uv1[0] = (entry->x + uv1[0] * entry->width) * scale;
+  uv1[1] = (entry->y + uv1[1] * entry->height) * scale;
+}
@@ -0,0 +1,306 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+static void
+zsurf_batch_attach_vertex_buffer(struct zsurf_batch* batch)
+{
+  zgn_opengl_vertex_buffer_attach(
+      batch->vertex_buffer, batch->vertex_buffer_buffer);
+  zgn_opengl_component_attach_vertex_buffer(
+      batch->component, batch->vertex_buffer);
+}
+
+/**
+ * rewrite the rect of one tile, laid out like a child view of the parent
+ */
+static void
+zsurf_batch_write_tile(struct zsurf_batch* batch, uint32_t index)
+{
+  struct zsurf_batch_tile* tile = &batch->tiles[index];
+  struct zsurf_batch_quad* quad = &tile->quad;
+  struct zsurf_view* parent = batch->parent;
+  struct view_rect* rect = &batch->vertex_data[index];
+  vec2 half_size, center, uv0 = {0.0f, 0.0f}, uv1 = {1.0f, 1.0f};
+  float z;
+
+  // a degenerate rect draws nothing
+  if (tile->atlas.page == NULL) {
+    memset(rect, 0, sizeof *rect);
+    return;
+  }
+
+  half_size[0] = quad->width * parent->space_geometry.half_size[0] /
+                 parent->surface_geometry.width;
+  half_size[1] = quad->height * parent->space_geometry.half_size[1] /
+                 parent->surface_geometry.height;
+  center[0] = ((float)quad->sx * 2 + quad->width -
+                  parent->surface_geometry.width) *
+                  parent->space_geometry.half_size[0] /
+                  parent->surface_geometry.width +
+              parent->space_geometry.center[0];
+  center[1] = ((float)parent->surface_geometry.height - quad->sy * 2 -
+                  quad->height) *
+                  parent->space_geometry.half_size[1] /
+                  parent->surface_geometry.height +
+              parent->space_geometry.center[1];
+
+  if (quad->source.width > 0 && quad->source.height > 0) {
+    uv0[0] = glm_clamp((float)quad->source.x / tile->atlas.width, 0.0f, 1.0f);
+    uv0[1] = glm_clamp((float)quad->source.y / tile->atlas.height, 0.0f, 1.0f);
+    uv1[0] = glm_clamp(
+        (float)(quad->source.x + quad->source.width) / tile->atlas.width, 0.0f,
+        1.0f);
+    uv1[1] = glm_clamp(
+        (float)(quad->source.y + quad->source.height) / tile->atlas.height,
+        0.0f, 1.0f);
+  }
+  zsurf_atlas_uv(&tile->atlas, uv0, uv1);
+
+  z = (float)(batch->z_index + quad->z) / 500;
+  struct vertex A = {{-half_size[0] + center[0], -half_size[1] + center[1], z},
+      {uv0[0], uv1[1]}};
+  struct vertex B = {{+half_size[0] + center[0], -half_size[1] + center[1], z},
+      {uv1[0], uv1[1]}};
+  struct vertex C = {{+half_size[0] + center[0], +half_size[1] + center[1], z},
+      {uv1[0], uv0[1]}};
+  struct vertex D = {{-half_size[0] + center[0], +half_size[1] + center[1], z},
+      {uv0[0], uv0[1]}};
+
+  rect->triangles[0].vertices[0] = A;
+  rect->triangles[0].vertices[1] = C;
+  rect->triangles[0].vertices[2] = D;
+  rect->triangles[1].vertices[0] = A;
+  rect->triangles[1].vertices[1] = C;
+  rect->triangles[1].vertices[2] = B;
+}
+
+static void
+zsurf_batch_tile_moved(struct zsurf_atlas_entry* entry)
+{
+  struct zsurf_batch_tile* tile = wl_container_of(entry, tile, atlas);
+  struct zsurf_batch* batch = tile->batch;
+
+  // attached once by the caller that defragmented
+  zsurf_batch_write_tile(batch, tile - batch->tiles);
+}
+
+static void
+zsurf_batch_parent_geometry_handler(
+    struct zsurf_listener* listener, void* data)
+{
+  UNUSED(data);
+  struct zsurf_batch* batch =
+      wl_container_of(listener, batch, parent_geometry_listener);
+  uint64_t trace = zsurf_trace_begin();
+  mat4 rotate;
+
+  glm_quat_mat4(batch->toplevel->quaternion, rotate);
+  {
+    struct wl_array rotate_array;
+    glm_mat4_as_wl_array(rotate, &rotate_array);
+    zgn_opengl_shader_program_set_uniform_float_matrix(
+        batch->shader, "rotate", 4, 4, false, 1, &rotate_array);
+  }
+  zgn_opengl_component_attach_shader_program(batch->component, batch->shader);
+
+  for (uint32_t i = 0; i < batch->capacity; i++)
+    zsurf_batch_write_tile(batch, i);
+  zsurf_batch_attach_vertex_buffer(batch);
+
+  zsurf_trace_end(ZSURF_TRACE_GEOMETRY, trace, batch->capacity);
+}
+
+WL_EXPORT struct zsurf_batch*
+zsurf_batch_create(struct zsurf_view* parent, uint32_t capacity)
+{
+  struct zsurf_display* surface_display = parent->surface_display;
+  uint32_t record_id = zsurf_view_record_id(parent);
+  struct zsurf_batch* batch;
+  mat4 rotate;
+
+  batch = zalloc(sizeof *batch);
+  if (batch == NULL) goto err;
+
+  batch->tiles = calloc(capacity, sizeof *batch->tiles);
+  if (batch->tiles == NULL && capacity > 0) goto err_tiles;
+
+  batch->page = zsurf_atlas_page_create(surface_display);
+  if (batch->page == NULL) goto err_page;
+
+  // a 0 sized pool is refused, keep one rect at least
+  batch->vertex_data_size =
+      sizeof *batch->vertex_data * (capacity > 0 ? capacity : 1);
+  batch->fd = zsurf_create_shared_fd(batch->vertex_data_size);
+  if (batch->fd < 0) goto err_fd;
+
+  batch->vertex_data = mmap(NULL, batch->vertex_data_size,
+      PROT_READ | PROT_WRITE, MAP_SHARED, batch->fd, 0);
+  if (batch->vertex_data == MAP_FAILED) goto err_mmap;
+
+  batch->surface_display = surface_display;
+  batch->toplevel = parent->toplevel;
+  batch->parent = parent;
+  batch->z_index = parent->z_index + 1;
+  batch->capacity = capacity;
+  for (uint32_t i = 0; i < capacity; i++) {
+    batch->tiles[i].batch = batch;
+    batch->tiles[i].atlas.moved = zsurf_batch_tile_moved;
+  }
+
+  batch->pool = wl_shm_create_pool(
+      surface_display->shm, batch->fd, batch->vertex_data_size);
+  batch->vertex_buffer =
+      zgn_opengl_create_vertex_buffer(surface_display->opengl);
+  batch->vertex_buffer_buffer = wl_shm_pool_create_buffer(batch->pool, 0,
+      batch->vertex_data_size, 1, batch->vertex_data_size, 0);
+
+  glm_quat_mat4(batch->toplevel->quaternion, rotate);
+  batch->color_transform = zsurf_view_color_transform_identity;
+  batch->shader = zsurf_view_create_shader(surface_display,
+      ZSURF_VIEW_SHADER_RGBA, rotate, &batch->color_transform, 1);
+
+  batch->component = zgn_opengl_create_opengl_component(
+      surface_display->opengl, batch->toplevel->virtual_object);
+  zgn_opengl_component_attach_shader_program(batch->component, batch->shader);
+  zgn_opengl_component_attach_texture(batch->component, batch->page->texture);
+  zgn_opengl_component_add_vertex_attribute(batch->component, 0, 3,
+      ZGN_OPENGL_VERTEX_ATTRIBUTE_TYPE_FLOAT, false, sizeof(struct vertex),
+      offsetof(struct vertex, p));
+  zgn_opengl_component_add_vertex_attribute(batch->component, 1, 2,
+      ZGN_OPENGL_VERTEX_ATTRIBUTE_TYPE_FLOAT, false, sizeof(struct vertex),
+      offsetof(struct vertex, uv));
+  zgn_opengl_component_set_count(
+      batch->component, capacity * sizeof(struct view_rect) / sizeof(float));
+  zgn_opengl_component_set_topology(
+      batch->component, ZGN_OPENGL_TOPOLOGY_TRIANGLES);
+  zsurf_batch_attach_vertex_buffer(batch);
+
+  batch->parent_geometry_listener.notify = zsurf_batch_parent_geometry_handler;
+  zsurf_signal_add(&parent->geometry_signal, &batch->parent_geometry_listener);
+
+  if (record_id) {
+    uint32_t payload[] = {record_id, capacity};
+    batch->record_id = ++surface_display->record_next_id;
+    zsurf_record(surface_display, ZSURF_RECORD_BATCH_CREATE, batch->record_id,
+        payload, sizeof payload);
+  }
+
+  return batch;
+
+err_mmap:
+  close(batch->fd);
+
+err_fd:
+  zsurf_atlas_page_destroy(batch->page);
+
+err_page:
+  free(batch->tiles);
+
+err_tiles:
+  free(batch);
+
+err:
+  return NULL;
+}
+
+WL_EXPORT void
+zsurf_batch_destroy(struct zsurf_batch* batch)
+{
+  if (batch->record_id)
+    zsurf_record(batch->surface_display, ZSURF_RECORD_BATCH_DESTROY,
+        batch->record_id, NULL, 0);
+
+  wl_list_remove(&batch->parent_geometry_listener.link);
+  zgn_opengl_component_destroy(batch->component);
+  zgn_opengl_shader_program_destroy(batch->shader);
+  zgn_opengl_vertex_buffer_destroy(batch->vertex_buffer);
+  wl_buffer_destroy(batch->vertex_buffer_buffer);
+  wl_shm_pool_destroy(batch->pool);
+  munmap(batch->vertex_data, batch->vertex_data_size);
+  close(batch->fd);
+  zsurf_atlas_page_destroy(batch->page);
+  free(batch->tiles);
+  free(batch);
+}
+
+WL_EXPORT int
+zsurf_batch_set_quad(struct zsurf_batch* batch, uint32_t index,
+    const struct zsurf_batch_quad* quad)
+{
+  if (batch->record_id) {
+    uint32_t payload[] = {index, quad->sx, quad->sy, quad->width,
+        quad->height, quad->source.x, quad->source.y, quad->source.width,
+        quad->source.height, quad->z};
+    zsurf_record(batch->surface_display, ZSURF_RECORD_BATCH_SET_QUAD,
+        batch->record_id, payload, sizeof payload);
+  }
+
+  if (index >= batch->capacity) return -1;
+
+  batch->tiles[index].quad = *quad;
+  zsurf_batch_write_tile(batch, index);
+  zsurf_batch_attach_vertex_buffer(batch);
+
+  return 0;
+}
+
+WL_EXPORT int
+zsurf_batch_set_quad_texture(struct zsurf_batch* batch, uint32_t index,
+    const struct zsurf_color_bgra* data, uint32_t width, uint32_t height)
+{
+  struct zsurf_batch_tile* tile;
+  uint64_t trace;
+
+  if (batch->record_id) {
+    uint32_t payload[] = {index, width, height};
+    zsurf_record(batch->surface_display, ZSURF_RECORD_BATCH_SET_QUAD_TEXTURE,
+        batch->record_id, payload, sizeof payload);
+  }
+
+  if (index >= batch->capacity) return -1;
+  if (width > ZSURF_ATLAS_MAX_SIZE || height > ZSURF_ATLAS_MAX_SIZE) return -1;
+
+  tile = &batch->tiles[index];
+  if (tile->atlas.page == NULL || tile->atlas.width != width ||
+      tile->atlas.height != height) {
+    if (tile->atlas.page) zsurf_atlas_page_remove(&tile->atlas);
+    if (!zsurf_atlas_page_place(batch->page, &tile->atlas, width, height)) {
+      zsurf_batch_write_tile(batch, index);
+      zsurf_batch_attach_vertex_buffer(batch);
+      return -1;
+    }
+  }
+
+  trace = zsurf_trace_begin();
+  zsurf_atlas_write(&tile->atlas, data);
+  zsurf_trace_end(ZSURF_TRACE_TEXTURE_COPY, trace,
+      (uint64_t)width * height * sizeof *data);
+
+  zgn_opengl_component_attach_texture(batch->component, batch->page->texture);
+  zsurf_batch_write_tile(batch, index);
+  zsurf_batch_attach_vertex_buffer(batch);
+
+  return 0;
+}
+
+WL_EXPORT void
+zsurf_batch_clear_quad(struct zsurf_batch* batch, uint32_t index)
+{
+  struct zsurf_batch_tile* tile;
+
+  if (batch->record_id)
+    zsurf_record(batch->surface_display, ZSURF_RECORD_BATCH_CLEAR_QUAD,
+        batch->record_id, &index, sizeof index);
+
+  if (index >= batch->capacity) return;
+
+  tile = &batch->tiles[index];
+  if (tile->atlas.page == NULL) return;
+
+  zsurf_atlas_page_remove(&tile->atlas);
+  zsurf_batch_write_tile(batch, index);
+  zsurf_batch_attach_vertex_buffer(batch);
+}
@@ -0,0 +1,680 @@
+#include <pthread.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZSURF_CONVERT_X86 1
+#else
+#define ZSURF_CONVERT_X86 0
+#endif
+
+static enum zsurf_convert_level zsurf_convert_level;
+static pthread_once_t zsurf_convert_level_once = PTHREAD_ONCE_INIT;
+
+static inline uint8_t
+zsurf_convert_unpremultiply(uint8_t c, uint8_t a)
+{
+  // a color above its alpha is not premultiplied data, saturate it
+  if (c > a) c = a;
+  return a ? (c * 255 + a / 2) / a : 0;
+}
+
+static void
+zsurf_convert_bgra8888_scalar(void* dst, const void* src, uint32_t width)
+{
+  memcpy(dst, src, (size_t)width * sizeof(struct zsurf_color_bgra));
+}
+
+static void
+zsurf_convert_rgba8888_scalar(void* dst, const void* src, uint32_t width)
+{
+  struct zsurf_color_bgra* d = dst;
+  const uint8_t* s = src;
+
+  for (uint32_t i = 0; i < width; i++, s += 4)
+    d[i] = (struct zsurf_color_bgra){s[2], s[1], s[0], s[3]};
+}
+
+static void
+zsurf_convert_rgb888_scalar(void* dst, const void* src, uint32_t width)
+{
+  struct zsurf_color_bgra* d = dst;
+  const uint8_t* s = src;
+
+  for (uint32_t i = 0; i < width; i++, s += 3)
+    d[i] = (struct zsurf_color_bgra){s[2], s[1], s[0], 255};
+}
+
+static void
+zsurf_convert_bgrx8888_scalar(void* dst, const void* src, uint32_t width)
+{
+  struct zsurf_color_bgra* d = dst;
+  const uint8_t* s = src;
+
+  for (uint32_t i = 0; i < width; i++, s += 4)
+    d[i] = (struct zsurf_color_bgra){s[0], s[1], s[2], 255};
+}
+
+static void
+zsurf_convert_rgb565_scalar(void* dst, const void* src, uint32_t width)
+{
+  struct zsurf_color_bgra* d = dst;
+  const uint8_t* s = src;
+
+  for (uint32_t i = 0; i < width; i++, s += 2) {
+    uint32_t v = s[0] | s[1] << 8;
+    uint8_t r = v >> 11, g = (v >> 5) & 0x3f, b = v & 0x1f;
+
+    // replicate the top bits, so that full intensity stays 255
+    d[i] = (struct zsurf_color_bgra){
+        b << 3 | b >> 2, g << 2 | g >> 4, r << 3 | r >> 2, 255};
+  }
+}
+
+static void
+zsurf_convert_r8_scalar(void* dst, const void* src, uint32_t width)
+{
+  struct zsurf_color_bgra* d = dst;
+  const uint8_t* s = src;
+
+  for (uint32_t i = 0; i < width; i++)
+    d[i] = (struct zsurf_color_bgra){s[i], s[i], s[i], 255};
+}
+
+static void
+zsurf_convert_rgba8888_premultiplied_scalar(
+    void* dst, const void* src, uint32_t width)
+{
+  struct zsurf_color_bgra* d = dst;
+  const uint8_t* s = src;
+
+  for (uint32_t i = 0; i < width; i++, s += 4) {
+    d[i] = (struct zsurf_color_bgra){
+        zsurf_convert_unpremultiply(s[2], s[3]),
+        zsurf_convert_unpremultiply(s[1], s[3]),
+        zsurf_convert_unpremultiply(s[0], s[3]),
+        s[3],
+    };
+  }
+}
+
+#if ZSURF_CONVERT_X86
+
+/**
+ * swap the 1st and 3rd byte of every 32-bit lane
+ */
+__attribute__((target("sse2"))) static inline __m128i
+zsurf_convert_swap_rb_sse2(__m128i x)
+{
+  const __m128i ga = _mm_set1_epi32((int)0xff00ff00);
+  const __m128i low = _mm_set1_epi32(0xff);
+
+  return _mm_or_si128(_mm_and_si128(x, ga),
+      _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, low), 16),
+          _mm_and_si128(_mm_srli_epi32(x, 16), low)));
+}
+
+__attribute__((target("sse2"))) static void
+zsurf_convert_rgba8888_sse2(void* dst, const void* src, uint32_t width)
+{
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 4 <= width; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(s + i * 4));
+    _mm_storeu_si128((__m128i*)(d + i * 4), zsurf_convert_swap_rb_sse2(x));
+  }
+
+  zsurf_convert_rgba8888_scalar(d + i * 4, s + i * 4, width - i);
+}
+
+/**
+ * one pixel per 32-bit lanes, unpremultiplied in float. The division is
+ * exact enough that truncating gives the same bytes as the scalar path.
+ */
+__attribute__((target("sse2"))) static inline __m128i
+zsurf_convert_unpremultiply_sse2(__m128i pixel)
+{
+  const __m128i alpha_lane = _mm_set_epi32(-1, 0, 0, 0);
+  __m128i alpha = _mm_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128 a = _mm_cvtepi32_ps(alpha);
+  __m128 c = _mm_min_ps(_mm_cvtepi32_ps(pixel), a);
+  __m128 half = _mm_cvtepi32_ps(_mm_srli_epi32(alpha, 1));
+  __m128 q =
+      _mm_div_ps(_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), half), a);
+  __m128i out = _mm_cvttps_epi32(q);
+
+  // alpha 0 divides by 0, the result is all 0 anyway
+  out = _mm_andnot_si128(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()), out);
+
+  return _mm_or_si128(_mm_andnot_si128(alpha_lane, out),
+      _mm_and_si128(alpha_lane, pixel));
+}
+
+__attribute__((target("sse2"))) static void
+zsurf_convert_rgba8888_premultiplied_sse2(
+    void* dst, const void* src, uint32_t width)
+{
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t i = 0;
+
+  for (; i + 4 <= width; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(s + i * 4));
+    __m128i lo = _mm_unpacklo_epi8(x, zero);
+    __m128i hi = _mm_unpackhi_epi8(x, zero);
+    __m128i p0 = zsurf_convert_unpremultiply_sse2(_mm_unpacklo_epi16(lo, zero));
+    __m128i p1 = zsurf_convert_unpremultiply_sse2(_mm_unpackhi_epi16(lo, zero));
+    __m128i p2 = zsurf_convert_unpremultiply_sse2(_mm_unpacklo_epi16(hi, zero));
+    __m128i p3 = zsurf_convert_unpremultiply_sse2(_mm_unpackhi_epi16(hi, zero));
+    __m128i out = _mm_packus_epi16(
+        _mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+
+    _mm_storeu_si128((__m128i*)(d + i * 4), zsurf_convert_swap_rb_sse2(out));
+  }
+
+  zsurf_convert_rgba8888_premultiplied_scalar(d + i * 4, s + i * 4, width - i);
+}
+
+__attribute__((target("sse2"))) static void
+zsurf_convert_bgrx8888_sse2(void* dst, const void* src, uint32_t width)
+{
+  const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 4 <= width; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(s + i * 4));
+    _mm_storeu_si128((__m128i*)(d + i * 4), _mm_or_si128(x, alpha));
+  }
+
+  zsurf_convert_bgrx8888_scalar(d + i * 4, s + i * 4, width - i);
+}
+
+/**
+ * 8 pixels of 16 bits each to bgra, top bits replicated as in the scalar path
+ */
+__attribute__((target("sse2"))) static inline void
+zsurf_convert_rgb565_expand_sse2(__m128i v, __m128i* lo, __m128i* hi)
+{
+  const __m128i mask5 = _mm_set1_epi16(0x1f);
+  const __m128i mask6 = _mm_set1_epi16(0x3f);
+  __m128i r = _mm_srli_epi16(v, 11);
+  __m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+  __m128i b = _mm_and_si128(v, mask5);
+
+  r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+  g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+  b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+  __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+  __m128i ra = _mm_or_si128(r, _mm_set1_epi16((short)0xff00));
+
+  *lo = _mm_unpacklo_epi16(bg, ra);
+  *hi = _mm_unpackhi_epi16(bg, ra);
+}
+
+__attribute__((target("sse2"))) static void
+zsurf_convert_rgb565_sse2(void* dst, const void* src, uint32_t width)
+{
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 8 <= width; i += 8) {
+    __m128i lo, hi;
+    zsurf_convert_rgb565_expand_sse2(
+        _mm_loadu_si128((const __m128i*)(s + i * 2)), &lo, &hi);
+    _mm_storeu_si128((__m128i*)(d + i * 4), lo);
+    _mm_storeu_si128((__m128i*)(d + i * 4 + 16), hi);
+  }
+
+  zsurf_convert_rgb565_scalar(d + i * 4, s + i * 2, width - i);
+}
+
+__attribute__((target("sse2"))) static void
+zsurf_convert_r8_sse2(void* dst, const void* src, uint32_t width)
+{
+  const __m128i opaque = _mm_set1_epi8((char)0xff);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 16 <= width; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+    // gray gray as one 16-bit half, gray 255 as the other
+    __m128i gg_lo = _mm_unpacklo_epi8(x, x), gg_hi = _mm_unpackhi_epi8(x, x);
+    __m128i ga_lo = _mm_unpacklo_epi8(x, opaque);
+    __m128i ga_hi = _mm_unpackhi_epi8(x, opaque);
+
+    _mm_storeu_si128(
+        (__m128i*)(d + i * 4), _mm_unpacklo_epi16(gg_lo, ga_lo));
+    _mm_storeu_si128(
+        (__m128i*)(d + i * 4 + 16), _mm_unpackhi_epi16(gg_lo, ga_lo));
+    _mm_storeu_si128(
+        (__m128i*)(d + i * 4 + 32), _mm_unpacklo_epi16(gg_hi, ga_hi));
+    _mm_storeu_si128(
+        (__m128i*)(d + i * 4 + 48), _mm_unpackhi_epi16(gg_hi, ga_hi));
+  }
+
+  zsurf_convert_r8_scalar(d + i * 4, s + i, width - i);
+}
+
+__attribute__((target("avx2"))) static void
+zsurf_convert_rgba8888_avx2(void* dst, const void* src, uint32_t width)
+{
+  const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11,
+      14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 8 <= width; i += 8) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(s + i * 4));
+    _mm256_storeu_si256((__m256i*)(d + i * 4), _mm256_shuffle_epi8(x, swap));
+  }
+
+  zsurf_convert_rgba8888_sse2(d + i * 4, s + i * 4, width - i);
+}
+
+__attribute__((target("avx2"))) static void
+zsurf_convert_rgb888_avx2(void* dst, const void* src, uint32_t width)
+{
+  // 4 pixels of each 128-bit lane, the last 4 bytes of the load are unused
+  const __m256i expand = _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6,
+      -1, 11, 10, 9, -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  // the second load reads 4 bytes past its pixels, stay inside the row
+  for (; i + 10 <= width; i += 8) {
+    __m256i x = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(s + i * 3))),
+        _mm_loadu_si128((const __m128i*)(s + i * 3 + 12)), 1);
+    x = _mm256_or_si256(_mm256_shuffle_epi8(x, expand), alpha);
+    _mm256_storeu_si256((__m256i*)(d + i * 4), x);
+  }
+
+  zsurf_convert_rgb888_scalar(d + i * 4, s + i * 3, width - i);
+}
+
+__attribute__((target("avx2"))) static void
+zsurf_convert_bgrx8888_avx2(void* dst, const void* src, uint32_t width)
+{
+  const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 8 <= width; i += 8) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(s + i * 4));
+    _mm256_storeu_si256((__m256i*)(d + i * 4), _mm256_or_si256(x, alpha));
+  }
+
+  zsurf_convert_bgrx8888_sse2(d + i * 4, s + i * 4, width - i);
+}
+
+__attribute__((target("avx2"))) static void
+zsurf_convert_r8_avx2(void* dst, const void* src, uint32_t width)
+{
+  const __m256i spread = _mm256_set1_epi32(0x00010101);
+  const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 8 <= width; i += 8) {
+    __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + i)));
+    x = _mm256_or_si256(_mm256_mullo_epi32(x, spread), alpha);
+    _mm256_storeu_si256((__m256i*)(d + i * 4), x);
+  }
+
+  zsurf_convert_r8_sse2(d + i * 4, s + i, width - i);
+}
+
+/**
+ * two pixels, one per 128-bit lane, unpremultiplied like the SSE2 version
+ */
+__attribute__((target("avx2"))) static inline __m256i
+zsurf_convert_unpremultiply_avx2(__m256i pixel)
+{
+  const __m256i alpha_lane = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+  __m256i alpha = _mm256_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+  __m256 a = _mm256_cvtepi32_ps(alpha);
+  __m256 c = _mm256_min_ps(_mm256_cvtepi32_ps(pixel), a);
+  __m256 half = _mm256_cvtepi32_ps(_mm256_srli_epi32(alpha, 1));
+  __m256 q = _mm256_div_ps(
+      _mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(255.0f)), half), a);
+  __m256i out = _mm256_cvttps_epi32(q);
+
+  out = _mm256_andnot_si256(
+      _mm256_cmpeq_epi32(alpha, _mm256_setzero_si256()), out);
+
+  return _mm256_blendv_epi8(out, pixel, alpha_lane);
+}
+
+__attribute__((target("avx2"))) static void
+zsurf_convert_rgba8888_premultiplied_avx2(
+    void* dst, const void* src, uint32_t width)
+{
+  const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11,
+      14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  // packing works per lane and leaves the pixels as 0 2 4 6 1 3 5 7
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+  uint32_t i = 0;
+
+  for (; i + 8 <= width; i += 8) {
+    __m256i p[4];
+    for (int j = 0; j < 4; j++) {
+      __m128i two = _mm_loadl_epi64((const __m128i*)(s + (i + j * 2) * 4));
+      p[j] = zsurf_convert_unpremultiply_avx2(_mm256_cvtepu8_epi32(two));
+    }
+    __m256i out = _mm256_packus_epi16(
+        _mm256_packs_epi32(p[0], p[1]), _mm256_packs_epi32(p[2], p[3]));
+    out = _mm256_permutevar8x32_epi32(out, order);
+    _mm256_storeu_si256((__m256i*)(d + i * 4), _mm256_shuffle_epi8(out, swap));
+  }
+
+  zsurf_convert_rgba8888_premultiplied_sse2(d + i * 4, s + i * 4, width - i);
+}
+
+#endif  // ZSURF_CONVERT_X86
+
+// NULL falls back to the level below
+static const zsurf_convert_row_func_t
+    zsurf_convert_row_funcs[][ZSURF_CONVERT_LEVEL_COUNT] = {
+        [ZSURF_PIXEL_FORMAT_BGRA8888] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] = zsurf_convert_bgra8888_scalar,
+            },
+        [ZSURF_PIXEL_FORMAT_RGBA8888] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] = zsurf_convert_rgba8888_scalar,
+#if ZSURF_CONVERT_X86
+                [ZSURF_CONVERT_LEVEL_SSE2] = zsurf_convert_rgba8888_sse2,
+                [ZSURF_CONVERT_LEVEL_AVX2] = zsurf_convert_rgba8888_avx2,
+#endif
+            },
+        [ZSURF_PIXEL_FORMAT_RGB888] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] = zsurf_convert_rgb888_scalar,
+#if ZSURF_CONVERT_X86
+                [ZSURF_CONVERT_LEVEL_AVX2] = zsurf_convert_rgb888_avx2,
+#endif
+            },
+        [ZSURF_PIXEL_FORMAT_BGRX8888] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] = zsurf_convert_bgrx8888_scalar,
+#if ZSURF_CONVERT_X86
+                [ZSURF_CONVERT_LEVEL_SSE2] = zsurf_convert_bgrx8888_sse2,
+                [ZSURF_CONVERT_LEVEL_AVX2] = zsurf_convert_bgrx8888_avx2,
+#endif
+            },
+        [ZSURF_PIXEL_FORMAT_RGB565] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] = zsurf_convert_rgb565_scalar,
+#if ZSURF_CONVERT_X86
+                [ZSURF_CONVERT_LEVEL_SSE2] = zsurf_convert_rgb565_sse2,
+#endif
+            },
+        [ZSURF_PIXEL_FORMAT_R8] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] = zsurf_convert_r8_scalar,
+#if ZSURF_CONVERT_X86
+                [ZSURF_CONVERT_LEVEL_SSE2] = zsurf_convert_r8_sse2,
+                [ZSURF_CONVERT_LEVEL_AVX2] = zsurf_convert_r8_avx2,
+#endif
+            },
+        [ZSURF_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED] =
+            {
+                [ZSURF_CONVERT_LEVEL_SCALAR] =
+                    zsurf_convert_rgba8888_premultiplied_scalar,
+#if ZSURF_CONVERT_X86
+                [ZSURF_CONVERT_LEVEL_SSE2] =
+                    zsurf_convert_rgba8888_premultiplied_sse2,
+                [ZSURF_CONVERT_LEVEL_AVX2] =
+                    zsurf_convert_rgba8888_premultiplied_avx2,
+#endif
+            },
+};
+
+static void
+zsurf_convert_detect_level(void)
+{
+  zsurf_convert_level = ZSURF_CONVERT_LEVEL_SCALAR;
+
+#if ZSURF_CONVERT_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    zsurf_convert_level = ZSURF_CONVERT_LEVEL_AVX2;
+  else if (__builtin_cpu_supports("sse2"))
+    zsurf_convert_level = ZSURF_CONVERT_LEVEL_SSE2;
+#endif
+
+  zsurf_log_debug("zsurface: pixel conversion uses the %s kernels\n",
+      (const char*[]){"scalar", "sse2", "avx2"}[zsurf_convert_level]);
+}
+
+static inline uint8_t
+zsurf_convert_clamp(int32_t x)
+{
+  return x < 0 ? 0 : x > 255 ? 255 : x;
+}
+
+/**
+ * BT.601 limited range in 8.8 fixed point, the matrix of the yuv shaders
+ */
+static inline struct zsurf_color_bgra
+zsurf_convert_yuv_pixel(uint8_t y, uint8_t u, uint8_t v)
+{
+  int32_t c = 298 * (y - 16) + 128, d = u - 128, e = v - 128;
+
+  return (struct zsurf_color_bgra){
+      zsurf_convert_clamp((c + 516 * d) >> 8),
+      zsurf_convert_clamp((c - 100 * d - 208 * e) >> 8),
+      zsurf_convert_clamp((c + 409 * e) >> 8),
+      255,
+  };
+}
+
+enum zsurf_convert_level
+zsurf_convert_get_level(void)
+{
+  pthread_once(&zsurf_convert_level_once, zsurf_convert_detect_level);
+  return zsurf_convert_level;
+}
+
+uint32_t
+zsurf_convert_bytes_per_pixel(enum zsurf_pixel_format format)
+{
+  switch (format) {
+    case ZSURF_PIXEL_FORMAT_BGRA8888:
+    case ZSURF_PIXEL_FORMAT_RGBA8888:
+    case ZSURF_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED:
+    case ZSURF_PIXEL_FORMAT_BGRX8888:
+      return 4;
+    case ZSURF_PIXEL_FORMAT_RGB888:
+      return 3;
+    case ZSURF_PIXEL_FORMAT_RGB565:
+      return 2;
+    case ZSURF_PIXEL_FORMAT_R8:
+      return 1;
+  }
+  return 0;
+}
+
+uint32_t
+zsurf_convert_shm_bytes_per_pixel(enum wl_shm_format shm_format)
+{
+  switch (shm_format) {
+    case WL_SHM_FORMAT_ARGB8888:
+    case WL_SHM_FORMAT_XRGB8888:
+      return 4;
+    case WL_SHM_FORMAT_RGB565:
+      return 2;
+    case WL_SHM_FORMAT_R8:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+uint32_t
+zsurf_convert_shm_format_bit(enum wl_shm_format shm_format)
+{
+  switch (shm_format) {
+    case WL_SHM_FORMAT_ARGB8888:
+      return 1 << 0;
+    case WL_SHM_FORMAT_XRGB8888:
+      return 1 << 1;
+    case WL_SHM_FORMAT_RGB565:
+      return 1 << 2;
+    case WL_SHM_FORMAT_R8:
+      return 1 << 3;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * return false when no shm format has the bytes of format
+ */
+static bool
+zsurf_convert_get_shm_format(
+    enum zsurf_pixel_format format, enum wl_shm_format* shm_format)
+{
+  switch (format) {
+    case ZSURF_PIXEL_FORMAT_BGRA8888:
+      *shm_format = WL_SHM_FORMAT_ARGB8888;
+      return true;
+    case ZSURF_PIXEL_FORMAT_BGRX8888:
+      *shm_format = WL_SHM_FORMAT_XRGB8888;
+      return true;
+    case ZSURF_PIXEL_FORMAT_RGB565:
+      *shm_format = WL_SHM_FORMAT_RGB565;
+      return true;
+    case ZSURF_PIXEL_FORMAT_R8:
+      *shm_format = WL_SHM_FORMAT_R8;
+      return true;
+    default:
+      return false;
+  }
+}
+
+enum wl_shm_format
+zsurf_convert_texture_format(
+    uint32_t shm_formats, enum zsurf_pixel_format format)
+{
+  enum wl_shm_format shm_format;
+
+  if (zsurf_convert_get_shm_format(format, &shm_format) &&
+      (shm_formats & zsurf_convert_shm_format_bit(shm_format)))
+    return shm_format;
+
+  return WL_SHM_FORMAT_ARGB8888;
+}
+
+zsurf_convert_row_func_t
+zsurf_convert_get_row_func(
+    enum zsurf_pixel_format format, enum zsurf_convert_level level)
+{
+  if (zsurf_convert_bytes_per_pixel(format) == 0) return NULL;
+  if (level > zsurf_convert_get_level()) return NULL;
+
+  for (int i = level; i >= 0; i--) {
+    if (zsurf_convert_row_funcs[format][i])
+      return zsurf_convert_row_funcs[format][i];
+  }
+
+  return NULL;
+}
+
+void
+zsurf_convert_yuv_planes(uint8_t* dst, uint32_t dst_stride,
+    enum zsurf_yuv_format format, const uint8_t* const planes[3],
+    const uint32_t strides[3], uint32_t width, uint32_t height)
+{
+  uint8_t* chroma = dst + (size_t)dst_stride * height;
+
+  for (uint32_t y = 0; y < height; y++)
+    memcpy(dst + (size_t)dst_stride * y, planes[0] + (size_t)strides[0] * y,
+        width);
+
+  for (uint32_t y = 0; y < height / 2; y++, chroma += dst_stride) {
+    if (format == ZSURF_YUV_FORMAT_NV12) {
+      memcpy(chroma, planes[1] + (size_t)strides[1] * y, width);
+    } else {
+      memcpy(chroma, planes[1] + (size_t)strides[1] * y, width / 2);
+      memcpy(chroma + width / 2, planes[2] + (size_t)strides[2] * y,
+          width / 2);
+    }
+  }
+}
+
+void
+zsurf_convert_yuv(struct zsurf_color_bgra* dst, enum zsurf_yuv_format format,
+    const uint8_t* const planes[3], const uint32_t strides[3], uint32_t width,
+    uint32_t height)
+{
+  // NV12 interleaves u and v in one plane
+  uint32_t step = format == ZSURF_YUV_FORMAT_NV12 ? 2 : 1;
+
+  for (uint32_t y = 0; y < height; y++, dst += width) {
+    const uint8_t* luma = planes[0] + (size_t)strides[0] * y;
+    const uint8_t* u = planes[1] + (size_t)strides[1] * (y / 2);
+    const uint8_t* v = format == ZSURF_YUV_FORMAT_NV12
+                           ? u + 1
+                           : planes[2] + (size_t)strides[2] * (y / 2);
+
+    for (uint32_t x = 0; x < width; x++)
+      dst[x] = zsurf_convert_yuv_pixel(
+          luma[x], u[x / 2 * step], v[x / 2 * step]);
+  }
+}
+
+void
+zsurf_convert(void* dst, uint32_t dst_stride, enum wl_shm_format dst_format,
+    const void* src, enum zsurf_pixel_format format, uint32_t src_stride,
+    uint32_t width, uint32_t height)
+{
+  size_t row_size = (size_t)width * zsurf_convert_bytes_per_pixel(format);
+  enum wl_shm_format shm_format;
+  zsurf_convert_row_func_t row;
+  uint8_t* d = dst;
+  const uint8_t* s = src;
+
+  if (height == 0) return;
+
+  // the texture holds the format as is
+  if (zsurf_convert_get_shm_format(format, &shm_format) &&
+      shm_format == dst_format) {
+    if (src_stride == dst_stride) {
+      memcpy(d, s, (size_t)dst_stride * (height - 1) + row_size);
+      return;
+    }
+    for (uint32_t y = 0; y < height; y++, s += src_stride, d += dst_stride)
+      memcpy(d, s, row_size);
+    return;
+  }
+
+  row = zsurf_convert_get_row_func(format, zsurf_convert_get_level());
+
+  // packed images are one long row
+  if (src_stride == row_size && dst_stride == width * 4 &&
+      (uint64_t)width * height <= UINT32_MAX) {
+    row(d, s, width * height);
+    return;
+  }
+
+  for (uint32_t y = 0; y < height; y++, s += src_stride, d += dst_stride)
+    row(d, s, width);
+}
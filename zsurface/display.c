@@ -1,4 +1,8 @@
+#include <errno.h>
+#include <poll.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 #include <wayland-client.h>
 #include <zsurface.h>
 
@@ -7,9 +11,10 @@
 static void
 shm_format(void *data, struct wl_shm *shm, enum wl_shm_format format)
 {
-  UNUSED(data);
   UNUSED(shm);
-  UNUSED(format);
+  struct zsurf_display *surface_display = data;
+
+  surface_display->shm_formats |= zsurf_convert_shm_format_bit(format);
 }
 
 static const struct wl_shm_listener shm_listener = {
@@ -27,6 +32,19 @@ focus_toplevel_destroy_handler(struct zsurf_listener *listener, void *data)
   surface_display->focus_toplevel = NULL;
 }
 
+static void
+keyboard_focus_toplevel_destroy_handler(
+    struct zsurf_listener *listener, void *data)
+{
+  UNUSED(data);
+  struct zsurf_display *surface_display = wl_container_of(
+      listener, surface_display, keyboard_focus_toplevel_destroy_listener);
+
+  wl_list_init(
+      &surface_display->keyboard_focus_toplevel_destroy_listener.link);
+  surface_display->keyboard_focus_toplevel = NULL;
+}
+
 static void
 focus_view_destroy_handler(struct zsurf_listener *listener, void *data)
 {
@@ -38,20 +56,39 @@ focus_view_destroy_handler(struct zsurf_listener *listener, void *data)
   surface_display->focus_view = NULL;
 }
 
+static void
+record_ray(struct zsurf_display *surface_display, enum zsurf_record_type type,
+    uint32_t id, uint32_t word, struct wl_array *origin,
+    struct wl_array *direction)
+{
+  vec3 o = {0.0f, 0.0f, 0.0f}, d = {0.0f, 0.0f, 0.0f};
+
+  if (surface_display->recorder == NULL) return;
+
+  glm_vec3_from_wl_array(o, origin);
+  glm_vec3_from_wl_array(d, direction);
+
+  {
+    union zsurf_record_word payload[] = {{.u = word}, {.f = o[0]},
+        {.f = o[1]}, {.f = o[2]}, {.f = d[0]}, {.f = d[1]}, {.f = d[2]}};
+    zsurf_record(surface_display, type, id, payload, sizeof payload);
+  }
+}
+
 static void
 ray_enter(void *data, struct zgn_ray *ray, uint32_t serial,
     struct zgn_virtual_object *virtual_object, struct wl_array *origin,
     struct wl_array *direction)
 {
   UNUSED(ray);
-  UNUSED(serial);
-  UNUSED(origin);
-  UNUSED(direction);
   struct zsurf_display *surface_display = data;
   struct zsurf_toplevel *toplevel;
 
   toplevel = zgn_virtual_object_get_user_data(virtual_object);
 
+  record_ray(surface_display, ZSURF_RECORD_RAY_ENTER, toplevel->record_id,
+      serial, origin, direction);
+
   if (surface_display->focus_toplevel)
     wl_list_remove(&surface_display->focus_toplevel_destroy_listener.link);
 
@@ -59,6 +96,8 @@ ray_enter(void *data, struct zgn_ray *ray, uint32_t serial,
 
   zsurf_signal_add(&toplevel->destroy_signal,
       &surface_display->focus_toplevel_destroy_listener);
+
+  zsurf_throttle_input(surface_display, toplevel);
 }
 
 static void
@@ -66,9 +105,12 @@ ray_leave(void *data, struct zgn_ray *ray, uint32_t serial,
     struct zgn_virtual_object *virtual_object)
 {
   UNUSED(ray);
-  UNUSED(serial);
-  UNUSED(virtual_object);
   struct zsurf_display *surface_display = data;
+  struct zsurf_toplevel *toplevel =
+      virtual_object ? zgn_virtual_object_get_user_data(virtual_object) : NULL;
+
+  zsurf_record(surface_display, ZSURF_RECORD_RAY_LEAVE,
+      toplevel ? toplevel->record_id : 0, &serial, sizeof serial);
 
   if (surface_display->focus_toplevel) {
     wl_list_remove(&surface_display->focus_toplevel_destroy_listener.link);
@@ -95,16 +137,25 @@ ray_motion(void *data, struct zgn_ray *ray, uint32_t time,
   struct zsurf_view *view;
   vec3 ray_origin, ray_direction;
   vec2 local_coord;
+  uint64_t trace;
+
+  record_ray(
+      surface_display, ZSURF_RECORD_RAY_MOTION, 0, time, origin, direction);
 
   toplevel = surface_display->focus_toplevel;
   if (toplevel == NULL) return;
 
+  trace = zsurf_trace_begin();
+
   glm_vec3_from_wl_array(ray_origin, origin);
   glm_vec3_from_wl_array(ray_direction, direction);
 
   view = zsurf_toplevel_pick_view(
       toplevel, ray_origin, ray_direction, local_coord);
 
+  // moving off the views still asks the app for a new frame, e.g. to unhover
+  zsurf_toplevel_input(toplevel, time);
+
   if (surface_display->focus_view && surface_display->focus_view != view) {
     surface_display->interaface->pointer_leave(
         surface_display->user_data, surface_display->focus_view);
@@ -137,10 +188,13 @@ ray_motion(void *data, struct zgn_ray *ray, uint32_t time,
       zsurf_view_update_space_geom(surface_display->cursor.view);
       zgn_virtual_object_commit(
           surface_display->cursor.view->toplevel->virtual_object);
+      zsurf_atlas_commit(surface_display->cursor.view->toplevel);
     }
   }
 
   surface_display->focus_view = view;
+
+  zsurf_trace_end(ZSURF_TRACE_RAY_MOTION, trace, 0);
 }
 
 static void
@@ -149,13 +203,22 @@ ray_button(void *data, struct zgn_ray *ray, uint32_t serial, uint32_t time,
 {
   UNUSED(ray);
   struct zsurf_display *surface_display = data;
+  uint32_t payload[] = {serial, time, button, state};
+  uint64_t trace = zsurf_trace_begin();
 
-  if (surface_display->focus_view)
+  zsurf_record(surface_display, ZSURF_RECORD_RAY_BUTTON, 0, payload,
+      sizeof payload);
+
+  if (surface_display->focus_view) {
+    zsurf_toplevel_input(surface_display->focus_view->toplevel, time);
     surface_display->interaface->pointer_button(
         surface_display->user_data, serial, time, button, state);
+  }
+
+  zsurf_trace_end(ZSURF_TRACE_RAY_BUTTON, trace, button);
 }
 
-static const struct zgn_ray_listener ray_listener = {
+const struct zgn_ray_listener zsurf_display_ray_listener = {
     .enter = ray_enter,
     .leave = ray_leave,
     .motion = ray_motion,
@@ -168,12 +231,37 @@ keyboard_keymap(void *data, struct zgn_keyboard *keyboard, uint32_t format,
 {
   UNUSED(keyboard);
   struct zsurf_display *surface_display = data;
+  struct zsurf_keymap *keymap;
 
   // TODO: Handle the case wayland keymap format enum and zigen keymap format
   // enum are not same.
 
+  keymap = zsurf_keymap_cache_get(surface_display, format, fd, size);
+  if (keymap == NULL) {
+    zsurf_log_error("zsurface: failed to map keymap\n");
+    return;
+  }
+
+  if (keymap == surface_display->keymap) return;
+
+  surface_display->keymap = keymap;
   surface_display->interaface->keyboard_keymap(
-      surface_display->user_data, format, fd, size);
+      surface_display->user_data, keymap);
+}
+
+static void
+keyboard_focus_toplevel_set(
+    struct zsurf_display *surface_display, struct zsurf_toplevel *toplevel)
+{
+  wl_list_remove(
+      &surface_display->keyboard_focus_toplevel_destroy_listener.link);
+  wl_list_init(
+      &surface_display->keyboard_focus_toplevel_destroy_listener.link);
+
+  surface_display->keyboard_focus_toplevel = toplevel;
+  if (toplevel)
+    zsurf_signal_add(&toplevel->destroy_signal,
+        &surface_display->keyboard_focus_toplevel_destroy_listener);
 }
 
 static void
@@ -187,6 +275,17 @@ keyboard_enter(void *data, struct zgn_keyboard *keyboard, uint32_t serial,
 
   toplevel = zgn_virtual_object_get_user_data(virtual_object);
 
+  if (surface_display->recorder) {
+    uint32_t payload[1 + ZSURF_RECORD_MAX_KEYS] = {serial};
+    uint32_t count = key_count < ZSURF_RECORD_MAX_KEYS ? key_count
+                                                       : ZSURF_RECORD_MAX_KEYS;
+    memcpy(&payload[1], keys->data, count * sizeof(uint32_t));
+    zsurf_record(surface_display, ZSURF_RECORD_KEYBOARD_ENTER,
+        toplevel->record_id, payload, (1 + count) * sizeof(uint32_t));
+  }
+
+  keyboard_focus_toplevel_set(surface_display, toplevel);
+
   // FIXME: use zsurf_display.focus_view instead of toplevel->view if
   // focus_view.toplevel == toplevel. we need to keep keyboard focus view then.
   surface_display->interaface->keyboard_enter(surface_display->user_data,
@@ -203,6 +302,12 @@ keyboard_leave(void *data, struct zgn_keyboard *keyboard, uint32_t serial,
 
   toplevel = zgn_virtual_object_get_user_data(virtual_object);
 
+  zsurf_record(surface_display, ZSURF_RECORD_KEYBOARD_LEAVE,
+      toplevel->record_id, &serial, sizeof serial);
+
+  zsurf_key_repeat_stop(&surface_display->key_repeat);
+  keyboard_focus_toplevel_set(surface_display, NULL);
+
   surface_display->interaface->keyboard_leave(
       surface_display->user_data, serial, toplevel->view);
 }
@@ -213,9 +318,24 @@ keyboard_key(void *data, struct zgn_keyboard *keyboard, uint32_t serial,
 {
   UNUSED(keyboard);
   struct zsurf_display *surface_display = data;
+  uint32_t payload[] = {serial, time, key, state};
+  uint64_t trace = zsurf_trace_begin();
+
+  zsurf_record(surface_display, ZSURF_RECORD_KEYBOARD_KEY, 0, payload,
+      sizeof payload);
+
+  if (surface_display->keyboard_focus_toplevel)
+    zsurf_toplevel_input(surface_display->keyboard_focus_toplevel, time);
 
   surface_display->interaface->keyboard_key(
       surface_display->user_data, serial, time, key, state);
+
+  if (state == ZSURF_KEYBOARD_KEY_STATE_RELEASED ||
+      zsurf_keymap_key_repeats(surface_display->keymap, key))
+    zsurf_key_repeat_key(
+        &surface_display->key_repeat, serial, time, key, state);
+
+  zsurf_trace_end(ZSURF_TRACE_KEY, trace, key);
 }
 
 static void
@@ -225,12 +345,17 @@ keyboard_modifiers(void *data, struct zgn_keyboard *keyboard, uint32_t serial,
 {
   UNUSED(keyboard);
   struct zsurf_display *surface_display = data;
+  uint32_t payload[] = {
+      serial, mods_depressed, mods_latched, mods_locked, group};
+
+  zsurf_record(surface_display, ZSURF_RECORD_KEYBOARD_MODIFIERS, 0, payload,
+      sizeof payload);
 
   surface_display->interaface->keyboard_modifiers(surface_display->user_data,
       serial, mods_depressed, mods_latched, mods_locked, group);
 }
 
-static const struct zgn_keyboard_listener keyboard_listener = {
+const struct zgn_keyboard_listener zsurf_display_keyboard_listener = {
     .keymap = keyboard_keymap,
     .enter = keyboard_enter,
     .leave = keyboard_leave,
@@ -247,7 +372,7 @@ seat_capabilities(void *data, struct zgn_seat *seat, uint32_t capabilities)
     if (surface_display->ray == NULL) {
       surface_display->ray = zgn_seat_get_ray(seat);
       zgn_ray_add_listener(
-          surface_display->ray, &ray_listener, surface_display);
+          surface_display->ray, &zsurf_display_ray_listener, surface_display);
     }
   } else {
     if (surface_display->ray) {
@@ -278,13 +403,15 @@ seat_capabilities(void *data, struct zgn_seat *seat, uint32_t capabilities)
   if (capabilities & ZGN_SEAT_CAPABILITY_KEYBOARD) {
     if (surface_display->keyboard == NULL) {
       surface_display->keyboard = zgn_seat_get_keyboard(seat);
-      zgn_keyboard_add_listener(
-          surface_display->keyboard, &keyboard_listener, surface_display);
+      zgn_keyboard_add_listener(surface_display->keyboard,
+          &zsurf_display_keyboard_listener, surface_display);
     }
   } else {
     if (surface_display->keyboard) {
       zgn_keyboard_destroy(surface_display->keyboard);
       surface_display->keyboard = NULL;
+      zsurf_key_repeat_stop(&surface_display->key_repeat);
+      keyboard_focus_toplevel_set(surface_display, NULL);
     }
   }
 
@@ -342,6 +469,12 @@ zsurf_display_set_cursor(struct zsurf_display *surface_display,
     struct zsurf_color_bgra *data, uint32_t width, uint32_t height,
     int32_t hotspot_x, int32_t hotspot_y)
 {
+  uint32_t payload[] = {data ? width : 0, data ? height : 0,
+      (uint32_t)hotspot_x, (uint32_t)hotspot_y};
+
+  zsurf_record(surface_display, ZSURF_RECORD_SET_CURSOR, 0, payload,
+      sizeof payload);
+
   if (!surface_display->cursor.view) {
     if (!surface_display->focus_view) return;
     surface_display->cursor.view = zsurf_view_create(surface_display,
@@ -367,8 +500,37 @@ zsurf_display_set_cursor(struct zsurf_display *surface_display,
   zsurf_view_commit(surface_display->cursor.view);
 }
 
-WL_EXPORT struct zsurf_display *
-zsurf_display_create(const char *socket,
+static void
+startup_done(void *data, struct wl_callback *callback, uint32_t callback_data)
+{
+  UNUSED(callback_data);
+  struct zsurf_display *surface_display = data;
+  bool success;
+
+  wl_callback_destroy(callback);
+  surface_display->startup.callback = NULL;
+  surface_display->startup.done = true;
+
+  // globals are announced before the compositor answers the sync request
+  surface_display->ready =
+      surface_display->compositor && surface_display->seat &&
+      surface_display->shell && surface_display->shm && surface_display->opengl;
+
+  success = surface_display->ready;
+  if (surface_display->ready &&
+      zsurf_toplevel_bind_queued(surface_display) != 0)
+    success = false;
+
+  if (surface_display->startup.async && surface_display->interaface->ready)
+    surface_display->interaface->ready(surface_display->user_data, success);
+}
+
+static const struct wl_callback_listener startup_listener = {
+    .done = startup_done,
+};
+
+static struct zsurf_display *
+zsurf_display_connect(const char *socket,
     const struct zsurf_display_interface *interface, void *user_data)
 {
   struct zsurf_display *surface_display;
@@ -382,6 +544,28 @@ zsurf_display_create(const char *socket,
   surface_display->display = wl_display_connect(socket);
   if (surface_display->display == NULL) goto err_display;
 
+  surface_display->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (surface_display->epoll_fd < 0) goto err_epoll;
+
+  if (zsurf_key_repeat_init(&surface_display->key_repeat) != 0)
+    goto err_key_repeat;
+
+  if (zsurf_throttle_init(&surface_display->throttle) != 0)
+    goto err_throttle;
+
+  {
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    if (epoll_ctl(surface_display->epoll_fd, EPOLL_CTL_ADD,
+            wl_display_get_fd(surface_display->display), &event) != 0 ||
+        epoll_ctl(surface_display->epoll_fd, EPOLL_CTL_ADD,
+            surface_display->key_repeat.fd, &event) != 0 ||
+        epoll_ctl(surface_display->epoll_fd, EPOLL_CTL_ADD,
+            surface_display->throttle.fd, &event) != 0)
+      goto err_epoll_ctl;
+  }
+  surface_display->watch_writable = false;
+
   surface_display->registry = wl_display_get_registry(surface_display->display);
   if (surface_display->registry == NULL) goto err_registry;
 
@@ -397,21 +581,74 @@ zsurf_display_create(const char *socket,
       focus_view_destroy_handler;
   wl_list_init(&surface_display->focus_view_destroy_listener.link);
 
+  surface_display->keyboard_focus_toplevel = NULL;
+  surface_display->keyboard_focus_toplevel_destroy_listener.notify =
+      keyboard_focus_toplevel_destroy_handler;
+  wl_list_init(
+      &surface_display->keyboard_focus_toplevel_destroy_listener.link);
+
+  surface_display->group = NULL;
+  wl_list_init(&surface_display->group_link);
+  wl_list_init(&surface_display->group_state.pending_link);
+
+  wl_list_init(&surface_display->frame_callback_pool);
+
+  // every wl_shm supports these, the rest come with format events
+  surface_display->shm_formats =
+      zsurf_convert_shm_format_bit(WL_SHM_FORMAT_ARGB8888) |
+      zsurf_convert_shm_format_bit(WL_SHM_FORMAT_XRGB8888);
+
+  wl_list_init(&surface_display->memory.view_list);
+
+  wl_list_init(&surface_display->view_pool.list);
+  surface_display->view_pool.count = 0;
+  surface_display->view_pool.size = 0;
+
+  zsurf_atlas_init(&surface_display->atlas);
+
+  surface_display->xkb_context = NULL;
+  wl_list_init(&surface_display->keymap_cache);
+  surface_display->keymap = NULL;
+  surface_display->keymap_generation = 0;
+
   wl_registry_add_listener(
       surface_display->registry, &registry_listener, surface_display);
 
-  wl_display_roundtrip(surface_display->display);
+  surface_display->ready = false;
+  surface_display->startup.done = false;
+  surface_display->startup.async = false;
+  wl_list_init(&surface_display->startup.toplevel_list);
+  surface_display->startup.callback =
+      wl_display_sync(surface_display->display);
+  wl_callback_add_listener(
+      surface_display->startup.callback, &startup_listener, surface_display);
 
-  if (!(surface_display->compositor && surface_display->seat &&
-          surface_display->shell && surface_display->shm &&
-          surface_display->opengl)) {
-    goto err_globals;
-  }
+  if (wl_display_flush(surface_display->display) == -1 && errno != EAGAIN)
+    goto err_flush;
+
+  // built while the compositor is answering the registry
+  if (zsurf_view_init_shader_sources(surface_display) != 0)
+    goto err_shader_sources;
+
+  zsurf_record_init_from_env(surface_display);
 
   return surface_display;
 
-err_globals:
+err_shader_sources:
+err_flush:
+  wl_callback_destroy(surface_display->startup.callback);
+
 err_registry:
+err_epoll_ctl:
+  zsurf_throttle_fini(surface_display);
+
+err_throttle:
+  zsurf_key_repeat_fini(&surface_display->key_repeat);
+
+err_key_repeat:
+  close(surface_display->epoll_fd);
+
+err_epoll:
   wl_display_disconnect(surface_display->display);
 
 err_display:
@@ -421,15 +658,78 @@ err:
   return NULL;
 }
 
+WL_EXPORT struct zsurf_display *
+zsurf_display_create(const char *socket,
+    const struct zsurf_display_interface *interface, void *user_data)
+{
+  struct zsurf_display *surface_display;
+
+  surface_display = zsurf_display_connect(socket, interface, user_data);
+  if (surface_display == NULL) return NULL;
+
+  while (!surface_display->startup.done) {
+    if (zsurf_display_dispatch(surface_display) == -1) break;
+  }
+
+  if (!surface_display->ready) {
+    zsurf_display_destroy(surface_display);
+    return NULL;
+  }
+
+  return surface_display;
+}
+
+WL_EXPORT struct zsurf_display *
+zsurf_display_create_async(const char *socket,
+    const struct zsurf_display_interface *interface, void *user_data)
+{
+  struct zsurf_display *surface_display;
+
+  surface_display = zsurf_display_connect(socket, interface, user_data);
+  if (surface_display == NULL) return NULL;
+
+  surface_display->startup.async = true;
+
+  return surface_display;
+}
+
 WL_EXPORT void
 zsurf_display_destroy(struct zsurf_display *surface_display)
 {
+  struct zsurf_toplevel *toplevel, *tmp;
+
+  // toplevels still queued are left for zsurf_toplevel_destroy to free
+  wl_list_for_each_safe(
+      toplevel, tmp, &surface_display->startup.toplevel_list, queue_link)
+  {
+    wl_list_remove(&toplevel->queue_link);
+    wl_list_init(&toplevel->queue_link);
+    toplevel->surface_display = NULL;
+  }
+
+  if (surface_display->group)
+    zsurf_display_group_remove(surface_display->group, surface_display);
+  surface_display->view_pool.size = 0;
   if (surface_display->cursor.view)
     zsurf_view_destroy(surface_display->cursor.view);
+  zsurf_view_pool_trim(surface_display);
+  zsurf_atlas_fini(surface_display);
   wl_list_remove(&surface_display->focus_toplevel_destroy_listener.link);
   wl_list_remove(&surface_display->focus_view_destroy_listener.link);
+  wl_list_remove(
+      &surface_display->keyboard_focus_toplevel_destroy_listener.link);
+  if (surface_display->startup.callback)
+    wl_callback_destroy(surface_display->startup.callback);
+  zsurf_display_record_stop(surface_display);
+  zsurf_view_fini_shader_sources(surface_display);
+  zsurf_throttle_fini(surface_display);
+  zsurf_view_frame_callback_pool_fini(surface_display);
+  zsurf_keymap_cache_fini(surface_display);
+  zsurf_key_repeat_fini(&surface_display->key_repeat);
+  close(surface_display->epoll_fd);
   wl_display_disconnect(surface_display->display);
   free(surface_display);
+  zsurf_log_flush();
 }
 
 WL_EXPORT int
@@ -441,6 +741,9 @@ zsurf_display_prepare_read(struct zsurf_display *surface_display)
 WL_EXPORT int
 zsurf_display_dispatch_pending(struct zsurf_display *surface_display)
 {
+  zsurf_key_repeat_dispatch(&surface_display->key_repeat, surface_display);
+  zsurf_throttle_dispatch(surface_display);
+
   return wl_display_dispatch_pending(surface_display->display);
 }
 
@@ -465,11 +768,83 @@ zsurf_display_read_events(struct zsurf_display *surface_display)
 WL_EXPORT int
 zsurf_display_get_fd(struct zsurf_display *surface_display)
 {
-  return wl_display_get_fd(surface_display->display);
+  return surface_display->epoll_fd;
+}
+
+void
+zsurf_display_watch_writable(
+    struct zsurf_display *surface_display, bool writable)
+{
+  struct epoll_event event = {0};
+
+  if (surface_display->watch_writable == writable) return;
+
+  event.events = EPOLLIN;
+  if (writable) event.events |= EPOLLOUT;
+  if (epoll_ctl(surface_display->epoll_fd, EPOLL_CTL_MOD,
+          wl_display_get_fd(surface_display->display), &event) == 0)
+    surface_display->watch_writable = writable;
 }
 
 WL_EXPORT int
 zsurf_display_dispatch(struct zsurf_display *surface_display)
 {
-  return wl_display_dispatch(surface_display->display);
+  struct wl_display *display = surface_display->display;
+  struct pollfd pfd;
+  int ret;
+
+  if (wl_display_prepare_read(display) == -1)
+    return zsurf_display_dispatch_pending(surface_display);
+
+  // nothing is queued, spend the idle time on the view pool
+  if (surface_display->ready) zsurf_view_pool_fill(surface_display, 1);
+
+  ret = wl_display_flush(display);
+  if (ret == -1 && errno != EAGAIN) {
+    wl_display_cancel_read(display);
+    return -1;
+  }
+  zsurf_display_watch_writable(surface_display, ret == -1);
+
+  // hand buffered log messages over before we may sleep
+  zsurf_log_flush();
+
+  pfd.fd = surface_display->epoll_fd;
+  pfd.events = POLLIN;
+  do {
+    ret = poll(&pfd, 1, -1);
+  } while (ret == -1 && errno == EINTR);
+
+  if (ret == -1) {
+    wl_display_cancel_read(display);
+    return -1;
+  }
+
+  // read_events returns 0 when only a timer or writability woke us up
+  if (wl_display_read_events(display) == -1) return -1;
+
+  return zsurf_display_dispatch_pending(surface_display);
+}
+
+WL_EXPORT void
+zsurf_display_set_view_pool_size(
+    struct zsurf_display *surface_display, uint32_t size)
+{
+  surface_display->view_pool.size = size;
+  zsurf_view_pool_trim(surface_display);
+}
+
+WL_EXPORT int
+zsurf_display_fill_view_pool(struct zsurf_display *surface_display)
+{
+  if (!surface_display->ready) return -1;
+
+  return zsurf_view_pool_fill(surface_display, UINT32_MAX);
+}
+
+WL_EXPORT void
+zsurf_display_get_stats(
+    struct zsurf_display *surface_display, struct zsurf_display_stats *stats)
+{
+  *stats = surface_display->stats;
 }
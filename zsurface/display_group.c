@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define ZSURF_DISPLAY_GROUP_MAX_EVENTS 64
+
+struct zsurf_display_group {
+  int epoll_fd;
+  struct wl_list display_list;  // zsurf_display.group_link, dispatch order
+};
+
+/**
+ * error is the errno the failed call left, the protocol error takes over
+ */
+static void
+zsurf_display_group_drop(struct zsurf_display_group* group,
+    struct zsurf_display* surface_display, int error)
+{
+  int display_error = wl_display_get_error(surface_display->display);
+
+  surface_display->stats.error =
+      display_error ? display_error : error ? error : EPIPE;
+  epoll_ctl(group->epoll_fd, EPOLL_CTL_DEL,
+      zsurf_display_get_fd(surface_display), NULL);
+  zsurf_log_error("zsurface: display dropped from group (%s)\n",
+      strerror(surface_display->stats.error));
+}
+
+static void
+zsurf_display_group_prepare(
+    struct zsurf_display_group* group, struct zsurf_display* surface_display)
+{
+  struct wl_display* display = surface_display->display;
+  bool want_write;
+
+  while (wl_display_prepare_read(display) != 0) {
+    if (wl_display_dispatch_pending(display) == -1) {
+      zsurf_display_group_drop(group, surface_display, errno);
+      return;
+    }
+  }
+
+  surface_display->group_state.prepared = true;
+
+  if (surface_display->ready) zsurf_view_pool_fill(surface_display, 1);
+
+  want_write = false;
+  if (wl_display_flush(display) == -1) {
+    int error = errno;
+    if (error != EAGAIN) {
+      wl_display_cancel_read(display);
+      surface_display->group_state.prepared = false;
+      zsurf_display_group_drop(group, surface_display, error);
+      return;
+    }
+    want_write = true;
+  }
+
+  zsurf_display_watch_writable(surface_display, want_write);
+}
+
+static void
+zsurf_display_group_dispatch_display(
+    struct zsurf_display_group* group, struct zsurf_display* surface_display)
+{
+  struct zsurf_display_stats* stats = &surface_display->stats;
+  uint64_t start, elapsed;
+  int count, error;
+
+  start = zsurf_get_time_ns();
+  count = zsurf_display_dispatch_pending(surface_display);
+  error = errno;
+  elapsed = zsurf_get_time_ns() - start;
+
+  if (count == -1) {
+    zsurf_display_group_drop(group, surface_display, error);
+    return;
+  }
+
+  stats->dispatches++;
+  stats->events += count;
+  stats->dispatch_time_ns += elapsed;
+  if (elapsed > stats->max_dispatch_time_ns)
+    stats->max_dispatch_time_ns = elapsed;
+}
+
+/**
+ * Queue the members to visit on the pending list before any user callback
+ * runs. A member destroyed by a callback leaves the list on its own, the
+ * caller pops one at a time with zsurf_display_group_next.
+ */
+static void
+zsurf_display_group_take(
+    struct zsurf_display_group* group, struct wl_list* pending)
+{
+  struct zsurf_display* surface_display;
+
+  wl_list_init(pending);
+  wl_list_for_each(surface_display, &group->display_list, group_link)
+      wl_list_insert(pending->prev, &surface_display->group_state.pending_link);
+}
+
+static struct zsurf_display*
+zsurf_display_group_next(struct wl_list* pending)
+{
+  struct zsurf_display* surface_display;
+
+  if (wl_list_empty(pending)) return NULL;
+
+  surface_display = wl_container_of(
+      pending->next, surface_display, group_state.pending_link);
+  wl_list_remove(&surface_display->group_state.pending_link);
+  wl_list_init(&surface_display->group_state.pending_link);
+
+  return surface_display;
+}
+
+WL_EXPORT int
+zsurf_display_group_dispatch(struct zsurf_display_group* group, int timeout)
+{
+  struct epoll_event events[ZSURF_DISPLAY_GROUP_MAX_EVENTS];
+  struct zsurf_display *surface_display, *first;
+  struct wl_list pending;
+  int count, error, dispatched = 0;
+
+  // preparing dispatches what is queued, callbacks may destroy members
+  zsurf_display_group_take(group, &pending);
+  while ((surface_display = zsurf_display_group_next(&pending))) {
+    if (surface_display->stats.error) continue;
+    zsurf_display_group_prepare(group, surface_display);
+  }
+
+  zsurf_log_flush();
+
+  count = epoll_wait(
+      group->epoll_fd, events, ZSURF_DISPLAY_GROUP_MAX_EVENTS, timeout);
+  error = errno;
+
+  for (int i = 0; i < count; i++) {
+    surface_display = events[i].data.ptr;
+    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+      surface_display->group_state.readable = true;
+  }
+
+  wl_list_for_each(surface_display, &group->display_list, group_link)
+  {
+    if (!surface_display->group_state.prepared) continue;
+    surface_display->group_state.prepared = false;
+
+    if (!surface_display->group_state.readable) {
+      wl_display_cancel_read(surface_display->display);
+      continue;
+    }
+
+    surface_display->stats.wakeups++;
+    if (wl_display_read_events(surface_display->display) == -1) {
+      surface_display->group_state.readable = false;
+      zsurf_display_group_drop(group, surface_display, errno);
+    }
+  }
+
+  if (count == -1) {
+    errno = error;
+    return -1;
+  }
+
+  zsurf_display_group_take(group, &pending);
+  while ((surface_display = zsurf_display_group_next(&pending))) {
+    if (!surface_display->group_state.readable) continue;
+    surface_display->group_state.readable = false;
+    zsurf_display_group_dispatch_display(group, surface_display);
+    dispatched++;
+  }
+
+  // rotate so that a different member is dispatched first next time
+  if (!wl_list_empty(&group->display_list)) {
+    first = wl_container_of(group->display_list.next, first, group_link);
+    wl_list_remove(&first->group_link);
+    wl_list_insert(group->display_list.prev, &first->group_link);
+  }
+
+  return dispatched;
+}
+
+WL_EXPORT int
+zsurf_display_group_get_fd(struct zsurf_display_group* group)
+{
+  return group->epoll_fd;
+}
+
+WL_EXPORT int
+zsurf_display_group_add(
+    struct zsurf_display_group* group, struct zsurf_display* surface_display)
+{
+  struct epoll_event event = {0};
+
+  if (surface_display->group) return -1;
+
+  event.events = EPOLLIN;
+  event.data.ptr = surface_display;
+  if (epoll_ctl(group->epoll_fd, EPOLL_CTL_ADD,
+          zsurf_display_get_fd(surface_display), &event) == -1)
+    return -1;
+
+  surface_display->group = group;
+  surface_display->group_state.prepared = false;
+  surface_display->group_state.readable = false;
+  memset(&surface_display->stats, 0, sizeof surface_display->stats);
+  wl_list_insert(group->display_list.prev, &surface_display->group_link);
+
+  return 0;
+}
+
+WL_EXPORT void
+zsurf_display_group_remove(
+    struct zsurf_display_group* group, struct zsurf_display* surface_display)
+{
+  if (surface_display->group != group) return;
+
+  if (!surface_display->stats.error)
+    epoll_ctl(group->epoll_fd, EPOLL_CTL_DEL,
+        zsurf_display_get_fd(surface_display), NULL);
+
+  wl_list_remove(&surface_display->group_link);
+  wl_list_init(&surface_display->group_link);
+  wl_list_remove(&surface_display->group_state.pending_link);
+  wl_list_init(&surface_display->group_state.pending_link);
+  surface_display->group = NULL;
+}
+
+WL_EXPORT struct zsurf_display_group*
+zsurf_display_group_create(void)
+{
+  struct zsurf_display_group* group;
+
+  group = zalloc(sizeof *group);
+  if (group == NULL) goto err;
+
+  group->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (group->epoll_fd < 0) goto err_epoll;
+
+  wl_list_init(&group->display_list);
+
+  return group;
+
+err_epoll:
+  free(group);
+
+err:
+  return NULL;
+}
+
+WL_EXPORT void
+zsurf_display_group_destroy(struct zsurf_display_group* group)
+{
+  struct zsurf_display *surface_display, *tmp;
+
+  wl_list_for_each_safe(
+      surface_display, tmp, &group->display_list, group_link)
+      zsurf_display_group_remove(group, surface_display);
+
+  close(group->epoll_fd);
+  free(group);
+}
@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <wayland-client.h>
 #include <zigen-client-protocol.h>
 #include <zigen-opengl-client-protocol.h>
@@ -25,7 +26,40 @@ struct zsurf_signal {
   struct wl_list listener_list;
 };
 
-void zsurf_log(const char* fmt, ...);
+#ifndef ZSURF_LOG_MAX_LEVEL
+#define ZSURF_LOG_MAX_LEVEL ZSURF_LOG_LEVEL_DEBUG
+#endif
+
+// per call site state of the rate limit
+struct zsurf_log_site {
+  uint64_t window;  // second of CLOCK_MONOTONIC
+  uint32_t count;   // messages in the window
+  uint32_t suppressed;
+};
+
+extern int zsurf_log_current_level;
+
+void zsurf_log_write(struct zsurf_log_site* site, enum zsurf_log_level level,
+    const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * Levels above ZSURF_LOG_MAX_LEVEL are compiled out, the others are checked
+ * against the runtime level before formatting. Each call site is limited to
+ * a few messages per second.
+ */
+#define zsurf_log_at(level, ...)                                     \
+  do {                                                               \
+    static struct zsurf_log_site zsurf_log_site_;                    \
+    if ((level) <= ZSURF_LOG_MAX_LEVEL &&                            \
+        (int)(level) <= __atomic_load_n(                             \
+                            &zsurf_log_current_level, __ATOMIC_RELAXED)) \
+      zsurf_log_write(&zsurf_log_site_, (level), __VA_ARGS__);       \
+  } while (0)
+
+#define zsurf_log_error(...) zsurf_log_at(ZSURF_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define zsurf_log_warn(...) zsurf_log_at(ZSURF_LOG_LEVEL_WARN, __VA_ARGS__)
+#define zsurf_log_info(...) zsurf_log_at(ZSURF_LOG_LEVEL_INFO, __VA_ARGS__)
+#define zsurf_log_debug(...) zsurf_log_at(ZSURF_LOG_LEVEL_DEBUG, __VA_ARGS__)
 
 static inline void
 zsurf_signal_init(struct zsurf_signal* signal)
@@ -57,15 +91,15 @@ glm_vec3_from_wl_array(vec3 v, struct wl_array* array)
   return 0;
 }
 
+/**
+ * the array borrows v for marshalling, do not release or grow it
+ */
 static inline void
-glm_vec3_to_wl_array(vec3 v, struct wl_array* array)
+glm_vec3_as_wl_array(vec3 v, struct wl_array* array)
 {
-  if (array->alloc > 0) {
-    wl_array_release(array);
-    wl_array_init(array);
-  }
-  float* data = wl_array_add(array, sizeof(vec3));
-  memcpy(data, v, sizeof(vec3));
+  array->size = sizeof(vec3);
+  array->alloc = 0;
+  array->data = v;
 }
 
 static inline int
@@ -78,26 +112,26 @@ glm_versor_from_wl_array(versor v, struct wl_array* array)
   return 0;
 }
 
+/**
+ * the array borrows v for marshalling, do not release or grow it
+ */
 static inline void
-glm_versor_to_wl_array(versor v, struct wl_array* array)
+glm_versor_as_wl_array(versor v, struct wl_array* array)
 {
-  if (array->alloc > 0) {
-    wl_array_release(array);
-    wl_array_init(array);
-  }
-  float* data = wl_array_add(array, sizeof(versor));
-  memcpy(data, v, sizeof(versor));
+  array->size = sizeof(versor);
+  array->alloc = 0;
+  array->data = v;
 }
 
+/**
+ * the array borrows m for marshalling, do not release or grow it
+ */
 static inline void
-glm_mat4_to_wl_array(mat4 m, struct wl_array* array)
+glm_mat4_as_wl_array(mat4 m, struct wl_array* array)
 {
-  if (array->alloc > 0) {
-    wl_array_release(array);
-    wl_array_init(array);
-  }
-  float* data = wl_array_add(array, sizeof(mat4));
-  memcpy(data, m, sizeof(mat4));
+  array->size = sizeof(mat4);
+  array->alloc = 0;
+  array->data = m;
 }
 
 static inline int
@@ -117,6 +151,82 @@ zalloc(size_t size)
   return calloc(1, size);
 }
 
+/**
+ * a sealable memfd of the given size, return -1 when failed
+ */
+int zsurf_create_shared_fd(off_t size);
+
+enum zsurf_convert_level {
+  ZSURF_CONVERT_LEVEL_SCALAR = 0,
+  ZSURF_CONVERT_LEVEL_SSE2,
+  ZSURF_CONVERT_LEVEL_AVX2,
+  ZSURF_CONVERT_LEVEL_COUNT,
+};
+
+typedef void (*zsurf_convert_row_func_t)(
+    void* dst, const void* src, uint32_t width);
+
+/**
+ * the best level the cpu supports, detected on the first call
+ */
+enum zsurf_convert_level zsurf_convert_get_level(void);
+
+/**
+ * return 0 for an unknown format
+ */
+uint32_t zsurf_convert_bytes_per_pixel(enum zsurf_pixel_format format);
+
+/**
+ * return the kernel converting a row of format into bgra at level, or at the
+ * best level below it that has one. return NULL when the format is unknown or
+ * the cpu does not support level.
+ */
+zsurf_convert_row_func_t zsurf_convert_get_row_func(
+    enum zsurf_pixel_format format, enum zsurf_convert_level level);
+
+/**
+ * return 0 for a format zsurface does not use
+ */
+uint32_t zsurf_convert_shm_bytes_per_pixel(enum wl_shm_format shm_format);
+
+/**
+ * return the bit of zsurf_display.shm_formats for shm_format, 0 for a format
+ * zsurface does not use
+ */
+uint32_t zsurf_convert_shm_format_bit(enum wl_shm_format shm_format);
+
+/**
+ * the texture format holding data of format with the fewest bytes, among the
+ * ones in shm_formats
+ */
+enum wl_shm_format zsurf_convert_texture_format(
+    uint32_t shm_formats, enum zsurf_pixel_format format);
+
+/**
+ * Lay the planes out in an R8 texture of width and height * 3 / 2 rows for
+ * the yuv shaders: the luma plane, then the chroma rows, NV12 interleaved as
+ * they come, I420 u and v side by side. width and height are even.
+ */
+void zsurf_convert_yuv_planes(uint8_t* dst, uint32_t dst_stride,
+    enum zsurf_yuv_format format, const uint8_t* const planes[3],
+    const uint32_t strides[3], uint32_t width, uint32_t height);
+
+/**
+ * convert on the cpu, for compositors without R8. dst is tightly packed
+ */
+void zsurf_convert_yuv(struct zsurf_color_bgra* dst,
+    enum zsurf_yuv_format format, const uint8_t* const planes[3],
+    const uint32_t strides[3], uint32_t width, uint32_t height);
+
+/**
+ * format must be known. dst_format is the one zsurf_convert_texture_format
+ * gave for format, or WL_SHM_FORMAT_ARGB8888.
+ */
+void zsurf_convert(void* dst, uint32_t dst_stride,
+    enum wl_shm_format dst_format, const void* src,
+    enum zsurf_pixel_format format, uint32_t src_stride, uint32_t width,
+    uint32_t height);
+
 struct vertex {
   vec3 p;
   vec2 uv;
@@ -137,6 +247,135 @@ enum zsurf_view_state {
   ZSURF_VIEW_STATE_TEXTURE_COMMITTED = 3,
 };
 
+enum zsurf_view_shader {
+  ZSURF_VIEW_SHADER_RGBA = 0,
+  ZSURF_VIEW_SHADER_OPAQUE,  // alpha of the texture is ignored
+  ZSURF_VIEW_SHADER_GRAY,    // single channel texture
+  ZSURF_VIEW_SHADER_NV12,    // zsurf_convert_yuv_planes layouts in R8
+  ZSURF_VIEW_SHADER_I420,
+  ZSURF_VIEW_SHADER_LAYERS,  // layers stacked top to bottom, blended in order
+  ZSURF_VIEW_SHADER_COUNT,
+};
+
+struct zsurf_view_color_transform {
+  vec4 multiply;
+  vec4 add;
+  float opacity;
+};
+
+extern const struct zsurf_view_color_transform
+    zsurf_view_color_transform_identity;
+
+/**
+ * uniforms are 0 until set, every program gets the color transform
+ */
+struct zgn_opengl_shader_program* zsurf_view_create_shader(
+    struct zsurf_display* surface_display, enum zsurf_view_shader shader_kind,
+    mat4 rotate, struct zsurf_view_color_transform* color_transform,
+    uint32_t layer_count);
+
+#define ZSURF_ATLAS_PAGE_SIZE 1024  // px, pages are square
+#define ZSURF_ATLAS_PADDING 1       // px right and below every entry
+
+struct zsurf_atlas_segment {
+  uint32_t x;
+  uint32_t y;  // top of the packed area
+  uint32_t width;
+};
+
+struct zsurf_atlas_page {
+  struct zsurf_display* surface_display;
+  struct wl_list link;        // zsurf_atlas.page_list or retired_list
+  struct wl_list entry_list;  // zsurf_atlas_entry.link
+  struct wl_list hold_list;   // zsurf_atlas_entry.hold_link, when retired
+
+  int fd;
+  void* data;
+  struct wl_shm_pool* pool;
+  struct wl_buffer* buffer;
+  struct zgn_opengl_texture* texture;
+
+  struct zsurf_atlas_segment skyline[ZSURF_ATLAS_PAGE_SIZE];  // left to right
+  uint32_t segment_count;
+  uint64_t used_area;  // of the entries with their padding
+};
+
+struct zsurf_atlas_entry;
+
+typedef void (*zsurf_atlas_moved_func_t)(struct zsurf_atlas_entry* entry);
+
+struct zsurf_atlas_entry {
+  struct zsurf_atlas_page* page;  // null if not in the atlas
+  struct wl_list link;            // zsurf_atlas_page.entry_list
+  zsurf_atlas_moved_func_t moved;  // called when defragmenting moved it
+  uint32_t x, y, width, height;
+
+  struct zsurf_toplevel* toplevel;  // whose commit shows where it moved
+  struct zsurf_atlas_page* held;    // retired page still shown, nullable
+  struct wl_list hold_link;         // zsurf_atlas_page.hold_list
+};
+
+struct zsurf_atlas {
+  struct wl_list page_list;     // zsurf_atlas_page.link
+  struct wl_list retired_list;  // repacked pages the compositor may still show
+  uint32_t page_count;
+};
+
+/**
+ * a page of its own, not in the display's atlas
+ * return NULL when failed to create its shared memory
+ */
+struct zsurf_atlas_page* zsurf_atlas_page_create(
+    struct zsurf_display* surface_display);
+
+void zsurf_atlas_page_destroy(struct zsurf_atlas_page* page);
+
+/**
+ * place the entry in this page, defragmenting it in place if needed; every
+ * entry of the page must be shown through the same toplevel
+ * return false when it does not fit
+ */
+bool zsurf_atlas_page_place(struct zsurf_atlas_page* page,
+    struct zsurf_atlas_entry* entry, uint32_t width, uint32_t height);
+
+void zsurf_atlas_page_remove(struct zsurf_atlas_entry* entry);
+
+void zsurf_atlas_init(struct zsurf_atlas* atlas);
+
+void zsurf_atlas_fini(struct zsurf_display* surface_display);
+
+/**
+ * give the entry a place of the size, repacking a page into a new one or
+ * adding a page when no page has room. The entry keeps its place if the size
+ * is the same.
+ * return -1 when failed to create a page
+ */
+int zsurf_atlas_place(struct zsurf_display* surface_display,
+    struct zsurf_atlas_entry* entry, uint32_t width, uint32_t height);
+
+void zsurf_atlas_remove(struct zsurf_atlas_entry* entry);
+
+/**
+ * the entry's owner does not show it anymore, e.g. its view is destroyed
+ */
+void zsurf_atlas_release(struct zsurf_atlas_entry* entry);
+
+/**
+ * the toplevel committed, its entries show their new place now
+ */
+void zsurf_atlas_commit(struct zsurf_toplevel* toplevel);
+
+/**
+ * copy packed pixels of the entry's size to its place
+ */
+void zsurf_atlas_write(
+    struct zsurf_atlas_entry* entry, const struct zsurf_color_bgra* data);
+
+/**
+ * map texture coordinates of the entry to the coordinates in its page
+ */
+void zsurf_atlas_uv(struct zsurf_atlas_entry* entry, vec2 uv0, vec2 uv1);
+
 struct zsurf_view {
   void* user_data;
   struct zsurf_display* surface_display;
@@ -157,7 +396,7 @@ struct zsurf_view {
     int32_t sy;
   } surface_geometry;
 
-  int fd, vertex_shader_fd, fragment_shader_fd;
+  int fd;
   void* shm_data;
   size_t shm_size;
   struct wl_shm_pool* pool;
@@ -172,7 +411,32 @@ struct zsurf_view {
 
   struct zgn_opengl_texture* texture;
   struct wl_buffer* texture_buffer;
-  struct zsurf_color_bgra* texture_data;
+  void* texture_data;
+  size_t texture_capacity;  // in bytes
+  enum wl_shm_format texture_format;
+  uint32_t texture_stride;
+  uint32_t texture_height;  // rows, more than the surface's for yuv, layers
+  uint32_t layer_count;     // 1 unless ZSURF_VIEW_SHADER_LAYERS
+  enum zsurf_view_shader shader_kind;
+  struct zsurf_view_color_transform color_transform;  // uniforms of shader
+
+  struct {
+    bool set;  // the whole texture otherwise
+    float x, y, width, height;  // in texture pixels
+  } source;
+
+  struct zsurf_atlas_entry atlas;  // texture lives there when it has a page
+
+  struct wl_list pool_link;  // zsurf_display.view_pool.list
+
+  struct {
+    struct wl_list link;  // zsurf_display.memory.view_list
+    struct zsurf_memory_stats stats;
+    bool texture_busy;   // attached and not released by the compositor yet
+    bool dropped;        // texture pages were handed back to the kernel
+    bool in_place;       // the app draws on the previous contents, keep them
+    uint64_t active_ns;  // last draw or frame callback request
+  } memory;
 
   struct zsurf_signal commit_signal;
   struct zsurf_signal destroy_signal;
@@ -183,6 +447,55 @@ struct zsurf_view {
 
 void zsurf_view_update_space_geom(struct zsurf_view* view);
 
+/**
+ * map a point of the view's quad, in fractions from its top left, to the
+ * pixels of its source rectangle
+ */
+void zsurf_view_local_coord(
+    struct zsurf_view* view, float fx, float fy, vec2 local_coord);
+
+struct zsurf_batch_tile {
+  struct zsurf_batch* batch;
+  struct zsurf_batch_quad quad;
+  struct zsurf_atlas_entry atlas;  // in zsurf_batch.page when textured
+};
+
+struct zsurf_batch {
+  struct zsurf_display* surface_display;
+  struct zsurf_toplevel* toplevel;
+  struct zsurf_view* parent;
+  int32_t z_index;
+
+  uint32_t capacity;
+  struct zsurf_batch_tile* tiles;
+
+  int fd;
+  struct wl_shm_pool* pool;
+  struct zgn_opengl_vertex_buffer* vertex_buffer;
+  struct wl_buffer* vertex_buffer_buffer;
+  struct view_rect* vertex_data;  // a rect per tile
+  size_t vertex_data_size;
+
+  struct zgn_opengl_shader_program* shader;
+  struct zsurf_view_color_transform color_transform;
+  struct zsurf_atlas_page* page;
+  struct zgn_opengl_component* component;
+
+  struct zsurf_listener parent_geometry_listener;
+  uint32_t record_id;  // 0 if not recorded
+};
+
+// views that neither drew nor asked for a frame for this long can lose their
+// backing store when the display is over its memory budget
+#define ZSURF_MEMORY_IDLE_NS 1000000000
+
+/**
+ * recompute the view's memory stats and the display's totals
+ */
+void zsurf_view_memory_update(struct zsurf_view* view);
+
+void zsurf_view_memory_forget(struct zsurf_view* view);
+
 void zsurf_view_update_surface_pos(
     struct zsurf_view* view, int32_t sx, int32_t sy);
 
@@ -192,11 +505,129 @@ struct zsurf_view* zsurf_view_create(struct zsurf_display* surface_display,
 
 void zsurf_view_destroy(struct zsurf_view* view);
 
-struct zsurf_toplevel {
+// views with a larger backing store are torn down instead of pooled
+#define ZSURF_VIEW_POOL_MAX_SHM_SIZE (4 * 1024 * 1024)
+
+/**
+ * build at most max views until the pool reaches its size.
+ * return -1 when failed to build a view
+ */
+int zsurf_view_pool_fill(struct zsurf_display* surface_display, uint32_t max);
+
+/**
+ * tear down pooled views above the pool size
+ */
+void zsurf_view_pool_trim(struct zsurf_display* surface_display);
+
+struct zsurf_shader_source {
+  int fd;  // sealed memfd shared by every view of the display
+  uint32_t size;
+};
+
+struct zsurf_view_callback_data {
+  zsurf_view_frame_callback_func_t func;
+  void* data;
   struct zsurf_display* surface_display;
-  struct zsurf_view* view;
+  struct zsurf_toplevel* toplevel;  // null once the toplevel is destroyed
+  // zsurf_display.frame_callback_pool while unused,
+  // zsurf_toplevel.activity.frame_list while waiting for the compositor,
+  // zsurf_throttle.deferred_list while held back
+  struct wl_list link;
+
+  uint32_t callback_time;  // of a held back frame
+  uint64_t deferred_ns;
+  uint64_t deadline_ns;
+};
+
+/**
+ * call the user's function and recycle callback_data, which must not be in
+ * any list
+ */
+void zsurf_view_frame_callback_deliver(
+    struct zsurf_view_callback_data* callback_data, uint32_t callback_time);
+
+void zsurf_view_frame_callback_pool_fini(
+    struct zsurf_display* surface_display);
+
+int zsurf_view_init_shader_sources(struct zsurf_display* surface_display);
+
+void zsurf_view_fini_shader_sources(struct zsurf_display* surface_display);
+
+#define ZSURF_LATENCY_MAX_FRAMES 4          // commits waiting for a frame
+#define ZSURF_LATENCY_HISTOGRAM_SIZE 256  // 1ms buckets, the last one open
+
+struct zsurf_latency_frame {
+  struct zsurf_latency* latency;
+  struct wl_callback* callback;  // null while the slot is free
+  uint32_t input_time;           // compositor time of the input, in ms
+  uint64_t trace;
+};
+
+// input to present latency of a toplevel
+struct zsurf_latency {
+  bool input_pending;  // an input arrived after the last matched commit
+  uint32_t input_time;
+  uint64_t input_trace;
+
+  struct zsurf_latency_frame frames[ZSURF_LATENCY_MAX_FRAMES];
+
+  uint64_t count;
+  uint64_t dropped;
+  uint64_t total_ms;
+  uint32_t min_ms;
+  uint32_t max_ms;
+  uint32_t histogram[ZSURF_LATENCY_HISTOGRAM_SIZE];
+};
+
+void zsurf_latency_init(struct zsurf_latency* latency);
+
+void zsurf_latency_fini(struct zsurf_latency* latency);
+
+/**
+ * time is the timestamp of the input event
+ */
+void zsurf_latency_input(struct zsurf_latency* latency, uint32_t time);
+
+/**
+ * call before committing virtual_object, asks for a frame callback when an
+ * input is waiting for this commit
+ */
+void zsurf_latency_commit(
+    struct zsurf_latency* latency, struct zgn_virtual_object* virtual_object);
 
-  struct zgn_virtual_object* virtual_object;
+// render time of the app and the texture scale that meets a target
+struct zsurf_resolution {
+  uint64_t target_ns;  // 0 if not adaptive
+  float min_scale;
+  float scale;
+  uint64_t frame_ns;    // a frame callback went to the app, 0 if none since
+  uint64_t average_ns;  // of the frames since the last change, smoothed
+  uint32_t frames;      // since the last change
+  uint32_t changes;
+};
+
+void zsurf_resolution_init(struct zsurf_resolution* resolution);
+
+/**
+ * take one render time, and maybe change the scale
+ */
+void zsurf_resolution_sample(struct zsurf_resolution* resolution, uint64_t ns);
+
+/**
+ * a frame callback is delivered to the app, the next frame starts
+ */
+void zsurf_resolution_frame(struct zsurf_resolution* resolution);
+
+/**
+ * the app committed, its frame is done
+ */
+void zsurf_resolution_commit(struct zsurf_resolution* resolution);
+
+struct zsurf_toplevel {
+  struct zsurf_display* surface_display;  // null if destroyed while queued
+  struct zsurf_view* view;                // null while queued
+
+  struct zgn_virtual_object* virtual_object;  // null while queued
   struct zgn_cuboid_window* cuboid_window;  // null at the beginning
 
   struct zsurf_listener view_commit_listener;
@@ -204,16 +635,215 @@ struct zsurf_toplevel {
 
   vec2 toplevel_view_half_size;
   versor quaternion;
+
+  struct zsurf_latency latency;
+  struct zsurf_resolution resolution;
+  uint32_t record_id;
+
+  struct wl_list queue_link;  // zsurf_display.startup.toplevel_list
+  void* view_user_data;       // for the view built once the display is ready
+
+  struct {
+    uint64_t input_ns;      // last input, or the creation
+    uint64_t last_done_ns;  // last frame callback from the compositor
+    uint64_t interval_ns;   // compositor frame interval, smoothed
+    struct wl_list frame_list;  // zsurf_view_callback_data.link
+  } activity;
 };
 
+/**
+ * an input event was delivered to the toplevel at time, in the compositor's
+ * clock
+ */
+void zsurf_toplevel_input(struct zsurf_toplevel* toplevel, uint32_t time);
+
+/**
+ * build the toplevels created while the display was starting up.
+ * return -1 when any of them failed to build
+ */
+int zsurf_toplevel_bind_queued(struct zsurf_display* surface_display);
+
 struct zsurf_view* zsurf_toplevel_pick_view(struct zsurf_toplevel* toplevel,
     vec3 ray_origin, vec3 ray_direction, vec2 local_coord);
 
+struct zsurf_key_repeat {
+  int fd;  // timerfd, armed only while a key is held
+  int32_t rate;
+  int32_t delay;
+
+  bool active;
+  uint32_t key;
+  uint32_t serial;
+  uint32_t press_time;
+  uint64_t count;  // repeats already delivered for the held key
+};
+
+int zsurf_key_repeat_init(struct zsurf_key_repeat* key_repeat);
+
+void zsurf_key_repeat_fini(struct zsurf_key_repeat* key_repeat);
+
+void zsurf_key_repeat_key(struct zsurf_key_repeat* key_repeat,
+    uint32_t serial, uint32_t time, uint32_t key, uint32_t state);
+
+void zsurf_key_repeat_stop(struct zsurf_key_repeat* key_repeat);
+
+void zsurf_key_repeat_dispatch(
+    struct zsurf_key_repeat* key_repeat, struct zsurf_display* surface_display);
+
+#define ZSURF_THROTTLE_DEFAULT_INTERVAL_NS 16666667  // until frames are seen
+
+struct zsurf_throttle {
+  int fd;             // timerfd, armed to the earliest deadline
+  uint64_t armed_ns;  // deadline the timer is set to, 0 if disarmed
+  uint64_t idle_ns;
+  float fraction;               // of the frame rate idle toplevels get
+  struct wl_list deferred_list;  // zsurf_view_callback_data.link, by deadline
+};
+
+int zsurf_throttle_init(struct zsurf_throttle* throttle);
+
+/**
+ * call before zsurf_view_frame_callback_pool_fini
+ */
+void zsurf_throttle_fini(struct zsurf_display* surface_display);
+
+/**
+ * return true when the frame is held back, to be delivered by
+ * zsurf_throttle_dispatch
+ */
+bool zsurf_throttle_defer(struct zsurf_display* surface_display,
+    struct zsurf_view_callback_data* callback_data, uint32_t callback_time);
+
+void zsurf_throttle_dispatch(struct zsurf_display* surface_display);
+
+/**
+ * mark the toplevel active and hand over its held back frames at once
+ */
+void zsurf_throttle_input(
+    struct zsurf_display* surface_display, struct zsurf_toplevel* toplevel);
+
+/**
+ * drop the held back frames of a toplevel being destroyed
+ */
+void zsurf_throttle_forget(
+    struct zsurf_display* surface_display, struct zsurf_toplevel* toplevel);
+
+struct zsurf_keymap {
+  struct wl_list link;  // zsurf_display.keymap_cache, most recent first
+  uint64_t hash;
+  uint64_t generation;
+  uint32_t format;
+  const char* data;  // read-only mapping of the compositor's keymap fd
+  uint32_t size;
+
+  uint32_t min_keycode;  // xkb keycodes
+  uint32_t max_keycode;
+  uint32_t* keysyms;  // nullable, indexed by keycode - min_keycode
+  bool* repeats;      // nullable, indexed by keycode - min_keycode
+};
+
+/**
+ * takes ownership of fd. return NULL when failed to map the keymap
+ */
+struct zsurf_keymap* zsurf_keymap_cache_get(
+    struct zsurf_display* surface_display, uint32_t format, int fd,
+    uint32_t size);
+
+void zsurf_keymap_cache_fini(struct zsurf_display* surface_display);
+
+bool zsurf_keymap_key_repeats(struct zsurf_keymap* keymap, uint32_t key);
+
+#define ZSURF_RECORD_MAGIC 0x4352535a  // "ZSRC" in little endian
+#define ZSURF_RECORD_VERSION 2
+#define ZSURF_RECORD_MAX_KEYS 32  // of keyboard enter, the rest is dropped
+
+/**
+ * A recording is a zsurf_record_file_header followed by records, each a
+ * zsurf_record_header and size bytes of payload. Payloads are 32 bit words,
+ * unsigned, signed or float, in the order given below. id is the record id of
+ * the toplevel or batch the record is about, 0 if none. Frame callbacks are
+ * answered by the compositor a recording is replayed against.
+ */
+enum zsurf_record_type {
+  // requests made through the public API
+  ZSURF_RECORD_TOPLEVEL_CREATE = 1,  // -
+  ZSURF_RECORD_TOPLEVEL_DESTROY,     // -
+  ZSURF_RECORD_TOPLEVEL_MOVE,        // serial
+  ZSURF_RECORD_VIEW_SET_TEXTURE,     // kind, format, width, height
+  ZSURF_RECORD_VIEW_COMMIT,          // -
+  ZSURF_RECORD_VIEW_FRAME,           // -
+  ZSURF_RECORD_SET_CURSOR,  // width, height, hotspot x, y; 0x0 clears it
+  ZSURF_RECORD_VIEW_SCROLL,           // rect x, y, width, height, dy
+  ZSURF_RECORD_VIEW_SET_SOURCE,       // x, y, width, height
+  ZSURF_RECORD_VIEW_COLOR_TRANSFORM,  // opacity, multiply[4], add[4]
+  ZSURF_RECORD_BATCH_CREATE,          // toplevel id, capacity
+  ZSURF_RECORD_BATCH_DESTROY,         // -
+  ZSURF_RECORD_BATCH_SET_QUAD,  // index, sx, sy, width, height, source x, y,
+                                // width, height, z
+  ZSURF_RECORD_BATCH_SET_QUAD_TEXTURE,  // index, width, height
+  ZSURF_RECORD_BATCH_CLEAR_QUAD,        // index
+
+  // events from the compositor
+  ZSURF_RECORD_RAY_ENTER = 64,  // serial, origin[3], direction[3]
+  ZSURF_RECORD_RAY_LEAVE,       // serial
+  ZSURF_RECORD_RAY_MOTION,      // time, origin[3], direction[3]
+  ZSURF_RECORD_RAY_BUTTON,      // serial, time, button, state
+  ZSURF_RECORD_KEYBOARD_ENTER,  // serial, keys...
+  ZSURF_RECORD_KEYBOARD_LEAVE,  // serial
+  ZSURF_RECORD_KEYBOARD_KEY,    // serial, time, key, state
+  ZSURF_RECORD_KEYBOARD_MODIFIERS,  // serial, depressed, latched, locked,
+                                    // group
+  ZSURF_RECORD_CONFIGURE,  // serial, half_size[3], quaternion[4]
+  ZSURF_RECORD_MOVED,      // face_direction[3]
+};
+
+/**
+ * kind of ZSURF_RECORD_VIEW_SET_TEXTURE, the call that set the texture, and
+ * what its format word holds
+ */
+enum zsurf_record_texture {
+  ZSURF_RECORD_TEXTURE_FORMAT = 0,  // zsurf_pixel_format
+  ZSURF_RECORD_TEXTURE_YUV,         // zsurf_yuv_format
+  ZSURF_RECORD_TEXTURE_LAYER,       // the layer
+  ZSURF_RECORD_TEXTURE_ATLAS,       // -
+  ZSURF_RECORD_TEXTURE_BUFFER,      // -, zsurf_view_get_texture_buffer
+};
+
+struct zsurf_record_file_header {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct zsurf_record_header {
+  uint64_t time_ns;  // since the recording started
+  uint16_t type;
+  uint16_t size;  // of the payload in bytes
+  uint32_t id;
+};
+
+union zsurf_record_word {
+  uint32_t u;
+  float f;
+};
+
+struct zsurf_recorder;
+
+void zsurf_recorder_append(struct zsurf_recorder* recorder,
+    enum zsurf_record_type type, uint32_t id, const void* payload,
+    uint16_t size);
+
+/**
+ * start recording to $ZSURFACE_RECORD if it is set
+ */
+void zsurf_record_init_from_env(struct zsurf_display* surface_display);
+
 struct zsurf_display {
   const struct zsurf_display_interface* interaface;
   void* user_data;
 
   struct wl_display* display;
+  int epoll_fd;  // connection fd and timers
+  bool watch_writable;
   struct wl_registry* registry;
   struct zgn_compositor* compositor;
   struct zgn_seat* seat;
@@ -221,8 +851,36 @@ struct zsurf_display {
   struct wl_shm* shm;
   struct zgn_opengl* opengl;
 
+  bool ready;  // every required global is bound
+  struct {
+    bool async;
+    bool done;
+    struct wl_callback* callback;  // nullable
+    struct wl_list toplevel_list;  // zsurf_toplevel.queue_link, not built yet
+  } startup;
+
+  struct zsurf_shader_source vertex_shader_source;
+  struct zsurf_shader_source fragment_shader_sources[ZSURF_VIEW_SHADER_COUNT];
+  uint32_t shm_formats;  // zsurf_convert_shm_format_bit of advertised ones
+
+  struct wl_list frame_callback_pool;  // finished frame callback records
+
+  struct {
+    struct wl_list list;  // zsurf_view.pool_link, not bound to any toplevel
+    uint32_t count;
+    uint32_t size;
+  } view_pool;
+
   struct zgn_ray* ray;            // nullable
   struct zgn_keyboard* keyboard;  // nullable
+  struct zsurf_key_repeat key_repeat;
+  struct zsurf_throttle throttle;
+  struct zsurf_atlas atlas;
+
+  struct xkb_context* xkb_context;  // nullable
+  struct wl_list keymap_cache;
+  struct zsurf_keymap* keymap;  // nullable
+  uint64_t keymap_generation;
 
   struct zsurf_toplevel* focus_toplevel;
   struct zsurf_listener focus_toplevel_destroy_listener;
@@ -230,12 +888,138 @@ struct zsurf_display {
   struct zsurf_view* focus_view;
   struct zsurf_listener focus_view_destroy_listener;
 
+  struct zsurf_toplevel* keyboard_focus_toplevel;
+  struct zsurf_listener keyboard_focus_toplevel_destroy_listener;
+
   struct {
     struct zsurf_view* view;  // nullable
     vec2 local_coord;
     int32_t hotspot_x;
     int32_t hotspot_y;
   } cursor;
+
+  struct zsurf_display_group* group;  // nullable
+  struct wl_list group_link;
+  struct {
+    bool prepared;
+    bool readable;
+    struct wl_list pending_link;  // members still to visit this dispatch
+  } group_state;
+  struct zsurf_display_stats stats;
+
+  struct {
+    struct wl_list view_list;  // zsurf_view.memory.link, pooled views too
+    struct zsurf_memory_stats stats;
+    uint64_t budget;  // 0 if none
+    bool over_budget;
+  } memory;
+
+  struct zsurf_recorder* recorder;  // nullable
+  uint32_t record_next_id;
 };
 
+void zsurf_display_watch_writable(
+    struct zsurf_display* surface_display, bool writable);
+
+/**
+ * reclaim idle views when over the budget, notify the user if that is not
+ * enough
+ */
+void zsurf_display_check_memory_budget(struct zsurf_display* surface_display);
+
+static inline void
+zsurf_record(struct zsurf_display* surface_display,
+    enum zsurf_record_type type, uint32_t id, const void* payload,
+    uint16_t size)
+{
+  if (surface_display->recorder)
+    zsurf_recorder_append(surface_display->recorder, type, id, payload, size);
+}
+
+/**
+ * only views the user asked for are recorded, not cursors nor child views
+ */
+static inline uint32_t
+zsurf_view_record_id(struct zsurf_view* view)
+{
+  if (view->surface_display->recorder == NULL ||
+      view != view->toplevel->view)
+    return 0;
+  return view->toplevel->record_id;
+}
+
+extern const struct zgn_ray_listener zsurf_display_ray_listener;
+
+extern const struct zgn_keyboard_listener zsurf_display_keyboard_listener;
+
+extern const struct zgn_cuboid_window_listener
+    zsurf_toplevel_cuboid_window_listener;
+
+static inline uint64_t
+zsurf_get_time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifndef ZSURF_TRACE
+#define ZSURF_TRACE 0
+#endif
+
+enum zsurf_trace_event {
+  ZSURF_TRACE_COMMIT,
+  ZSURF_TRACE_TEXTURE_COPY,
+  ZSURF_TRACE_RESIZE,
+  ZSURF_TRACE_GEOMETRY,
+  ZSURF_TRACE_FRAME_CALLBACK,
+  ZSURF_TRACE_RAY_MOTION,
+  ZSURF_TRACE_RAY_BUTTON,
+  ZSURF_TRACE_KEY,
+  ZSURF_TRACE_PICK,
+  ZSURF_TRACE_INPUT_LATENCY,
+  ZSURF_TRACE_EVENT_COUNT,
+};
+
+#if ZSURF_TRACE
+
+extern bool zsurf_trace_enabled;
+
+void zsurf_trace_record(enum zsurf_trace_event event, uint64_t start_ns,
+    uint64_t end_ns, uint64_t arg);
+
+/**
+ * return 0 while recording is disabled, pass it to zsurf_trace_end as is
+ */
+static inline uint64_t
+zsurf_trace_begin(void)
+{
+  if (!__atomic_load_n(&zsurf_trace_enabled, __ATOMIC_RELAXED)) return 0;
+  return zsurf_get_time_ns();
+}
+
+static inline void
+zsurf_trace_end(enum zsurf_trace_event event, uint64_t start, uint64_t arg)
+{
+  if (start) zsurf_trace_record(event, start, zsurf_get_time_ns(), arg);
+}
+
+#else  // ZSURF_TRACE
+
+static inline uint64_t
+zsurf_trace_begin(void)
+{
+  return 0;
+}
+
+static inline void
+zsurf_trace_end(enum zsurf_trace_event event, uint64_t start, uint64_t arg)
+{
+  UNUSED(event);
+  UNUSED(start);
+  UNUSED(arg);
+}
+
+#endif  // ZSURF_TRACE
+
 #endif  //  ZSURFACE_INTERNAL_H
@@ -0,0 +1,127 @@
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+// synthesized events delivered per wakeup at most; a client that was blocked
+// for a long time skips the older repeats instead of receiving a burst
+#define ZSURF_KEY_REPEAT_MAX_BURST 8
+
+static void
+zsurf_key_repeat_disarm(struct zsurf_key_repeat* key_repeat)
+{
+  struct itimerspec its = {0};
+
+  key_repeat->active = false;
+  timerfd_settime(key_repeat->fd, 0, &its, NULL);
+}
+
+static void
+timespec_from_ns(struct timespec* ts, uint64_t ns)
+{
+  ts->tv_sec = ns / 1000000000;
+  ts->tv_nsec = ns % 1000000000;
+}
+
+int
+zsurf_key_repeat_init(struct zsurf_key_repeat* key_repeat)
+{
+  key_repeat->fd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (key_repeat->fd < 0) return -1;
+
+  key_repeat->rate = 0;
+  key_repeat->delay = 0;
+  key_repeat->active = false;
+
+  return 0;
+}
+
+void
+zsurf_key_repeat_fini(struct zsurf_key_repeat* key_repeat)
+{
+  close(key_repeat->fd);
+}
+
+void
+zsurf_key_repeat_stop(struct zsurf_key_repeat* key_repeat)
+{
+  if (key_repeat->active) zsurf_key_repeat_disarm(key_repeat);
+}
+
+void
+zsurf_key_repeat_key(struct zsurf_key_repeat* key_repeat, uint32_t serial,
+    uint32_t time, uint32_t key, uint32_t state)
+{
+  struct itimerspec its;
+  uint64_t start_ns, interval_ns;
+
+  if (state == 0) {
+    if (key_repeat->active && key_repeat->key == key)
+      zsurf_key_repeat_disarm(key_repeat);
+    return;
+  }
+
+  if (key_repeat->rate <= 0) return;
+
+  interval_ns = 1000000000 / key_repeat->rate;
+  start_ns = zsurf_get_time_ns() + (uint64_t)key_repeat->delay * 1000000;
+
+  key_repeat->active = true;
+  key_repeat->key = key;
+  key_repeat->serial = serial;
+  key_repeat->press_time = time;
+  key_repeat->count = 0;
+
+  // the event time is in the compositor's clock, which we cannot map to
+  // ours; repeats start from when the press is dispatched here, later
+  // dispatch latency no longer shifts them with an absolute timer
+  timespec_from_ns(&its.it_value, start_ns);
+  timespec_from_ns(&its.it_interval, interval_ns);
+  timerfd_settime(key_repeat->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+void
+zsurf_key_repeat_dispatch(
+    struct zsurf_key_repeat* key_repeat, struct zsurf_display* surface_display)
+{
+  uint64_t expirations;
+  uint32_t time;
+
+  // disarming resets the timer, no expiration is pending while inactive
+  if (!key_repeat->active) return;
+
+  if (read(key_repeat->fd, &expirations, sizeof expirations) !=
+      sizeof expirations)
+    return;
+
+  if (expirations > ZSURF_KEY_REPEAT_MAX_BURST) {
+    key_repeat->count += expirations - ZSURF_KEY_REPEAT_MAX_BURST;
+    expirations = ZSURF_KEY_REPEAT_MAX_BURST;
+  }
+
+  while (expirations-- > 0 && key_repeat->active) {
+    // timestamp in the compositor's clock, derived from the press event
+    time = key_repeat->press_time + key_repeat->delay +
+           (uint32_t)(key_repeat->count * 1000 / key_repeat->rate);
+    key_repeat->count++;
+
+    surface_display->interaface->keyboard_key(surface_display->user_data,
+        key_repeat->serial, time, key_repeat->key,
+        ZSURF_KEYBOARD_KEY_STATE_PRESSED);
+  }
+}
+
+WL_EXPORT void
+zsurf_display_set_keyboard_repeat(
+    struct zsurf_display* surface_display, int32_t rate, int32_t delay)
+{
+  struct zsurf_key_repeat* key_repeat = &surface_display->key_repeat;
+
+  key_repeat->rate = rate > 0 ? rate : 0;
+  key_repeat->delay = delay > 0 ? delay : 0;
+
+  if (key_repeat->rate == 0) zsurf_key_repeat_stop(key_repeat);
+}
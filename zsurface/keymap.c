@@ -0,0 +1,207 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <xkbcommon/xkbcommon.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define ZSURF_KEYMAP_CACHE_SIZE 4
+#define ZSURF_KEYMAP_FORMAT_XKB_V1 1
+#define EVDEV_KEYCODE_OFFSET 8
+
+static uint64_t
+zsurf_keymap_hash(const char* data, uint32_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325;  // FNV-1a
+
+  for (uint32_t i = 0; i < size; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 0x100000001b3;
+  }
+
+  return hash;
+}
+
+static int
+zsurf_keymap_build_table(
+    struct zsurf_keymap* keymap, struct xkb_context* xkb_context)
+{
+  struct xkb_keymap* xkb_keymap;
+  const xkb_keysym_t* syms;
+  uint32_t count;
+
+  xkb_keymap = xkb_keymap_new_from_buffer(xkb_context, keymap->data,
+      strnlen(keymap->data, keymap->size), XKB_KEYMAP_FORMAT_TEXT_V1,
+      XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (xkb_keymap == NULL) return -1;
+
+  keymap->min_keycode = xkb_keymap_min_keycode(xkb_keymap);
+  keymap->max_keycode = xkb_keymap_max_keycode(xkb_keymap);
+  count = keymap->max_keycode - keymap->min_keycode + 1;
+
+  keymap->keysyms = calloc(count, sizeof *keymap->keysyms);
+  keymap->repeats = calloc(count, sizeof *keymap->repeats);
+  if (keymap->keysyms == NULL || keymap->repeats == NULL) {
+    xkb_keymap_unref(xkb_keymap);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    xkb_keycode_t keycode = keymap->min_keycode + i;
+    if (xkb_keymap_key_get_syms_by_level(xkb_keymap, keycode, 0, 0, &syms) > 0)
+      keymap->keysyms[i] = syms[0];
+    keymap->repeats[i] = xkb_keymap_key_repeats(xkb_keymap, keycode);
+  }
+
+  xkb_keymap_unref(xkb_keymap);
+
+  return 0;
+}
+
+static void
+zsurf_keymap_destroy(struct zsurf_keymap* keymap)
+{
+  wl_list_remove(&keymap->link);
+  free(keymap->keysyms);
+  free(keymap->repeats);
+  munmap((void*)keymap->data, keymap->size);
+  free(keymap);
+}
+
+static struct zsurf_keymap*
+zsurf_keymap_create(struct zsurf_display* surface_display, uint32_t format,
+    const char* data, uint32_t size, uint64_t hash)
+{
+  struct zsurf_keymap* keymap;
+
+  keymap = zalloc(sizeof *keymap);
+  if (keymap == NULL) return NULL;
+
+  keymap->hash = hash;
+  keymap->format = format;
+  keymap->data = data;
+  keymap->size = size;
+  keymap->generation = ++surface_display->keymap_generation;
+  wl_list_init(&keymap->link);
+
+  if (format != ZSURF_KEYMAP_FORMAT_XKB_V1) return keymap;
+
+  if (surface_display->xkb_context == NULL)
+    surface_display->xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+
+  if (surface_display->xkb_context == NULL ||
+      zsurf_keymap_build_table(keymap, surface_display->xkb_context) != 0) {
+    zsurf_log_warn("zsurface: failed to compile keymap\n");
+    free(keymap->keysyms);
+    free(keymap->repeats);
+    keymap->keysyms = NULL;
+    keymap->repeats = NULL;
+  }
+
+  return keymap;
+}
+
+struct zsurf_keymap*
+zsurf_keymap_cache_get(struct zsurf_display* surface_display, uint32_t format,
+    int fd, uint32_t size)
+{
+  struct zsurf_keymap *keymap, *oldest;
+  const char* data;
+  uint64_t hash;
+
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+
+  hash = zsurf_keymap_hash(data, size);
+
+  wl_list_for_each(keymap, &surface_display->keymap_cache, link)
+  {
+    if (keymap->hash != hash || keymap->format != format ||
+        keymap->size != size || memcmp(keymap->data, data, size) != 0)
+      continue;
+
+    munmap((void*)data, size);
+    wl_list_remove(&keymap->link);
+    wl_list_insert(&surface_display->keymap_cache, &keymap->link);
+    return keymap;
+  }
+
+  keymap = zsurf_keymap_create(surface_display, format, data, size, hash);
+  if (keymap == NULL) {
+    munmap((void*)data, size);
+    return NULL;
+  }
+
+  if (wl_list_length(&surface_display->keymap_cache) >=
+      ZSURF_KEYMAP_CACHE_SIZE) {
+    oldest =
+        wl_container_of(surface_display->keymap_cache.prev, oldest, link);
+    if (oldest != surface_display->keymap) zsurf_keymap_destroy(oldest);
+  }
+
+  wl_list_insert(&surface_display->keymap_cache, &keymap->link);
+
+  return keymap;
+}
+
+void
+zsurf_keymap_cache_fini(struct zsurf_display* surface_display)
+{
+  struct zsurf_keymap *keymap, *tmp;
+
+  wl_list_for_each_safe(keymap, tmp, &surface_display->keymap_cache, link)
+      zsurf_keymap_destroy(keymap);
+
+  if (surface_display->xkb_context)
+    xkb_context_unref(surface_display->xkb_context);
+}
+
+bool
+zsurf_keymap_key_repeats(struct zsurf_keymap* keymap, uint32_t key)
+{
+  uint32_t keycode = key + EVDEV_KEYCODE_OFFSET;
+
+  if (keymap == NULL || keymap->repeats == NULL) return true;
+  if (keycode < keymap->min_keycode || keycode > keymap->max_keycode)
+    return true;
+
+  return keymap->repeats[keycode - keymap->min_keycode];
+}
+
+WL_EXPORT uint32_t
+zsurf_keymap_key_get_keysym(struct zsurf_keymap* keymap, uint32_t key)
+{
+  uint32_t keycode = key + EVDEV_KEYCODE_OFFSET;
+
+  if (keymap->keysyms == NULL) return 0;
+  if (keycode < keymap->min_keycode || keycode > keymap->max_keycode)
+    return 0;
+
+  return keymap->keysyms[keycode - keymap->min_keycode];
+}
+
+WL_EXPORT const char*
+zsurf_keymap_get_data(struct zsurf_keymap* keymap, uint32_t* size)
+{
+  if (size) *size = keymap->size;
+  return keymap->data;
+}
+
+WL_EXPORT uint32_t
+zsurf_keymap_get_format(struct zsurf_keymap* keymap)
+{
+  return keymap->format;
+}
+
+WL_EXPORT uint64_t
+zsurf_keymap_get_generation(struct zsurf_keymap* keymap)
+{
+  return keymap->generation;
+}
+
+WL_EXPORT struct zsurf_keymap*
+zsurf_display_get_keymap(struct zsurf_display* surface_display)
+{
+  return surface_display->keymap;
+}
@@ -0,0 +1,139 @@
+#include <zsurface.h>
+
+#include "internal.h"
+
+static void
+zsurf_latency_frame_done(
+    void* data, struct wl_callback* callback, uint32_t callback_time)
+{
+  struct zsurf_latency_frame* frame = data;
+  struct zsurf_latency* latency = frame->latency;
+  uint32_t elapsed = callback_time - frame->input_time;  // wraps with time
+
+  wl_callback_destroy(callback);
+  frame->callback = NULL;
+
+  // a compositor on another clock gives nonsense, drop what is obviously off
+  if (elapsed > UINT32_MAX / 2) return;
+
+  if (latency->count == 0 || elapsed < latency->min_ms)
+    latency->min_ms = elapsed;
+  if (elapsed > latency->max_ms) latency->max_ms = elapsed;
+  latency->count++;
+  latency->total_ms += elapsed;
+  latency->histogram[elapsed < ZSURF_LATENCY_HISTOGRAM_SIZE
+                         ? elapsed
+                         : ZSURF_LATENCY_HISTOGRAM_SIZE - 1]++;
+
+  zsurf_trace_end(ZSURF_TRACE_INPUT_LATENCY, frame->trace, elapsed);
+}
+
+static const struct wl_callback_listener zsurf_latency_frame_listener = {
+    .done = zsurf_latency_frame_done,
+};
+
+void
+zsurf_latency_init(struct zsurf_latency* latency)
+{
+  *latency = (struct zsurf_latency){0};
+  for (int i = 0; i < ZSURF_LATENCY_MAX_FRAMES; i++)
+    latency->frames[i].latency = latency;
+}
+
+void
+zsurf_latency_fini(struct zsurf_latency* latency)
+{
+  for (int i = 0; i < ZSURF_LATENCY_MAX_FRAMES; i++) {
+    if (latency->frames[i].callback)
+      wl_callback_destroy(latency->frames[i].callback);
+  }
+}
+
+void
+zsurf_latency_input(struct zsurf_latency* latency, uint32_t time)
+{
+  // the earliest input not committed yet is the one that waits the longest
+  if (latency->input_pending) return;
+
+  latency->input_pending = true;
+  latency->input_time = time;
+  latency->input_trace = zsurf_trace_begin();
+}
+
+void
+zsurf_latency_commit(
+    struct zsurf_latency* latency, struct zgn_virtual_object* virtual_object)
+{
+  struct zsurf_latency_frame* frame = NULL;
+
+  if (!latency->input_pending) return;
+
+  for (int i = 0; i < ZSURF_LATENCY_MAX_FRAMES; i++) {
+    if (latency->frames[i].callback == NULL) {
+      frame = &latency->frames[i];
+      break;
+    }
+  }
+
+  // every slot waits for a frame; matching the input to a later commit would
+  // count the backlog as latency, drop the sample instead
+  if (frame == NULL) {
+    latency->dropped++;
+    latency->input_pending = false;
+    return;
+  }
+
+  frame->input_time = latency->input_time;
+  frame->trace = latency->input_trace;
+  frame->callback = zgn_virtual_object_frame(virtual_object);
+  wl_callback_add_listener(
+      frame->callback, &zsurf_latency_frame_listener, frame);
+
+  latency->input_pending = false;
+}
+
+static uint32_t
+zsurf_latency_percentile(struct zsurf_latency* latency, uint32_t percent)
+{
+  uint64_t rank = (latency->count * percent + 99) / 100;
+  uint64_t seen = 0;
+
+  for (uint32_t i = 0; i < ZSURF_LATENCY_HISTOGRAM_SIZE; i++) {
+    seen += latency->histogram[i];
+    if (seen >= rank) return i;
+  }
+
+  return ZSURF_LATENCY_HISTOGRAM_SIZE - 1;
+}
+
+WL_EXPORT void
+zsurf_toplevel_get_latency_stats(
+    struct zsurf_toplevel* toplevel, struct zsurf_latency_stats* stats)
+{
+  struct zsurf_latency* latency = &toplevel->latency;
+
+  *stats = (struct zsurf_latency_stats){0};
+  stats->dropped = latency->dropped;
+  if (latency->count == 0) return;
+
+  stats->count = latency->count;
+  stats->min_ms = latency->min_ms;
+  stats->max_ms = latency->max_ms;
+  stats->mean_ms = (double)latency->total_ms / latency->count;
+  stats->p50_ms = zsurf_latency_percentile(latency, 50);
+  stats->p90_ms = zsurf_latency_percentile(latency, 90);
+  stats->p99_ms = zsurf_latency_percentile(latency, 99);
+}
+
+WL_EXPORT void
+zsurf_toplevel_reset_latency_stats(struct zsurf_toplevel* toplevel)
+{
+  struct zsurf_latency* latency = &toplevel->latency;
+
+  latency->count = 0;
+  latency->dropped = 0;
+  latency->total_ms = 0;
+  latency->min_ms = 0;
+  latency->max_ms = 0;
+  memset(latency->histogram, 0, sizeof latency->histogram);
+}
@@ -0,0 +1,296 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "internal.h"
+
+#define ZSURF_LOG_RING_SIZE 16384  // bytes per thread, power of two
+#define ZSURF_LOG_MESSAGE_MAX 512  // longer messages are truncated
+#define ZSURF_LOG_BURST 5          // messages per call site and second
+#define ZSURF_LOG_PADDING 0xff     // level of a record that fills the ring end
+
+struct zsurf_log_record {
+  uint32_t size;  // including this header, multiple of 8
+  uint32_t level;
+};
+
+struct zsurf_log_ring {
+  struct zsurf_log_ring* next;  // every ring ever created, never freed
+  uint64_t head;                // advanced by the owner thread
+  uint64_t tail;                // advanced by the flusher
+  uint64_t dropped;             // messages lost while the ring was full
+  char data[ZSURF_LOG_RING_SIZE];
+};
+
+int zsurf_log_current_level = ZSURF_LOG_LEVEL_INFO;
+
+static _Thread_local struct zsurf_log_ring* zsurf_log_thread_ring;
+static struct zsurf_log_ring* zsurf_log_ring_list;
+static uint64_t zsurf_log_pending;  // records written and not flushed yet
+
+static pthread_mutex_t zsurf_log_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static zsurf_log_sink_func_t zsurf_log_sink;  // NULL writes to stderr
+static void* zsurf_log_sink_data;
+
+static const char* zsurf_log_level_names[] = {
+    [ZSURF_LOG_LEVEL_ERROR] = "error",
+    [ZSURF_LOG_LEVEL_WARN] = "warn",
+    [ZSURF_LOG_LEVEL_INFO] = "info",
+    [ZSURF_LOG_LEVEL_DEBUG] = "debug",
+};
+
+static pthread_once_t zsurf_log_exit_once = PTHREAD_ONCE_INIT;
+
+static void
+zsurf_log_flush_at_exit(void)
+{
+  zsurf_log_flush();
+}
+
+static void
+zsurf_log_register_exit(void)
+{
+  atexit(zsurf_log_flush_at_exit);
+}
+
+static void
+zsurf_log_write_stderr(const char* data, size_t length)
+{
+  ssize_t ret = write(STDERR_FILENO, data, length);
+  UNUSED(ret);
+}
+
+static struct zsurf_log_ring*
+zsurf_log_ring_create(void)
+{
+  struct zsurf_log_ring* ring;
+
+  ring = zalloc(sizeof *ring);
+  if (ring == NULL) return NULL;
+
+  ring->next = __atomic_load_n(&zsurf_log_ring_list, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&zsurf_log_ring_list, &ring->next, ring,
+      true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+
+  zsurf_log_thread_ring = ring;
+
+  return ring;
+}
+
+/**
+ * Hand one message to the sink. The default sink batches every message into
+ * one write, the batch is written first when the message does not fit.
+ * call with zsurf_log_flush_lock held
+ */
+static void
+zsurf_log_output(enum zsurf_log_level level, const char* text, size_t length,
+    char* batch, size_t batch_size, size_t* batch_length)
+{
+  if (zsurf_log_sink) {
+    zsurf_log_sink(zsurf_log_sink_data, level, text, length);
+    return;
+  }
+
+  if (*batch_length + length > batch_size) {
+    zsurf_log_write_stderr(batch, *batch_length);
+    *batch_length = 0;
+  }
+  memcpy(batch + *batch_length, text, length);
+  *batch_length += length;
+}
+
+/**
+ * call with zsurf_log_flush_lock held
+ */
+static void
+zsurf_log_ring_drain(struct zsurf_log_ring* ring, char* batch,
+    size_t batch_size, size_t* batch_length)
+{
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = ring->tail;
+  struct zsurf_log_record* record;
+  const char* text;
+  uint32_t length;
+
+  while (tail < head) {
+    record = (void*)&ring->data[tail & (ZSURF_LOG_RING_SIZE - 1)];
+    tail += record->size;
+    if (record->level == ZSURF_LOG_PADDING) continue;
+
+    text = (const char*)(record + 1);
+    length = strnlen(text, record->size - sizeof *record);
+    zsurf_log_output(
+        record->level, text, length, batch, batch_size, batch_length);
+  }
+
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+WL_EXPORT void
+zsurf_log_flush(void)
+{
+  struct zsurf_log_ring* ring;
+  char batch[4096], notice[64];
+  size_t batch_length = 0;
+  uint64_t dropped;
+  int length;
+
+  if (__atomic_load_n(&zsurf_log_pending, __ATOMIC_RELAXED) == 0) return;
+
+  pthread_mutex_lock(&zsurf_log_flush_lock);
+  __atomic_store_n(&zsurf_log_pending, 0, __ATOMIC_RELAXED);
+
+  ring = __atomic_load_n(&zsurf_log_ring_list, __ATOMIC_ACQUIRE);
+  for (; ring; ring = ring->next) {
+    zsurf_log_ring_drain(ring, batch, sizeof batch, &batch_length);
+
+    dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    if (dropped == 0) continue;
+
+    length = snprintf(notice, sizeof notice,
+        "zsurface: %lu log messages dropped\n", (unsigned long)dropped);
+    zsurf_log_output(ZSURF_LOG_LEVEL_WARN, notice, length, batch,
+        sizeof batch, &batch_length);
+  }
+
+  if (batch_length > 0) zsurf_log_write_stderr(batch, batch_length);
+
+  pthread_mutex_unlock(&zsurf_log_flush_lock);
+}
+
+/**
+ * return false when the ring has no room for the record
+ */
+static bool
+zsurf_log_ring_push(struct zsurf_log_ring* ring, enum zsurf_log_level level,
+    const char* text, uint32_t length)
+{
+  struct zsurf_log_record* record;
+  uint32_t size = (sizeof *record + length + 1 + 7) & ~7u;
+  uint64_t head = ring->head;
+  uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  uint32_t offset = head & (ZSURF_LOG_RING_SIZE - 1);
+  uint32_t padding = 0;
+
+  // records are contiguous, skip the end of the ring if it is too short
+  if (offset + size > ZSURF_LOG_RING_SIZE)
+    padding = ZSURF_LOG_RING_SIZE - offset;
+
+  if (head + padding + size - tail > ZSURF_LOG_RING_SIZE) return false;
+
+  if (padding) {
+    record = (void*)&ring->data[offset];
+    record->size = padding;
+    record->level = ZSURF_LOG_PADDING;
+    head += padding;
+    offset = 0;
+  }
+
+  record = (void*)&ring->data[offset];
+  record->size = size;
+  record->level = level;
+  memcpy(record + 1, text, length);
+  ((char*)(record + 1))[length] = '\0';
+
+  __atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&zsurf_log_pending, 1, __ATOMIC_RELAXED);
+
+  return true;
+}
+
+/**
+ * return the number of messages suppressed before this one, -1 when this
+ * one is suppressed as well
+ */
+static int64_t
+zsurf_log_site_admit(struct zsurf_log_site* site)
+{
+  uint64_t now = zsurf_get_time_ns() / 1000000000;
+  uint64_t window = __atomic_load_n(&site->window, __ATOMIC_RELAXED);
+
+  if (window != now) {
+    __atomic_store_n(&site->window, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+  }
+
+  if (__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) >=
+      ZSURF_LOG_BURST) {
+    __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+
+  return __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+}
+
+void
+zsurf_log_write(struct zsurf_log_site* site, enum zsurf_log_level level,
+    const char* fmt, ...)
+{
+  struct zsurf_log_ring* ring = zsurf_log_thread_ring;
+  char message[ZSURF_LOG_MESSAGE_MAX];
+  int64_t suppressed;
+  va_list argp;
+  int length = 0;
+
+  suppressed = zsurf_log_site_admit(site);
+  if (suppressed < 0) return;
+
+  if (ring == NULL) {
+    ring = zsurf_log_ring_create();
+    if (ring == NULL) return;
+    pthread_once(&zsurf_log_exit_once, zsurf_log_register_exit);
+  }
+
+  if (suppressed > 0)
+    length = snprintf(message, sizeof message,
+        "zsurface: %ld similar %s messages suppressed\n", (long)suppressed,
+        zsurf_log_level_names[level]);
+
+  va_start(argp, fmt);
+  length += vsnprintf(message + length, sizeof message - length, fmt, argp);
+  va_end(argp);
+  if (length >= (int)sizeof message) length = sizeof message - 1;
+
+  if (!zsurf_log_ring_push(ring, level, message, length)) {
+    zsurf_log_flush();
+    if (!zsurf_log_ring_push(ring, level, message, length))
+      __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+  }
+
+  // errors are rare and often followed by a crash or an exit
+  if (level == ZSURF_LOG_LEVEL_ERROR ||
+      ring->head - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED) >
+          ZSURF_LOG_RING_SIZE / 2)
+    zsurf_log_flush();
+}
+
+WL_EXPORT void
+zsurf_log_set_level(enum zsurf_log_level level)
+{
+  __atomic_store_n(&zsurf_log_current_level, level, __ATOMIC_RELAXED);
+}
+
+WL_EXPORT void
+zsurf_log_set_sink(zsurf_log_sink_func_t sink, void* data)
+{
+  zsurf_log_flush();
+
+  pthread_mutex_lock(&zsurf_log_flush_lock);
+  zsurf_log_sink = sink;
+  zsurf_log_sink_data = data;
+  pthread_mutex_unlock(&zsurf_log_flush_lock);
+}
+
+__attribute__((constructor)) static void
+zsurf_log_init_from_env(void)
+{
+  const char* name = getenv("ZSURFACE_LOG_LEVEL");
+
+  if (name == NULL) return;
+
+  for (int i = ZSURF_LOG_LEVEL_ERROR; i <= ZSURF_LOG_LEVEL_DEBUG; i++) {
+    if (strcmp(name, zsurf_log_level_names[i]) == 0) zsurf_log_set_level(i);
+  }
+}
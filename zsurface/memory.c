@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+static void
+zsurf_memory_stats_add(struct zsurf_memory_stats* stats,
+    const struct zsurf_memory_stats* delta, int sign)
+{
+  stats->reserved_bytes += sign * delta->reserved_bytes;
+  stats->used_bytes += sign * delta->used_bytes;
+  stats->in_flight_bytes += sign * delta->in_flight_bytes;
+}
+
+void
+zsurf_view_memory_update(struct zsurf_view* view)
+{
+  struct zsurf_display* surface_display = view->surface_display;
+  struct zsurf_memory_stats* stats = &view->memory.stats;
+  uint64_t capacity = view->texture_capacity;
+  uint64_t texture =
+      (uint64_t)view->texture_stride * view->texture_height;
+
+  zsurf_memory_stats_add(&surface_display->memory.stats, stats, -1);
+
+  stats->reserved_bytes =
+      view->shm_size - (view->memory.dropped ? capacity : 0);
+  stats->used_bytes =
+      sizeof *view->vertex_data + (view->memory.dropped ? 0 : texture);
+  stats->in_flight_bytes = view->memory.texture_busy ? texture : 0;
+
+  zsurf_memory_stats_add(&surface_display->memory.stats, stats, +1);
+}
+
+void
+zsurf_view_memory_forget(struct zsurf_view* view)
+{
+  zsurf_memory_stats_add(
+      &view->surface_display->memory.stats, &view->memory.stats, -1);
+  view->memory.stats = (struct zsurf_memory_stats){0};
+}
+
+/**
+ * return the number of bytes handed back to the kernel
+ */
+static uint64_t
+zsurf_view_memory_drop(struct zsurf_view* view)
+{
+  uint64_t reserved = view->memory.stats.reserved_bytes;
+  off_t length = view->texture_capacity;
+
+  // the mapping and the pool stay, the pages come back on the next write
+  if (fallocate(view->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+          sizeof *view->vertex_data, length) != 0)
+    return 0;
+
+  view->memory.dropped = true;
+  zsurf_view_memory_update(view);
+
+  return reserved - view->memory.stats.reserved_bytes;
+}
+
+/**
+ * pooled views, and views that neither drew nor asked for a frame lately,
+ * whose texture the compositor is done with. Views drawn in place are never
+ * idle, their next update builds on the current contents.
+ */
+static bool
+zsurf_view_memory_idle(struct zsurf_view* view, uint64_t now)
+{
+  if (view->memory.dropped || view->memory.texture_busy) return false;
+  if (!wl_list_empty(&view->pool_link)) return true;
+  if (view->memory.in_place) return false;
+  return now - view->memory.active_ns > ZSURF_MEMORY_IDLE_NS;
+}
+
+static uint64_t
+zsurf_display_reclaim_memory_to(
+    struct zsurf_display* surface_display, uint64_t target)
+{
+  struct zsurf_view* view;
+  uint64_t now = zsurf_get_time_ns(), reclaimed = 0;
+
+  wl_list_for_each(view, &surface_display->memory.view_list, memory.link)
+  {
+    if (surface_display->memory.stats.reserved_bytes <= target) break;
+    if (zsurf_view_memory_idle(view, now))
+      reclaimed += zsurf_view_memory_drop(view);
+  }
+
+  return reclaimed;
+}
+
+void
+zsurf_display_check_memory_budget(struct zsurf_display* surface_display)
+{
+  uint64_t budget = surface_display->memory.budget;
+
+  if (budget == 0) return;
+
+  if (surface_display->memory.stats.reserved_bytes > budget)
+    zsurf_display_reclaim_memory_to(surface_display, budget);
+
+  if (surface_display->memory.stats.reserved_bytes <= budget) {
+    surface_display->memory.over_budget = false;
+    return;
+  }
+
+  // report once per crossing, not on every resize above the budget
+  if (surface_display->memory.over_budget) return;
+  surface_display->memory.over_budget = true;
+
+  if (surface_display->interaface->memory_budget_exceeded)
+    surface_display->interaface->memory_budget_exceeded(
+        surface_display->user_data,
+        surface_display->memory.stats.reserved_bytes, budget);
+}
+
+WL_EXPORT void
+zsurf_view_get_memory_stats(
+    struct zsurf_view* view, struct zsurf_memory_stats* stats)
+{
+  *stats = view->memory.stats;
+}
+
+WL_EXPORT void
+zsurf_display_get_memory_stats(
+    struct zsurf_display* surface_display, struct zsurf_memory_stats* stats)
+{
+  *stats = surface_display->memory.stats;
+}
+
+WL_EXPORT void
+zsurf_display_set_memory_budget(
+    struct zsurf_display* surface_display, uint64_t budget_bytes)
+{
+  surface_display->memory.budget = budget_bytes;
+  surface_display->memory.over_budget = false;
+  zsurf_display_check_memory_budget(surface_display);
+}
+
+WL_EXPORT uint64_t
+zsurf_display_reclaim_memory(struct zsurf_display* surface_display)
+{
+  return zsurf_display_reclaim_memory_to(surface_display, 0);
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define ZSURF_RECORD_BUFFER_SIZE 65536
+
+struct zsurf_recorder {
+  FILE* file;
+  uint64_t start_ns;
+  bool failed;
+};
+
+static bool zsurf_record_env_taken;
+
+void
+zsurf_recorder_append(struct zsurf_recorder* recorder,
+    enum zsurf_record_type type, uint32_t id, const void* payload,
+    uint16_t size)
+{
+  struct zsurf_record_header header = {
+      .time_ns = zsurf_get_time_ns() - recorder->start_ns,
+      .type = type,
+      .size = size,
+      .id = id,
+  };
+
+  if (recorder->failed) return;
+
+  if (fwrite(&header, sizeof header, 1, recorder->file) != 1 ||
+      (size > 0 && fwrite(payload, size, 1, recorder->file) != 1)) {
+    zsurf_log_error("zsurface: failed to write the recording, stopped\n");
+    recorder->failed = true;
+  }
+}
+
+WL_EXPORT int
+zsurf_display_record_start(
+    struct zsurf_display* surface_display, const char* path)
+{
+  struct zsurf_record_file_header file_header = {
+      .magic = ZSURF_RECORD_MAGIC,
+      .version = ZSURF_RECORD_VERSION,
+  };
+  struct zsurf_recorder* recorder;
+
+  zsurf_display_record_stop(surface_display);
+
+  recorder = zalloc(sizeof *recorder);
+  if (recorder == NULL) goto err;
+
+  recorder->file = fopen(path, "w");
+  if (recorder->file == NULL) goto err_file;
+
+  setvbuf(recorder->file, NULL, _IOFBF, ZSURF_RECORD_BUFFER_SIZE);
+
+  if (fwrite(&file_header, sizeof file_header, 1, recorder->file) != 1)
+    goto err_header;
+
+  recorder->start_ns = zsurf_get_time_ns();
+  surface_display->recorder = recorder;
+
+  return 0;
+
+err_header:
+  fclose(recorder->file);
+
+err_file:
+  free(recorder);
+
+err:
+  return -1;
+}
+
+WL_EXPORT void
+zsurf_display_record_stop(struct zsurf_display* surface_display)
+{
+  struct zsurf_recorder* recorder = surface_display->recorder;
+
+  if (recorder == NULL) return;
+
+  if (fclose(recorder->file) != 0 && !recorder->failed)
+    zsurf_log_error("zsurface: failed to write the recording\n");
+  free(recorder);
+  surface_display->recorder = NULL;
+}
+
+void
+zsurf_record_init_from_env(struct zsurf_display* surface_display)
+{
+  const char* path = getenv("ZSURFACE_RECORD");
+
+  if (path == NULL || path[0] == '\0') return;
+
+  // one file cannot hold several connections, the first display wins
+  if (__atomic_exchange_n(&zsurf_record_env_taken, true, __ATOMIC_RELAXED))
+    return;
+
+  if (zsurf_display_record_start(surface_display, path) != 0)
+    zsurf_log_error("zsurface: failed to open %s for recording\n", path);
+}
@@ -0,0 +1,92 @@
+#include <math.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define ZSURF_RESOLUTION_SETTLE_FRAMES 16  // measured before each decision
+#define ZSURF_RESOLUTION_OVER 1.05f        // of the target, scale down above
+#define ZSURF_RESOLUTION_UNDER 0.75f       // of the target, scale up below
+#define ZSURF_RESOLUTION_AIM 0.9f          // of the target, after a change
+#define ZSURF_RESOLUTION_MAX_UP 1.25f      // per change, down is not limited
+#define ZSURF_RESOLUTION_MIN_CHANGE 0.02f  // smaller changes are not made
+
+void
+zsurf_resolution_init(struct zsurf_resolution* resolution)
+{
+  resolution->target_ns = 0;
+  resolution->min_scale = 1.0f;
+  resolution->scale = 1.0f;
+  resolution->frame_ns = 0;
+  resolution->average_ns = 0;
+  resolution->frames = 0;
+  resolution->changes = 0;
+}
+
+void
+zsurf_resolution_sample(struct zsurf_resolution* resolution, uint64_t ns)
+{
+  float ratio, scale;
+
+  if (resolution->target_ns == 0) return;
+
+  resolution->average_ns = resolution->frames == 0
+                               ? ns
+                               : (resolution->average_ns * 7 + ns) / 8;
+  if (++resolution->frames < ZSURF_RESOLUTION_SETTLE_FRAMES) return;
+
+  // render time follows the pixel count, the square of the scale
+  ratio = (float)resolution->target_ns / resolution->average_ns;
+  if (ratio < 1.0f / ZSURF_RESOLUTION_OVER) {
+    scale = resolution->scale * sqrtf(ratio * ZSURF_RESOLUTION_AIM);
+  } else if (ratio > 1.0f / ZSURF_RESOLUTION_UNDER) {
+    scale = resolution->scale * sqrtf(ratio * ZSURF_RESOLUTION_AIM);
+    if (scale > resolution->scale * ZSURF_RESOLUTION_MAX_UP)
+      scale = resolution->scale * ZSURF_RESOLUTION_MAX_UP;
+  } else {
+    return;
+  }
+
+  scale = glm_clamp(scale, resolution->min_scale, 1.0f);
+  if (fabsf(scale - resolution->scale) < ZSURF_RESOLUTION_MIN_CHANGE) return;
+
+  // frames of the old size say nothing about the new one
+  resolution->scale = scale;
+  resolution->frames = 0;
+  resolution->changes++;
+}
+
+void
+zsurf_resolution_frame(struct zsurf_resolution* resolution)
+{
+  if (resolution->target_ns == 0 || resolution->frame_ns != 0) return;
+  resolution->frame_ns = zsurf_get_time_ns();
+}
+
+void
+zsurf_resolution_commit(struct zsurf_resolution* resolution)
+{
+  if (resolution->frame_ns == 0) return;
+  zsurf_resolution_sample(
+      resolution, zsurf_get_time_ns() - resolution->frame_ns);
+  resolution->frame_ns = 0;
+}
+
+WL_EXPORT void
+zsurf_toplevel_set_adaptive_resolution(
+    struct zsurf_toplevel* toplevel, uint32_t target_us, float min_scale)
+{
+  struct zsurf_resolution* resolution = &toplevel->resolution;
+
+  resolution->target_ns = (uint64_t)target_us * 1000;
+  resolution->min_scale = glm_clamp(min_scale, 0.01f, 1.0f);
+  resolution->frame_ns = 0;
+  resolution->frames = 0;
+  if (resolution->target_ns == 0) resolution->scale = 1.0f;
+  resolution->scale = glm_clamp(resolution->scale, resolution->min_scale, 1.0f);
+}
+
+WL_EXPORT float
+zsurf_toplevel_get_resolution_scale(struct zsurf_toplevel* toplevel)
+{
+  return toplevel->resolution.scale;
+}
@@ -0,0 +1,224 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#define ZSURF_THROTTLE_MAX_GAP_NS 250000000  // longer gaps are app pauses
+
+static bool
+zsurf_throttle_active(
+    struct zsurf_display* surface_display, struct zsurf_toplevel* toplevel)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+
+  return toplevel == surface_display->focus_toplevel ||
+         zsurf_get_time_ns() - toplevel->activity.input_ns < throttle->idle_ns;
+}
+
+/**
+ * arm the timer to the earliest deadline, a syscall only if it changed
+ */
+static void
+zsurf_throttle_arm(struct zsurf_throttle* throttle)
+{
+  struct itimerspec its = {0};
+  struct zsurf_view_callback_data* first;
+  uint64_t deadline_ns = 0;
+
+  if (!wl_list_empty(&throttle->deferred_list)) {
+    first = wl_container_of(throttle->deferred_list.next, first, link);
+    deadline_ns = first->deadline_ns;
+  }
+
+  if (deadline_ns == throttle->armed_ns) return;
+  throttle->armed_ns = deadline_ns;
+
+  its.it_value.tv_sec = deadline_ns / 1000000000;
+  its.it_value.tv_nsec = deadline_ns % 1000000000;
+  timerfd_settime(throttle->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void
+zsurf_throttle_deliver(struct zsurf_view_callback_data* callback_data)
+{
+  uint64_t held_ns = zsurf_get_time_ns() - callback_data->deferred_ns;
+
+  wl_list_remove(&callback_data->link);
+
+  // the frame is shown later than the compositor said, tell the truth
+  zsurf_view_frame_callback_deliver(
+      callback_data, callback_data->callback_time + held_ns / 1000000);
+}
+
+int
+zsurf_throttle_init(struct zsurf_throttle* throttle)
+{
+  throttle->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (throttle->fd < 0) return -1;
+
+  throttle->idle_ns = 0;
+  throttle->fraction = 1.0f;
+  throttle->armed_ns = 0;
+  wl_list_init(&throttle->deferred_list);
+
+  return 0;
+}
+
+void
+zsurf_throttle_fini(struct zsurf_display* surface_display)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+
+  wl_list_insert_list(
+      &surface_display->frame_callback_pool, &throttle->deferred_list);
+  wl_list_init(&throttle->deferred_list);
+  close(throttle->fd);
+}
+
+bool
+zsurf_throttle_defer(struct zsurf_display* surface_display,
+    struct zsurf_view_callback_data* callback_data, uint32_t callback_time)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+  struct zsurf_toplevel* toplevel = callback_data->toplevel;
+  struct zsurf_view_callback_data* other;
+  uint64_t now = zsurf_get_time_ns(), gap, delay;
+  bool active;
+
+  if (toplevel == NULL) return false;
+
+  active = throttle->fraction >= 1.0f ||
+           zsurf_throttle_active(surface_display, toplevel);
+
+  // the compositor's frame interval, as seen while frames are not held back
+  gap = now - toplevel->activity.last_done_ns;
+  toplevel->activity.last_done_ns = now;
+  if (active && gap > 0 && gap < ZSURF_THROTTLE_MAX_GAP_NS)
+    toplevel->activity.interval_ns =
+        (toplevel->activity.interval_ns * 7 + gap) / 8;
+
+  if (active) return false;
+
+  delay = toplevel->activity.interval_ns * (1.0f / throttle->fraction - 1.0f);
+
+  callback_data->callback_time = callback_time;
+  callback_data->deferred_ns = now;
+  callback_data->deadline_ns = now + delay;
+
+  // keep the list sorted by deadline, new entries usually go last
+  wl_list_for_each_reverse(other, &throttle->deferred_list, link)
+  {
+    if (other->deadline_ns <= callback_data->deadline_ns) break;
+  }
+  wl_list_insert(&other->link, &callback_data->link);
+
+  if (throttle->deferred_list.next == &callback_data->link)
+    zsurf_throttle_arm(throttle);
+
+  return true;
+}
+
+void
+zsurf_throttle_dispatch(struct zsurf_display* surface_display)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+  struct zsurf_view_callback_data* callback_data;
+  uint64_t expirations, now;
+
+  // disarming resets the timer, no expiration is pending while disarmed
+  if (throttle->armed_ns == 0) return;
+
+  if (read(throttle->fd, &expirations, sizeof expirations) !=
+      sizeof expirations)
+    return;
+
+  // the timer is one-shot, it is disarmed once it expired
+  throttle->armed_ns = 0;
+
+  now = zsurf_get_time_ns();
+  while (!wl_list_empty(&throttle->deferred_list)) {
+    callback_data =
+        wl_container_of(throttle->deferred_list.next, callback_data, link);
+    if (callback_data->deadline_ns > now) break;
+    zsurf_throttle_deliver(callback_data);
+  }
+
+  zsurf_throttle_arm(throttle);
+}
+
+void
+zsurf_throttle_input(
+    struct zsurf_display* surface_display, struct zsurf_toplevel* toplevel)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+  struct zsurf_view_callback_data* callback_data;
+  bool found;
+
+  toplevel->activity.input_ns = zsurf_get_time_ns();
+
+  // every input comes here, nothing to do unless frames are held back
+  if (wl_list_empty(&throttle->deferred_list)) return;
+
+  // the user may change the list from a frame callback, look again each time
+  do {
+    found = false;
+    wl_list_for_each(callback_data, &throttle->deferred_list, link)
+    {
+      if (callback_data->toplevel == toplevel) {
+        found = true;
+        break;
+      }
+    }
+    if (found) zsurf_throttle_deliver(callback_data);
+  } while (found);
+
+  zsurf_throttle_arm(throttle);
+}
+
+void
+zsurf_throttle_forget(
+    struct zsurf_display* surface_display, struct zsurf_toplevel* toplevel)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+  struct zsurf_view_callback_data *callback_data, *tmp;
+
+  wl_list_for_each_safe(callback_data, tmp, &throttle->deferred_list, link)
+  {
+    if (callback_data->toplevel != toplevel) continue;
+    wl_list_remove(&callback_data->link);
+    wl_list_insert(
+        &surface_display->frame_callback_pool, &callback_data->link);
+  }
+
+  // frames still on their way are delivered without the toplevel
+  wl_list_for_each_safe(
+      callback_data, tmp, &toplevel->activity.frame_list, link)
+  {
+    callback_data->toplevel = NULL;
+    wl_list_remove(&callback_data->link);
+    wl_list_init(&callback_data->link);
+  }
+
+  zsurf_throttle_arm(throttle);
+}
+
+WL_EXPORT void
+zsurf_display_set_idle_throttle(
+    struct zsurf_display* surface_display, uint32_t idle_ms, float fraction)
+{
+  struct zsurf_throttle* throttle = &surface_display->throttle;
+  struct zsurf_view_callback_data* callback_data;
+
+  throttle->idle_ns = (uint64_t)idle_ms * 1000000;
+  throttle->fraction = fraction > 0.0f ? fraction : 1.0f;
+
+  if (throttle->fraction < 1.0f) return;
+
+  while (!wl_list_empty(&throttle->deferred_list)) {
+    callback_data =
+        wl_container_of(throttle->deferred_list.next, callback_data, link);
+    zsurf_throttle_deliver(callback_data);
+  }
+  zsurf_throttle_arm(throttle);
+}
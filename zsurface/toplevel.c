@@ -13,10 +13,20 @@ cuboid_window_configure(void* data, struct zgn_cuboid_window* cuboid_window,
 {
   struct zsurf_toplevel* toplevel = data;
 
+  if (toplevel->surface_display->recorder) {
+    union zsurf_record_word payload[8] = {{.u = serial}};
+    if (cuboid_half_size->size == sizeof(float) * 3)
+      memcpy(&payload[1], cuboid_half_size->data, sizeof(float) * 3);
+    if (quaternion_array->size == sizeof(float) * 4)
+      memcpy(&payload[4], quaternion_array->data, sizeof(float) * 4);
+    zsurf_record(toplevel->surface_display, ZSURF_RECORD_CONFIGURE,
+        toplevel->record_id, payload, sizeof payload);
+  }
+
   // FIXME: ack_configure should be called by users.
   zgn_cuboid_window_ack_configure(cuboid_window, serial);
   if (cuboid_half_size->size != sizeof(float) * 3) {
-    zsurf_log(
+    zsurf_log_warn(
         "zsurface: cuboid window half_size was given with invalid size\n");
     return;
   }
@@ -30,7 +40,7 @@ cuboid_window_configure(void* data, struct zgn_cuboid_window* cuboid_window,
   }
 
   if (glm_versor_from_wl_array(toplevel->quaternion, quaternion_array) != 0) {
-    zsurf_log(
+    zsurf_log_warn(
         "zsurface: cuboid window quaternion was given with invalid size\n");
     return;
   }
@@ -38,28 +48,31 @@ cuboid_window_configure(void* data, struct zgn_cuboid_window* cuboid_window,
   zsurf_view_update_space_geom(toplevel->view);
 
   zgn_virtual_object_commit(toplevel->virtual_object);
+  zsurf_atlas_commit(toplevel);
 }
 
 static void
 cuboid_window_moved(void* data, struct zgn_cuboid_window* cuboid_window,
     struct wl_array* face_direction_array)
 {
-  UNUSED(data);
+  struct zsurf_toplevel* toplevel = data;
   vec3 face_direction, front = {0.0f, 0.0f, 1.0f};
   versor quaternion;
   struct wl_array quaternion_array;
 
   glm_vec3_from_wl_array(face_direction, face_direction_array);
+
+  zsurf_record(toplevel->surface_display, ZSURF_RECORD_MOVED,
+      toplevel->record_id, face_direction, sizeof(vec3));
   glm_quat_from_vecs(front, face_direction, quaternion);
 
-  wl_array_init(&quaternion_array);
-  glm_versor_to_wl_array(quaternion, &quaternion_array);
+  glm_versor_as_wl_array(quaternion, &quaternion_array);
 
   zgn_cuboid_window_rotate(cuboid_window, &quaternion_array);
-  wl_array_release(&quaternion_array);
 }
 
-static const struct zgn_cuboid_window_listener cuboid_window_listener = {
+const struct zgn_cuboid_window_listener
+    zsurf_toplevel_cuboid_window_listener = {
     .configure = cuboid_window_configure,
     .moved = cuboid_window_moved,
 };
@@ -73,10 +86,8 @@ view_commit_handler(struct zsurf_listener* listener, void* data)
 
   if (toplevel->view->state == ZSURF_VIEW_STATE_FIRST_TEXTURE_ATTACHED) {
     struct wl_array half_size, quaternion_array;
-    wl_array_init(&half_size);
-    wl_array_init(&quaternion_array);
+    vec3 half_size_vec;
 
-    float* half_size_vec = wl_array_add(&half_size, sizeof(float) * 3);
     half_size_vec[0] =
         (float)toplevel->view->surface_geometry.width / 2.0f / PIXEL_SCALE +
         FRAME_PADDING;
@@ -85,20 +96,22 @@ view_commit_handler(struct zsurf_listener* listener, void* data)
         FRAME_PADDING;
     half_size_vec[2] = SURFACE_THICKNESS;
 
-    glm_versor_to_wl_array(toplevel->quaternion, &quaternion_array);
+    glm_vec3_as_wl_array(half_size_vec, &half_size);
+    glm_versor_as_wl_array(toplevel->quaternion, &quaternion_array);
 
     toplevel->cuboid_window =
         zgn_shell_get_cuboid_window(toplevel->surface_display->shell,
             toplevel->virtual_object, &half_size, &quaternion_array);
 
     zgn_cuboid_window_add_listener(
-        toplevel->cuboid_window, &cuboid_window_listener, toplevel);
-
-    wl_array_release(&half_size);
-    wl_array_release(&quaternion_array);
+        toplevel->cuboid_window, &zsurf_toplevel_cuboid_window_listener,
+        toplevel);
   }
 
+  zsurf_resolution_commit(&toplevel->resolution);
+  zsurf_latency_commit(&toplevel->latency, toplevel->virtual_object);
   zgn_virtual_object_commit(toplevel->virtual_object);
+  zsurf_atlas_commit(toplevel);
 
   if (toplevel->view->state != ZSURF_VIEW_STATE_NO_TEXTURE)
     toplevel->view->state = ZSURF_VIEW_STATE_TEXTURE_COMMITTED;
@@ -110,13 +123,17 @@ zsurf_toplevel_pick_view(struct zsurf_toplevel* toplevel, vec3 ray_origin,
 {
   vec3 rotated_ray_origin, rotated_ray_direction;
   versor quat_inv;
+  uint64_t trace = zsurf_trace_begin();
   glm_quat_inv(toplevel->quaternion, quat_inv);
   glm_quat_rotatev(quat_inv, ray_origin, rotated_ray_origin);
   glm_quat_rotatev(quat_inv, ray_direction, rotated_ray_direction);
 
   float mul = -rotated_ray_origin[2] / rotated_ray_direction[2];
   struct zsurf_view* view = toplevel->view;
-  if (mul <= 0) return NULL;
+  if (mul <= 0) {
+    zsurf_trace_end(ZSURF_TRACE_PICK, trace, 0);
+    return NULL;
+  }
 
   float x = rotated_ray_origin[0] + rotated_ray_direction[0] * mul;
   float y = rotated_ray_origin[1] + rotated_ray_direction[1] * mul;
@@ -125,13 +142,22 @@ zsurf_toplevel_pick_view(struct zsurf_toplevel* toplevel, vec3 ray_origin,
   float h0 = view->space_geometry.center[1] - view->space_geometry.half_size[1];
   float h1 = view->space_geometry.center[1] + view->space_geometry.half_size[1];
   if (w0 < x && x < w1 && h0 < y && y < h1) {
-    local_coord[0] = (x - w0) * view->surface_geometry.width / (w1 - w0);
-    local_coord[1] = (h1 - y) * view->surface_geometry.height / (h1 - h0);
+    zsurf_view_local_coord(
+        view, (x - w0) / (w1 - w0), (h1 - y) / (h1 - h0), local_coord);
+    zsurf_trace_end(ZSURF_TRACE_PICK, trace, 0);
     return toplevel->view;
   }
+  zsurf_trace_end(ZSURF_TRACE_PICK, trace, 0);
   return NULL;
 }
 
+void
+zsurf_toplevel_input(struct zsurf_toplevel* toplevel, uint32_t time)
+{
+  zsurf_latency_input(&toplevel->latency, time);
+  zsurf_throttle_input(toplevel->surface_display, toplevel);
+}
+
 WL_EXPORT struct zsurf_view*
 zsurf_toplevel_get_view(struct zsurf_toplevel* topelevel)
 {
@@ -141,29 +167,28 @@ zsurf_toplevel_get_view(struct zsurf_toplevel* topelevel)
 WL_EXPORT void
 zsurf_toplevel_move(struct zsurf_toplevel* toplevel, uint32_t serial)
 {
+  zsurf_record(toplevel->surface_display, ZSURF_RECORD_TOPLEVEL_MOVE,
+      toplevel->record_id, &serial, sizeof serial);
+
   if (toplevel->cuboid_window)
     zgn_cuboid_window_move(
         toplevel->cuboid_window, toplevel->surface_display->seat, serial);
 }
 
-WL_EXPORT struct zsurf_toplevel*
-zsurf_toplevel_create(
-    struct zsurf_display* surface_display, void* view_user_data)
+/**
+ * create the virtual object and the view, once the display is ready
+ */
+static int
+zsurf_toplevel_bind(struct zsurf_toplevel* toplevel, void* view_user_data)
 {
-  struct zsurf_toplevel* toplevel;
+  struct zsurf_display* surface_display = toplevel->surface_display;
   struct zsurf_view* view;
   struct zgn_virtual_object* virtual_object;
 
-  toplevel = zalloc(sizeof *toplevel);
-  if (toplevel == NULL) goto err;
-
   virtual_object =
       zgn_compositor_create_virtual_object(surface_display->compositor);
   zgn_virtual_object_set_user_data(virtual_object, toplevel);
-
-  toplevel->surface_display = surface_display;
   toplevel->virtual_object = virtual_object;
-  toplevel->cuboid_window = NULL;
 
   view = zsurf_view_create(surface_display, toplevel, NULL, view_user_data);
   if (view == NULL) goto err_view;
@@ -171,17 +196,83 @@ zsurf_toplevel_create(
   toplevel->view_commit_listener.notify = view_commit_handler;
   zsurf_signal_add(&view->commit_signal, &toplevel->view_commit_listener);
 
+  toplevel->view = view;
+
+  return 0;
+
+err_view:
+  zgn_virtual_object_destroy(virtual_object);
+  toplevel->virtual_object = NULL;
+
+  return -1;
+}
+
+int
+zsurf_toplevel_bind_queued(struct zsurf_display* surface_display)
+{
+  struct zsurf_toplevel *toplevel, *tmp;
+  int ret = 0;
+
+  wl_list_for_each_safe(
+      toplevel, tmp, &surface_display->startup.toplevel_list, queue_link)
+  {
+    wl_list_remove(&toplevel->queue_link);
+    wl_list_init(&toplevel->queue_link);
+
+    if (zsurf_toplevel_bind(toplevel, toplevel->view_user_data) != 0) {
+      zsurf_log_error("zsurface: failed to build a queued toplevel\n");
+      ret = -1;
+    }
+  }
+
+  return ret;
+}
+
+WL_EXPORT struct zsurf_toplevel*
+zsurf_toplevel_create(
+    struct zsurf_display* surface_display, void* view_user_data)
+{
+  struct zsurf_toplevel* toplevel;
+
+  toplevel = zalloc(sizeof *toplevel);
+  if (toplevel == NULL) goto err;
+
+  toplevel->surface_display = surface_display;
+  toplevel->view = NULL;
+  toplevel->virtual_object = NULL;
+  toplevel->cuboid_window = NULL;
+  toplevel->view_user_data = view_user_data;
+  wl_list_init(&toplevel->queue_link);
+
   zsurf_signal_init(&toplevel->destroy_signal);
 
   glm_vec2_zero(toplevel->toplevel_view_half_size);
   glm_quat_identity(toplevel->quaternion);
 
-  toplevel->view = view;
+  zsurf_latency_init(&toplevel->latency);
+  zsurf_resolution_init(&toplevel->resolution);
+
+  toplevel->activity.input_ns = zsurf_get_time_ns();
+  toplevel->activity.last_done_ns = 0;
+  toplevel->activity.interval_ns = ZSURF_THROTTLE_DEFAULT_INTERVAL_NS;
+  wl_list_init(&toplevel->activity.frame_list);
+
+  // built when the startup of an async display is done
+  if (!surface_display->ready) {
+    wl_list_insert(
+        surface_display->startup.toplevel_list.prev, &toplevel->queue_link);
+  } else if (zsurf_toplevel_bind(toplevel, view_user_data) != 0) {
+    goto err_bind;
+  }
+
+  toplevel->record_id = ++surface_display->record_next_id;
+  zsurf_record(surface_display, ZSURF_RECORD_TOPLEVEL_CREATE,
+      toplevel->record_id, NULL, 0);
 
   return toplevel;
 
-err_view:
-  zgn_virtual_object_destroy(virtual_object);
+err_bind:
+  zsurf_latency_fini(&toplevel->latency);
   free(toplevel);
 
 err:
@@ -191,10 +282,20 @@ err:
 WL_EXPORT void
 zsurf_toplevel_destroy(struct zsurf_toplevel* toplevel)
 {
+  struct zsurf_display* surface_display = toplevel->surface_display;
+
+  if (surface_display)
+    zsurf_record(surface_display, ZSURF_RECORD_TOPLEVEL_DESTROY,
+        toplevel->record_id, NULL, 0);
+
   zsurf_signal_emit(&toplevel->destroy_signal, NULL);
-  zsurf_view_destroy(toplevel->view);
+  if (surface_display) zsurf_throttle_forget(surface_display, toplevel);
+  wl_list_remove(&toplevel->queue_link);
+  if (toplevel->view) zsurf_view_destroy(toplevel->view);
+  zsurf_latency_fini(&toplevel->latency);
   if (toplevel->cuboid_window)
     zgn_cuboid_window_destroy(toplevel->cuboid_window);
-  zgn_virtual_object_destroy(toplevel->virtual_object);
+  if (toplevel->virtual_object)
+    zgn_virtual_object_destroy(toplevel->virtual_object);
   free(toplevel);
 }
@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zsurface.h>
+
+#include "internal.h"
+
+#if ZSURF_TRACE
+
+#define ZSURF_TRACE_RING_SIZE 8192  // records per thread, power of two
+
+struct zsurf_trace_record {
+  uint64_t seq;  // index + 1 once written, 0 while being written
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint64_t arg;
+  uint64_t event;
+};
+
+struct zsurf_trace_ring {
+  struct zsurf_trace_ring* next;  // every ring ever created, never freed
+  pid_t tid;
+  uint64_t head;  // written by the owner thread only
+  struct zsurf_trace_record records[ZSURF_TRACE_RING_SIZE];
+};
+
+static const struct {
+  const char* name;
+  const char* arg;  // NULL if the event has no argument
+} zsurf_trace_events[ZSURF_TRACE_EVENT_COUNT] = {
+    [ZSURF_TRACE_COMMIT] = {"commit", NULL},
+    [ZSURF_TRACE_TEXTURE_COPY] = {"set_texture_copy", "bytes"},
+    [ZSURF_TRACE_RESIZE] = {"resize", "pixels"},
+    [ZSURF_TRACE_GEOMETRY] = {"update_space_geom", NULL},
+    [ZSURF_TRACE_FRAME_CALLBACK] = {"frame_callback", "callback_time"},
+    [ZSURF_TRACE_RAY_MOTION] = {"ray_motion", NULL},
+    [ZSURF_TRACE_RAY_BUTTON] = {"ray_button", "button"},
+    [ZSURF_TRACE_KEY] = {"keyboard_key", "key"},
+    [ZSURF_TRACE_PICK] = {"pick_view", NULL},
+    [ZSURF_TRACE_INPUT_LATENCY] = {"input_to_present", "latency_ms"},
+};
+
+bool zsurf_trace_enabled;
+
+static _Thread_local struct zsurf_trace_ring* zsurf_trace_thread_ring;
+static struct zsurf_trace_ring* zsurf_trace_ring_list;
+static const char* zsurf_trace_exit_path;
+
+static struct zsurf_trace_ring*
+zsurf_trace_ring_create(void)
+{
+  struct zsurf_trace_ring* ring;
+
+  ring = zalloc(sizeof *ring);
+  if (ring == NULL) return NULL;
+
+  ring->tid = syscall(SYS_gettid);
+
+  ring->next = __atomic_load_n(&zsurf_trace_ring_list, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&zsurf_trace_ring_list, &ring->next,
+      ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+
+  zsurf_trace_thread_ring = ring;
+
+  return ring;
+}
+
+void
+zsurf_trace_record(enum zsurf_trace_event event, uint64_t start_ns,
+    uint64_t end_ns, uint64_t arg)
+{
+  struct zsurf_trace_ring* ring = zsurf_trace_thread_ring;
+  struct zsurf_trace_record* record;
+  uint64_t index;
+
+  if (ring == NULL) ring = zsurf_trace_ring_create();
+  if (ring == NULL) return;
+
+  index = ring->head;
+  record = &ring->records[index & (ZSURF_TRACE_RING_SIZE - 1)];
+
+  // seqlock: a reader that sees the same seq before and after copying the
+  // record got a consistent one
+  __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&record->start_ns, start_ns, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->end_ns, end_ns, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->arg, arg, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->event, event, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->seq, index + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, index + 1, __ATOMIC_RELEASE);
+}
+
+static bool
+zsurf_trace_read(struct zsurf_trace_record* record,
+    struct zsurf_trace_record* out, uint64_t index)
+{
+  uint64_t seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+
+  if (seq != index + 1) return false;
+
+  out->start_ns = __atomic_load_n(&record->start_ns, __ATOMIC_RELAXED);
+  out->end_ns = __atomic_load_n(&record->end_ns, __ATOMIC_RELAXED);
+  out->arg = __atomic_load_n(&record->arg, __ATOMIC_RELAXED);
+  out->event = __atomic_load_n(&record->event, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  return __atomic_load_n(&record->seq, __ATOMIC_RELAXED) == seq &&
+         out->event < ZSURF_TRACE_EVENT_COUNT;
+}
+
+static void
+zsurf_trace_write_ring(
+    FILE* file, struct zsurf_trace_ring* ring, pid_t pid, bool* first)
+{
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = head > ZSURF_TRACE_RING_SIZE ? head - ZSURF_TRACE_RING_SIZE
+                                               : 0;
+  struct zsurf_trace_record record;
+
+  for (uint64_t i = tail; i < head; i++) {
+    if (!zsurf_trace_read(&ring->records[i & (ZSURF_TRACE_RING_SIZE - 1)],
+            &record, i))
+      continue;  // overwritten while dumping
+
+    fprintf(file,
+        "%s\n{\"name\": \"%s\", \"cat\": \"zsurface\", \"ph\": \"X\", "
+        "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d",
+        *first ? "" : ",", zsurf_trace_events[record.event].name,
+        record.start_ns / 1000.0, (record.end_ns - record.start_ns) / 1000.0,
+        pid, ring->tid);
+    if (zsurf_trace_events[record.event].arg)
+      fprintf(file, ", \"args\": {\"%s\": %" PRIu64 "}",
+          zsurf_trace_events[record.event].arg, record.arg);
+    fprintf(file, "}");
+    *first = false;
+  }
+}
+
+WL_EXPORT int
+zsurf_trace_dump(const char* path)
+{
+  struct zsurf_trace_ring* ring;
+  pid_t pid = getpid();
+  bool first = true;
+  FILE* file;
+
+  file = fopen(path, "w");
+  if (file == NULL) return -1;
+
+  fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+  ring = __atomic_load_n(&zsurf_trace_ring_list, __ATOMIC_ACQUIRE);
+  for (; ring; ring = ring->next)
+    zsurf_trace_write_ring(file, ring, pid, &first);
+
+  fprintf(file, "\n]}\n");
+
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+WL_EXPORT void
+zsurf_trace_set_enabled(bool enabled)
+{
+  __atomic_store_n(&zsurf_trace_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+static void
+zsurf_trace_dump_at_exit(void)
+{
+  if (zsurf_trace_dump(zsurf_trace_exit_path) != 0)
+    zsurf_log_error("zsurface: failed to write the trace to %s\n",
+        zsurf_trace_exit_path);
+}
+
+__attribute__((constructor)) static void
+zsurf_trace_init_from_env(void)
+{
+  zsurf_trace_exit_path = getenv("ZSURFACE_TRACE");
+  if (zsurf_trace_exit_path == NULL || zsurf_trace_exit_path[0] == '\0')
+    return;
+
+  zsurf_trace_set_enabled(true);
+  atexit(zsurf_trace_dump_at_exit);
+}
+
+#else  // ZSURF_TRACE
+
+WL_EXPORT int
+zsurf_trace_dump(const char* path)
+{
+  UNUSED(path);
+  return -1;
+}
+
+WL_EXPORT void
+zsurf_trace_set_enabled(bool enabled)
+{
+  UNUSED(enabled);
+}
+
+#endif  // ZSURF_TRACE
@@ -1,5 +1,6 @@
 #define _GNU_SOURCE
 
+#include <fcntl.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -8,15 +9,10 @@
 #include "internal.h"
 
 static const char* vertex_shader;
-static const char* fragment_shader;
+static const char* fragment_shaders[ZSURF_VIEW_SHADER_COUNT];
 
-struct zsurf_view_callback_data {
-  zsurf_view_frame_callback_func_t func;
-  void* data;
-};
-
-static int
-create_shared_fd(loff_t size)
+int
+zsurf_create_shared_fd(off_t size)
 {
   const char* name = "zsurface-base";
 
@@ -35,7 +31,7 @@ create_shared_fd(loff_t size)
 static int
 create_shared_text_fd(const char* text, loff_t size)
 {
-  int fd = create_shared_fd(size);
+  int fd = zsurf_create_shared_fd(size);
   if (fd < 0) return fd;
 
   void* data = mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0);
@@ -46,49 +42,310 @@ create_shared_text_fd(const char* text, loff_t size)
   memcpy(data, text, size);
   munmap(data, size);
 
+  // the same fd is handed to the compositor for every view
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) < 0) {
+    close(fd);
+    return -1;
+  }
+
   return fd;
 }
 
+int
+zsurf_view_init_shader_sources(struct zsurf_display* surface_display)
+{
+  struct zsurf_shader_source* vertex = &surface_display->vertex_shader_source;
+  struct zsurf_shader_source* fragment;
+  int i;
+
+  vertex->size = strlen(vertex_shader);
+  vertex->fd = create_shared_text_fd(vertex_shader, vertex->size);
+  if (vertex->fd < 0) goto err;
+
+  for (i = 0; i < ZSURF_VIEW_SHADER_COUNT; i++) {
+    fragment = &surface_display->fragment_shader_sources[i];
+    fragment->size = strlen(fragment_shaders[i]);
+    fragment->fd = create_shared_text_fd(fragment_shaders[i], fragment->size);
+    if (fragment->fd < 0) goto err_fragment;
+  }
+
+  return 0;
+
+err_fragment:
+  while (i-- > 0) close(surface_display->fragment_shader_sources[i].fd);
+  close(vertex->fd);
+
+err:
+  return -1;
+}
+
+void
+zsurf_view_fini_shader_sources(struct zsurf_display* surface_display)
+{
+  close(surface_display->vertex_shader_source.fd);
+  for (int i = 0; i < ZSURF_VIEW_SHADER_COUNT; i++)
+    close(surface_display->fragment_shader_sources[i].fd);
+}
+
+const struct zsurf_view_color_transform zsurf_view_color_transform_identity = {
+    .multiply = {1.0f, 1.0f, 1.0f, 1.0f},
+    .add = {0.0f, 0.0f, 0.0f, 0.0f},
+    .opacity = 1.0f,
+};
+
+static void
+zsurf_view_send_color_transform(struct zgn_opengl_shader_program* shader,
+    struct zsurf_view_color_transform* color_transform)
+{
+  struct wl_array array;
+
+  array.alloc = 0;
+
+  array.size = sizeof color_transform->multiply;
+  array.data = color_transform->multiply;
+  zgn_opengl_shader_program_set_uniform_float_vector(
+      shader, "colorMultiply", 4, 1, &array);
+
+  array.size = sizeof color_transform->add;
+  array.data = color_transform->add;
+  zgn_opengl_shader_program_set_uniform_float_vector(
+      shader, "colorAdd", 4, 1, &array);
+
+  array.size = sizeof color_transform->opacity;
+  array.data = &color_transform->opacity;
+  zgn_opengl_shader_program_set_uniform_float_vector(
+      shader, "opacity", 1, 1, &array);
+}
+
+static void
+zsurf_view_send_layer_count(
+    struct zgn_opengl_shader_program* shader, uint32_t layer_count)
+{
+  struct wl_array array;
+  float count = layer_count;
+
+  array.alloc = 0;
+  array.size = sizeof count;
+  array.data = &count;
+  zgn_opengl_shader_program_set_uniform_float_vector(
+      shader, "layerCount", 1, 1, &array);
+}
+
+struct zgn_opengl_shader_program*
+zsurf_view_create_shader(struct zsurf_display* surface_display,
+    enum zsurf_view_shader shader_kind, mat4 rotate,
+    struct zsurf_view_color_transform* color_transform, uint32_t layer_count)
+{
+  struct zgn_opengl_shader_program* shader;
+  struct zsurf_shader_source* fragment =
+      &surface_display->fragment_shader_sources[shader_kind];
+
+  shader = zgn_opengl_create_shader_program(surface_display->opengl);
+
+  {
+    struct wl_array rotate_array;
+    glm_mat4_as_wl_array(rotate, &rotate_array);
+    zgn_opengl_shader_program_set_uniform_float_matrix(
+        shader, "rotate", 4, 4, false, 1, &rotate_array);
+  }
+  zsurf_view_send_color_transform(shader, color_transform);
+  if (shader_kind == ZSURF_VIEW_SHADER_LAYERS)
+    zsurf_view_send_layer_count(shader, layer_count);
+
+  zgn_opengl_shader_program_set_vertex_shader(shader,
+      surface_display->vertex_shader_source.fd,
+      surface_display->vertex_shader_source.size);
+  zgn_opengl_shader_program_set_fragment_shader(
+      shader, fragment->fd, fragment->size);
+
+  zgn_opengl_shader_program_link(shader);
+
+  return shader;
+}
+
+static enum zsurf_view_shader
+zsurf_view_shader_for(enum wl_shm_format texture_format)
+{
+  switch (texture_format) {
+    case WL_SHM_FORMAT_XRGB8888:
+    case WL_SHM_FORMAT_RGB565:
+      return ZSURF_VIEW_SHADER_OPAQUE;
+    case WL_SHM_FORMAT_R8:
+      return ZSURF_VIEW_SHADER_GRAY;
+    default:
+      return ZSURF_VIEW_SHADER_RGBA;
+  }
+}
+
+/**
+ * a linked program cannot take another fragment shader, replace the program
+ */
+static void
+zsurf_view_use_shader(
+    struct zsurf_view* view, enum zsurf_view_shader shader_kind)
+{
+  mat4 rotate = GLM_MAT4_IDENTITY_INIT;
+
+  if (view->shader_kind == shader_kind) {
+    if (shader_kind != ZSURF_VIEW_SHADER_LAYERS) return;
+    zsurf_view_send_layer_count(view->shader, view->layer_count);
+    if (view->component)
+      zgn_opengl_component_attach_shader_program(
+          view->component, view->shader);
+    return;
+  }
+
+  // pooled views have no toplevel to follow
+  if (view->component) glm_quat_mat4(view->toplevel->quaternion, rotate);
+
+  zgn_opengl_shader_program_destroy(view->shader);
+  view->shader = zsurf_view_create_shader(view->surface_display, shader_kind,
+      rotate, &view->color_transform, view->layer_count);
+  view->shader_kind = shader_kind;
+
+  if (view->component)
+    zgn_opengl_component_attach_shader_program(view->component, view->shader);
+}
+
+/**
+ * the top left and bottom right of the source rectangle in texture
+ * coordinates, clamped to the texture, or to the view's part of its atlas page
+ */
+static void
+zsurf_view_source_uv(struct zsurf_view* view, vec2 uv0, vec2 uv1)
+{
+  float width = view->surface_geometry.width;
+  float height = view->surface_geometry.height;
+
+  if (view->source.set) {
+    uv0[0] = glm_clamp(view->source.x / width, 0.0f, 1.0f);
+    uv0[1] = glm_clamp(view->source.y / height, 0.0f, 1.0f);
+    uv1[0] =
+        glm_clamp((view->source.x + view->source.width) / width, 0.0f, 1.0f);
+    uv1[1] =
+        glm_clamp((view->source.y + view->source.height) / height, 0.0f, 1.0f);
+  } else {
+    glm_vec2_zero(uv0);
+    glm_vec2_one(uv1);
+  }
+
+  if (view->atlas.page) zsurf_atlas_uv(&view->atlas, uv0, uv1);
+}
+
+/**
+ * rewrite the texture coordinates of the quad, its position stays
+ */
+static void
+zsurf_view_update_uv(struct zsurf_view* view)
+{
+  struct triangle* triangles = view->vertex_data->triangles;
+  vec2 uv0, uv1;
+
+  zsurf_view_source_uv(view, uv0, uv1);
+
+  // A C D, A C B as written by zsurf_view_update_space_geom
+  triangles[0].vertices[0].uv[0] = uv0[0];
+  triangles[0].vertices[0].uv[1] = uv1[1];
+  triangles[0].vertices[1].uv[0] = uv1[0];
+  triangles[0].vertices[1].uv[1] = uv0[1];
+  triangles[0].vertices[2].uv[0] = uv0[0];
+  triangles[0].vertices[2].uv[1] = uv0[1];
+  triangles[1].vertices[0] = triangles[0].vertices[0];
+  triangles[1].vertices[1] = triangles[0].vertices[1];
+  triangles[1].vertices[2].uv[0] = uv1[0];
+  triangles[1].vertices[2].uv[1] = uv1[1];
+
+  zgn_opengl_vertex_buffer_attach(
+      view->vertex_buffer, view->vertex_buffer_buffer);
+  if (view->component)
+    zgn_opengl_component_attach_vertex_buffer(
+        view->component, view->vertex_buffer);
+}
+
+static void
+zsurf_view_texture_buffer_release(void* data, struct wl_buffer* buffer)
+{
+  UNUSED(buffer);
+  struct zsurf_view* view = data;
+
+  view->memory.texture_busy = false;
+  zsurf_view_memory_update(view);
+}
+
+static const struct wl_buffer_listener texture_buffer_listener = {
+    .release = zsurf_view_texture_buffer_release,
+};
+
 static int
-zsurf_view_resize_texture(
-    struct zsurf_view* view, uint32_t width, uint32_t height)
+zsurf_view_resize_texture(struct zsurf_view* view, uint32_t width,
+    uint32_t height, enum wl_shm_format format,
+    enum zsurf_view_shader shader_kind, uint32_t layer_count)
 {
   size_t vertex_buffer_size, texture_size, shm_size;
+  // rows are kept 4-byte aligned for the compositor's texture upload
+  uint32_t stride =
+      (width * zsurf_convert_shm_bytes_per_pixel(format) + 3) & ~3u;
+  // the chroma rows of yuv follow the luma plane
+  uint32_t texture_height = shader_kind == ZSURF_VIEW_SHADER_NV12 ||
+                                    shader_kind == ZSURF_VIEW_SHADER_I420
+                                ? height * 3 / 2
+                                : height * layer_count;
+  bool grown = false, left_atlas = view->atlas.page != NULL;
+  uint64_t trace;
   if (width == view->surface_geometry.width &&
-      height == view->surface_geometry.height)
+      height == view->surface_geometry.height &&
+      format == view->texture_format && shader_kind == view->shader_kind &&
+      layer_count == view->layer_count && !left_atlas)
     return 0;
 
-  if (width * height <=
-      view->surface_geometry.width * view->surface_geometry.height) {
-    view->surface_geometry.width = width;
-    view->surface_geometry.height = height;
-  } else {
-    texture_size = sizeof(struct zsurf_color_bgra) * width * height;
-    vertex_buffer_size = sizeof(struct view_rect);
+  if (left_atlas) zsurf_atlas_remove(&view->atlas);
+
+  trace = zsurf_trace_begin();
+  vertex_buffer_size = sizeof(struct view_rect);
+  texture_size = (size_t)stride * texture_height;
+
+  if (texture_size > view->texture_capacity) {
     shm_size = vertex_buffer_size + texture_size;
 
     if (ftruncate(view->fd, shm_size) < 0) return -1;
 
     wl_shm_pool_resize(view->pool, shm_size);
 
-    view->surface_geometry.width = width;
-    view->surface_geometry.height = height;
     view->shm_data =
         mremap(view->shm_data, view->shm_size, shm_size, MREMAP_MAYMOVE);
     if (view->shm_data == MAP_FAILED) return -1;
 
     view->shm_size = shm_size;
+    view->texture_capacity = texture_size;
     view->vertex_data = view->shm_data;
-    view->texture_data = (struct zsurf_color_bgra*)((uint8_t*)view->shm_data +
-                                                    vertex_buffer_size);
+    view->texture_data = (uint8_t*)view->shm_data + vertex_buffer_size;
+    grown = true;
   }
 
+  view->surface_geometry.width = width;
+  view->surface_geometry.height = height;
+  view->texture_format = format;
+  view->texture_stride = stride;
+  view->texture_height = texture_height;
+  view->layer_count = layer_count;
+
+  zsurf_view_use_shader(view, shader_kind);
+
+  // a source in pixels covers another part of a texture of another size
+  if (view->source.set || left_atlas) zsurf_view_update_uv(view);
+
   wl_buffer_destroy(view->texture_buffer);
-  view->texture_buffer =
-      wl_shm_pool_create_buffer(view->pool, vertex_buffer_size, width, height,
-          sizeof(struct zsurf_color_bgra) * width, WL_SHM_FORMAT_ARGB8888);
+  view->texture_buffer = wl_shm_pool_create_buffer(
+      view->pool, vertex_buffer_size, width, texture_height, stride, format);
+  wl_buffer_add_listener(
+      view->texture_buffer, &texture_buffer_listener, view);
   zgn_opengl_texture_attach_2d(view->texture, view->texture_buffer);
-  zgn_opengl_component_attach_texture(view->component, view->texture);
+  view->memory.texture_busy = true;
+
+  zsurf_view_memory_update(view);
+  if (grown) zsurf_display_check_memory_budget(view->surface_display);
+
+  zsurf_trace_end(ZSURF_TRACE_RESIZE, trace, (uint64_t)width * height);
 
   return 0;
 }
@@ -111,21 +368,66 @@ zsurf_view_update_surface_pos(struct zsurf_view* view, int32_t sx, int32_t sy)
   view->surface_geometry.sy = sy;
 }
 
+WL_EXPORT void
+zsurf_view_set_source(
+    struct zsurf_view* view, float x, float y, float width, float height)
+{
+  uint32_t record_id = zsurf_view_record_id(view);
+
+  if (record_id) {
+    float payload[] = {x, y, width, height};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SET_SOURCE,
+        record_id, payload, sizeof payload);
+  }
+
+  view->source.set = width > 0.0f && height > 0.0f;
+  view->source.x = x;
+  view->source.y = y;
+  view->source.width = width;
+  view->source.height = height;
+
+  zsurf_view_update_uv(view);
+}
+
+static void
+zsurf_view_atlas_moved(struct zsurf_atlas_entry* entry)
+{
+  struct zsurf_view* view = wl_container_of(entry, view, atlas);
+
+  zsurf_view_update_uv(view);
+  if (view->component)
+    zgn_opengl_component_attach_texture(
+        view->component, entry->page->texture);
+}
+
+void
+zsurf_view_local_coord(
+    struct zsurf_view* view, float fx, float fy, vec2 local_coord)
+{
+  if (view->source.set) {
+    local_coord[0] = view->source.x + fx * view->source.width;
+    local_coord[1] = view->source.y + fy * view->source.height;
+  } else {
+    local_coord[0] = fx * view->surface_geometry.width;
+    local_coord[1] = fy * view->surface_geometry.height;
+  }
+}
+
 WL_EXPORT void
 zsurf_view_update_space_geom(struct zsurf_view* view)
 {
+  vec2 uv0, uv1;
   vec2 half_size, center;
   mat4 rotate;
+  uint64_t trace = zsurf_trace_begin();
 
   glm_quat_mat4(view->toplevel->quaternion, rotate);
 
   {
     struct wl_array rotate_array;
-    wl_array_init(&rotate_array);
-    glm_mat4_to_wl_array(rotate, &rotate_array);
+    glm_mat4_as_wl_array(rotate, &rotate_array);
     zgn_opengl_shader_program_set_uniform_float_matrix(
         view->shader, "rotate", 4, 4, false, 1, &rotate_array);
-    wl_array_release(&rotate_array);
   }
 
   zgn_opengl_component_attach_shader_program(view->component, view->shader);
@@ -152,15 +454,17 @@ zsurf_view_update_space_geom(struct zsurf_view* view)
         view->parent->surface_geometry.height;
   }
 
+  zsurf_view_source_uv(view, uv0, uv1);
+
   float z = (float)view->z_index / 500;
-  struct vertex A = {
-      {-half_size[0] + center[0], -half_size[1] + center[1], z}, {0, 1}};
-  struct vertex B = {
-      {+half_size[0] + center[0], -half_size[1] + center[1], z}, {1, 1}};
-  struct vertex C = {
-      {+half_size[0] + center[0], +half_size[1] + center[1], z}, {1, 0}};
-  struct vertex D = {
-      {-half_size[0] + center[0], +half_size[1] + center[1], z}, {0, 0}};
+  struct vertex A = {{-half_size[0] + center[0], -half_size[1] + center[1], z},
+      {uv0[0], uv1[1]}};
+  struct vertex B = {{+half_size[0] + center[0], -half_size[1] + center[1], z},
+      {uv1[0], uv1[1]}};
+  struct vertex C = {{+half_size[0] + center[0], +half_size[1] + center[1], z},
+      {uv1[0], uv0[1]}};
+  struct vertex D = {{-half_size[0] + center[0], +half_size[1] + center[1], z},
+      {uv0[0], uv0[1]}};
 
   view->vertex_data->triangles[0].vertices[0] = A;
   view->vertex_data->triangles[0].vertices[1] = C;
@@ -174,10 +478,13 @@ zsurf_view_update_space_geom(struct zsurf_view* view)
   zgn_opengl_component_attach_vertex_buffer(
       view->component, view->vertex_buffer);
 
-  zsurf_signal_emit(&view->geometry_signal, NULL);
-
   glm_vec2_copy(half_size, view->space_geometry.half_size);
   glm_vec2_copy(center, view->space_geometry.center);
+
+  // children are laid out in the new geometry
+  zsurf_signal_emit(&view->geometry_signal, NULL);
+
+  zsurf_trace_end(ZSURF_TRACE_GEOMETRY, trace, 0);
 }
 
 WL_EXPORT void*
@@ -186,15 +493,35 @@ zsurf_view_get_user_data(struct zsurf_view* view)
   return view->user_data;
 }
 
+void
+zsurf_view_frame_callback_deliver(
+    struct zsurf_view_callback_data* callback_data, uint32_t callback_time)
+{
+  uint64_t trace = zsurf_trace_begin();
+
+  if (callback_data->toplevel)
+    zsurf_resolution_frame(&callback_data->toplevel->resolution);
+  callback_data->func(callback_data->data, callback_time);
+  zsurf_trace_end(ZSURF_TRACE_FRAME_CALLBACK, trace, callback_time);
+
+  wl_list_insert(&callback_data->surface_display->frame_callback_pool,
+      &callback_data->link);
+}
+
 static void
 zsurf_view_callback_done(
     void* data, struct wl_callback* callback, uint32_t callback_time)
 {
   struct zsurf_view_callback_data* callback_data = data;
-  callback_data->func(callback_data->data, callback_time);
+  struct zsurf_display* surface_display = callback_data->surface_display;
 
   wl_callback_destroy(callback);
-  free(callback_data);
+  wl_list_remove(&callback_data->link);
+
+  if (zsurf_throttle_defer(surface_display, callback_data, callback_time))
+    return;
+
+  zsurf_view_frame_callback_deliver(callback_data, callback_time);
 }
 
 static const struct wl_callback_listener frame_callback_listener = {
@@ -204,53 +531,413 @@ WL_EXPORT void
 zsurf_view_add_frame_callback(struct zsurf_view* view,
     zsurf_view_frame_callback_func_t done_func, void* data)
 {
+  struct zsurf_display* surface_display = view->surface_display;
+  uint32_t record_id = zsurf_view_record_id(view);
   struct wl_callback* callback;
   struct zsurf_view_callback_data* callback_data;
-  callback = zgn_virtual_object_frame(view->toplevel->virtual_object);
 
-  callback_data = zalloc(sizeof *callback_data);
+  // records are recycled so that a steady frame loop does not allocate
+  if (wl_list_empty(&surface_display->frame_callback_pool)) {
+    callback_data = zalloc(sizeof *callback_data);
+    if (callback_data == NULL) {
+      zsurf_log_error("zsurface: failed to allocate a frame callback\n");
+      return;
+    }
+    callback_data->surface_display = surface_display;
+  } else {
+    callback_data = wl_container_of(
+        surface_display->frame_callback_pool.next, callback_data, link);
+    wl_list_remove(&callback_data->link);
+  }
+
   callback_data->data = data;
   callback_data->func = done_func;
+  view->memory.active_ns = zsurf_get_time_ns();
+  if (record_id)
+    zsurf_record(surface_display, ZSURF_RECORD_VIEW_FRAME, record_id, NULL, 0);
 
+  callback_data->toplevel = view->toplevel;
+  wl_list_insert(
+      view->toplevel->activity.frame_list.prev, &callback_data->link);
+
+  callback = zgn_virtual_object_frame(view->toplevel->virtual_object);
   wl_callback_add_listener(callback, &frame_callback_listener, callback_data);
 }
 
-WL_EXPORT int
-zsurf_view_set_texture(struct zsurf_view* view, struct zsurf_color_bgra* data,
-    uint32_t width, uint32_t height)
+void
+zsurf_view_frame_callback_pool_fini(struct zsurf_display* surface_display)
 {
-  if (zsurf_view_resize_texture(view, width, height) != 0) return -1;
-
-  memcpy(view->texture_data, data,
-      sizeof(struct zsurf_color_bgra) * width * height);
+  struct zsurf_view_callback_data *callback_data, *tmp;
 
-  zgn_opengl_texture_attach_2d(view->texture, view->texture_buffer);
-  zgn_opengl_component_attach_texture(view->component, view->texture);
+  wl_list_for_each_safe(
+      callback_data, tmp, &surface_display->frame_callback_pool, link)
+      free(callback_data);
+}
 
+static void
+zsurf_view_texture_attached(struct zsurf_view* view)
+{
   if (view->state == ZSURF_VIEW_STATE_NO_TEXTURE)
     view->state = ZSURF_VIEW_STATE_FIRST_TEXTURE_ATTACHED;
   else if (view->state == ZSURF_VIEW_STATE_TEXTURE_COMMITTED)
     view->state = ZSURF_VIEW_STATE_NEW_TEXTURE_ATTACHED;
+}
+
+/**
+ * the texture buffer holds new contents
+ */
+static void
+zsurf_view_attach_texture(struct zsurf_view* view)
+{
+  zgn_opengl_texture_attach_2d(view->texture, view->texture_buffer);
+  view->memory.texture_busy = true;
+  view->memory.dropped = false;
+  view->memory.active_ns = zsurf_get_time_ns();
+  zsurf_view_memory_update(view);
+  zgn_opengl_component_attach_texture(view->component, view->texture);
+  zsurf_view_texture_attached(view);
+}
+
+WL_EXPORT int
+zsurf_view_set_texture(struct zsurf_view* view, struct zsurf_color_bgra* data,
+    uint32_t width, uint32_t height)
+{
+  return zsurf_view_set_texture_format(
+      view, data, ZSURF_PIXEL_FORMAT_BGRA8888, 0, width, height);
+}
+
+WL_EXPORT int
+zsurf_view_set_texture_format(struct zsurf_view* view, const void* data,
+    enum zsurf_pixel_format format, uint32_t stride, uint32_t width,
+    uint32_t height)
+{
+  uint32_t bytes_per_pixel = zsurf_convert_bytes_per_pixel(format);
+  uint32_t record_id = zsurf_view_record_id(view);
+  enum wl_shm_format texture_format;
+  uint64_t trace;
+  size_t size;
+
+  if (bytes_per_pixel == 0) return -1;
+  if (stride == 0) stride = bytes_per_pixel * width;
+
+  texture_format = zsurf_convert_texture_format(
+      view->surface_display->shm_formats, format);
+
+  if (record_id) {
+    uint32_t payload[] = {ZSURF_RECORD_TEXTURE_FORMAT, format, width, height};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SET_TEXTURE,
+        record_id, payload, sizeof payload);
+  }
+
+  if (zsurf_view_resize_texture(view, width, height, texture_format,
+          zsurf_view_shader_for(texture_format), 1) != 0)
+    return -1;
+
+  trace = zsurf_trace_begin();
+  size = (size_t)view->texture_stride * height;
+  zsurf_convert(view->texture_data, view->texture_stride, texture_format, data,
+      format, stride, width, height);
+  zsurf_trace_end(ZSURF_TRACE_TEXTURE_COPY, trace, size);
+
+  view->memory.in_place = false;
+  zsurf_view_attach_texture(view);
+
+  return 0;
+}
+
+WL_EXPORT int
+zsurf_view_set_texture_yuv(struct zsurf_view* view,
+    enum zsurf_yuv_format format, const uint8_t* const planes[3],
+    const uint32_t strides[3], uint32_t width, uint32_t height)
+{
+  uint32_t record_id = zsurf_view_record_id(view);
+  bool native = view->surface_display->shm_formats &
+                zsurf_convert_shm_format_bit(WL_SHM_FORMAT_R8);
+  uint64_t trace;
+  int ret;
+
+  if (width % 2 != 0 || height % 2 != 0) return -1;
+  if (format != ZSURF_YUV_FORMAT_NV12 && format != ZSURF_YUV_FORMAT_I420)
+    return -1;
+
+  if (record_id) {
+    uint32_t payload[] = {ZSURF_RECORD_TEXTURE_YUV, format, width, height};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SET_TEXTURE,
+        record_id, payload, sizeof payload);
+  }
+
+  if (native)
+    ret = zsurf_view_resize_texture(view, width, height, WL_SHM_FORMAT_R8,
+        format == ZSURF_YUV_FORMAT_NV12 ? ZSURF_VIEW_SHADER_NV12
+                                        : ZSURF_VIEW_SHADER_I420,
+        1);
+  else
+    ret = zsurf_view_resize_texture(view, width, height,
+        WL_SHM_FORMAT_ARGB8888, ZSURF_VIEW_SHADER_RGBA, 1);
+  if (ret != 0) return -1;
+
+  trace = zsurf_trace_begin();
+  if (native)
+    zsurf_convert_yuv_planes(view->texture_data, view->texture_stride, format,
+        planes, strides, width, height);
+  else
+    zsurf_convert_yuv(
+        view->texture_data, format, planes, strides, width, height);
+  zsurf_trace_end(ZSURF_TRACE_TEXTURE_COPY, trace,
+      (uint64_t)view->texture_stride * view->texture_height);
+
+  view->memory.in_place = false;
+  zsurf_view_attach_texture(view);
+
+  return 0;
+}
+
+WL_EXPORT int
+zsurf_view_set_texture_layer(struct zsurf_view* view, uint32_t layer,
+    const struct zsurf_color_bgra* data, uint32_t width, uint32_t height)
+{
+  uint32_t record_id = zsurf_view_record_id(view);
+  uint32_t old_count = 0, layer_count;
+  size_t layer_size;
+  uint8_t* layer_data;
+  uint64_t trace;
+  bool lost = false;
+
+  if (layer >= ZSURF_VIEW_MAX_LAYERS) return -1;
+
+  // the other layers are kept only while the texture keeps its layout
+  if (view->shader_kind == ZSURF_VIEW_SHADER_LAYERS &&
+      width == view->surface_geometry.width &&
+      height == view->surface_geometry.height)
+    old_count = view->layer_count;
+  layer_count = layer < old_count ? old_count : layer + 1;
+
+  // reclaimed pages read back as zeros, the other layers are gone
+  if (view->memory.dropped && old_count > 0) {
+    lost = old_count > 1 || layer != 0;
+    old_count = 0;
+  }
+
+  if (record_id) {
+    uint32_t payload[] = {ZSURF_RECORD_TEXTURE_LAYER, layer, width, height};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SET_TEXTURE,
+        record_id, payload, sizeof payload);
+  }
+
+  if (zsurf_view_resize_texture(view, width, height, WL_SHM_FORMAT_ARGB8888,
+          ZSURF_VIEW_SHADER_LAYERS, layer_count) != 0)
+    return -1;
+
+  trace = zsurf_trace_begin();
+  layer_size = (size_t)view->texture_stride * height;
+  for (uint32_t i = old_count; i < layer_count; i++)
+    if (i != layer)
+      memset((uint8_t*)view->texture_data + i * layer_size, 0, layer_size);
+
+  layer_data = (uint8_t*)view->texture_data + layer * layer_size;
+  memcpy(layer_data, data, layer_size);
+  zsurf_trace_end(ZSURF_TRACE_TEXTURE_COPY, trace, layer_size);
+
+  view->memory.in_place = true;
+  zsurf_view_attach_texture(view);
+
+  return lost ? 1 : 0;
+}
+
+WL_EXPORT int
+zsurf_view_set_texture_atlas(struct zsurf_view* view,
+    const struct zsurf_color_bgra* data, uint32_t width, uint32_t height)
+{
+  uint32_t record_id = zsurf_view_record_id(view);
+  uint64_t trace;
+
+  if (width > ZSURF_ATLAS_MAX_SIZE || height > ZSURF_ATLAS_MAX_SIZE)
+    return -1;
+
+  // the view's own texture is not shown anymore, keep it small
+  if (view->atlas.page == NULL &&
+      zsurf_view_resize_texture(
+          view, 1, 1, WL_SHM_FORMAT_ARGB8888, ZSURF_VIEW_SHADER_RGBA, 1) != 0)
+    return -1;
+
+  // out of memory for another page, the view's own texture still works and
+  // is recorded as such
+  if (zsurf_atlas_place(view->surface_display, &view->atlas, width, height) !=
+      0) {
+    int ret = zsurf_view_set_texture_format(
+        view, data, ZSURF_PIXEL_FORMAT_BGRA8888, 0, width, height);
+    zsurf_view_update_uv(view);
+    return ret;
+  }
+
+  if (record_id) {
+    uint32_t payload[] = {ZSURF_RECORD_TEXTURE_ATLAS, 0, width, height};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SET_TEXTURE,
+        record_id, payload, sizeof payload);
+  }
+
+  view->surface_geometry.width = width;
+  view->surface_geometry.height = height;
+  zsurf_view_use_shader(view, ZSURF_VIEW_SHADER_RGBA);
+
+  trace = zsurf_trace_begin();
+  zsurf_atlas_write(&view->atlas, data);
+  zsurf_trace_end(ZSURF_TRACE_TEXTURE_COPY, trace,
+      (uint64_t)width * height * sizeof *data);
+
+  zsurf_view_update_uv(view);
+  zgn_opengl_component_attach_texture(
+      view->component, view->atlas.page->texture);
+  view->memory.in_place = false;
+  view->memory.active_ns = zsurf_get_time_ns();
+  zsurf_view_texture_attached(view);
+
+  return 0;
+}
+
+WL_EXPORT struct zsurf_color_bgra*
+zsurf_view_get_texture_buffer(
+    struct zsurf_view* view, uint32_t width, uint32_t height)
+{
+  uint32_t record_id = zsurf_view_record_id(view);
+
+  if (record_id) {
+    uint32_t payload[] = {ZSURF_RECORD_TEXTURE_BUFFER, 0, width, height};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SET_TEXTURE,
+        record_id, payload, sizeof payload);
+  }
+
+  if (zsurf_view_resize_texture(view, width, height, WL_SHM_FORMAT_ARGB8888,
+          ZSURF_VIEW_SHADER_RGBA, 1) != 0)
+    return NULL;
+
+  // pages reclaimed before the view was drawn in place read back as zeros
+  if (view->memory.dropped)
+    memset(view->texture_data, 0,
+        (size_t)view->texture_stride * view->texture_height);
+
+  view->memory.in_place = true;
+  zsurf_view_attach_texture(view);
+
+  return view->texture_data;
+}
+
+WL_EXPORT int
+zsurf_view_scroll(
+    struct zsurf_view* view, const struct zsurf_rect* rect, int32_t dy)
+{
+  uint32_t bytes_per_pixel =
+      zsurf_convert_shm_bytes_per_pixel(view->texture_format);
+  uint32_t stride = view->texture_stride;
+  uint32_t distance = dy < 0 ? -(uint32_t)dy : (uint32_t)dy;
+  uint32_t record_id = zsurf_view_record_id(view);
+  uint32_t rows, row_size;
+  uint8_t *src, *dst;
+  uint64_t trace;
+
+  if (record_id) {
+    uint32_t payload[] = {
+        rect->x, rect->y, rect->width, rect->height, (uint32_t)dy};
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_SCROLL, record_id,
+        payload, sizeof payload);
+  }
+
+  if (view->shader_kind == ZSURF_VIEW_SHADER_NV12 ||
+      view->shader_kind == ZSURF_VIEW_SHADER_I420 ||
+      view->shader_kind == ZSURF_VIEW_SHADER_LAYERS || view->atlas.page)
+    return -1;
+  // nothing left to move, the app has to draw everything again
+  if (view->memory.dropped) return -1;
+  if (rect->x > view->surface_geometry.width ||
+      rect->width > view->surface_geometry.width - rect->x ||
+      rect->y > view->surface_geometry.height ||
+      rect->height > view->surface_geometry.height - rect->y)
+    return -1;
+
+  if (distance == 0 || distance >= rect->height || rect->width == 0) return 0;
+
+  trace = zsurf_trace_begin();
+  rows = rect->height - distance;
+  row_size = rect->width * bytes_per_pixel;
+  src = (uint8_t*)view->texture_data + (size_t)rect->y * stride +
+        (size_t)rect->x * bytes_per_pixel;
+  dst = src;
+  if (dy > 0)
+    dst += (size_t)distance * stride;
+  else
+    src += (size_t)distance * stride;
+
+  if (row_size == stride) {
+    // full rows are one contiguous block
+    memmove(dst, src, (size_t)rows * stride);
+  } else if (dy > 0) {
+    // rows overlap downward, copy the bottom one first
+    for (uint32_t i = rows; i-- > 0;)
+      memmove(dst + (size_t)i * stride, src + (size_t)i * stride, row_size);
+  } else {
+    for (uint32_t i = 0; i < rows; i++)
+      memmove(dst + (size_t)i * stride, src + (size_t)i * stride, row_size);
+  }
+  zsurf_trace_end(
+      ZSURF_TRACE_TEXTURE_COPY, trace, (uint64_t)rows * row_size);
+
+  view->memory.in_place = true;
+  zsurf_view_attach_texture(view);
 
   return 0;
 }
 
+WL_EXPORT void
+zsurf_view_set_color_transform(struct zsurf_view* view, float opacity,
+    const float multiply[4], const float add[4])
+{
+  struct zsurf_view_color_transform* color_transform = &view->color_transform;
+  uint32_t record_id = zsurf_view_record_id(view);
+
+  *color_transform = zsurf_view_color_transform_identity;
+  color_transform->opacity = opacity;
+  if (multiply) memcpy(color_transform->multiply, multiply, sizeof(vec4));
+  if (add) memcpy(color_transform->add, add, sizeof(vec4));
+
+  if (record_id) {
+    float payload[9] = {opacity};
+    memcpy(&payload[1], color_transform->multiply, sizeof(vec4));
+    memcpy(&payload[5], color_transform->add, sizeof(vec4));
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_COLOR_TRANSFORM,
+        record_id, payload, sizeof payload);
+  }
+
+  zsurf_view_send_color_transform(view->shader, color_transform);
+  if (view->component)
+    zgn_opengl_component_attach_shader_program(view->component, view->shader);
+}
+
 WL_EXPORT void
 zsurf_view_commit(struct zsurf_view* view)
 {
+  uint32_t record_id = zsurf_view_record_id(view);
+  uint64_t trace = zsurf_trace_begin();
+
+  if (record_id)
+    zsurf_record(view->surface_display, ZSURF_RECORD_VIEW_COMMIT, record_id,
+        NULL, 0);
+
   zsurf_signal_emit(&view->commit_signal, NULL);
+  zsurf_trace_end(ZSURF_TRACE_COMMIT, trace, 0);
 }
 
-WL_EXPORT struct zsurf_view*
-zsurf_view_create(struct zsurf_display* surface_display,
-    struct zsurf_toplevel* toplevel, struct zsurf_view* parent, void* user_data)
+/**
+ * Build everything of a view that does not depend on a virtual object, so
+ * that it can be kept in the display's view pool.
+ */
+static struct zsurf_view*
+zsurf_view_create_unbound(struct zsurf_display* surface_display)
 {
   struct zsurf_view* view;
-  int32_t fd, vertex_shader_fd, fragment_shader_fd;
+  int32_t fd;
   loff_t vertex_buffer_size, texture_size, shm_size;
   void* shm_data;
   struct wl_shm_pool* pool;
-  struct zgn_opengl_component* component;
   struct zgn_opengl_vertex_buffer* vertex_buffer;
   struct wl_buffer *vertex_buffer_buffer, *texture_buffer;
   struct zgn_opengl_shader_program* shader;
@@ -264,31 +951,22 @@ zsurf_view_create(struct zsurf_display* surface_display,
   texture_size = sizeof(struct zsurf_color_bgra);  // 1 px at the beginning
   shm_size = vertex_buffer_size + texture_size;
 
-  fd = create_shared_fd(shm_size);
+  fd = zsurf_create_shared_fd(shm_size);
   if (fd < 0) goto err_fd;
 
-  vertex_shader_fd =
-      create_shared_text_fd(vertex_shader, strlen(vertex_shader));
-  if (vertex_shader_fd < 0) goto err_vertex_shader_fd;
-
-  fragment_shader_fd =
-      create_shared_text_fd(fragment_shader, strlen(fragment_shader));
-  if (fragment_shader_fd < 0) goto err_fragment_shader_fd;
-
   shm_data = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (shm_data == NULL) goto err_mmap;
+  if (shm_data == MAP_FAILED) goto err_mmap;
 
   pool = wl_shm_create_pool(surface_display->shm, fd, shm_size);
 
-  component = zgn_opengl_create_opengl_component(
-      surface_display->opengl, toplevel->virtual_object);
-
   vertex_buffer = zgn_opengl_create_vertex_buffer(surface_display->opengl);
 
   vertex_buffer_buffer = wl_shm_pool_create_buffer(
       pool, 0, vertex_buffer_size, 1, vertex_buffer_size, 0);
 
-  shader = zgn_opengl_create_shader_program(surface_display->opengl);
+  view->color_transform = zsurf_view_color_transform_identity;
+  shader = zsurf_view_create_shader(surface_display, ZSURF_VIEW_SHADER_RGBA,
+      uniform_rotate, &view->color_transform, 1);
 
   texture = zgn_opengl_create_texture(surface_display->opengl);
 
@@ -296,27 +974,164 @@ zsurf_view_create(struct zsurf_display* surface_display,
       sizeof(struct zsurf_color_bgra), WL_SHM_FORMAT_ARGB8888);
 
   zgn_opengl_vertex_buffer_attach(vertex_buffer, vertex_buffer_buffer);
-  zgn_opengl_component_attach_vertex_buffer(component, vertex_buffer);
 
-  {
-    struct wl_array rotate;
-    wl_array_init(&rotate);
-    glm_mat4_to_wl_array(uniform_rotate, &rotate);
-    zgn_opengl_shader_program_set_uniform_float_matrix(
-        shader, "rotate", 4, 4, false, 1, &rotate);
-    wl_array_release(&rotate);
+  zgn_opengl_texture_attach_2d(texture, texture_buffer);
+  wl_buffer_add_listener(texture_buffer, &texture_buffer_listener, view);
+
+  view->surface_display = surface_display;
+  view->surface_geometry.width = 1;
+  view->surface_geometry.height = 1;
+  view->texture_capacity = texture_size;
+  view->texture_format = WL_SHM_FORMAT_ARGB8888;
+  view->texture_stride = sizeof(struct zsurf_color_bgra);
+  view->texture_height = 1;
+  view->layer_count = 1;
+  view->atlas.moved = zsurf_view_atlas_moved;
+  view->shader_kind = ZSURF_VIEW_SHADER_RGBA;
+  view->fd = fd;
+  view->shm_data = shm_data;
+  view->shm_size = shm_size;
+  view->pool = pool;
+  view->component = NULL;
+  view->vertex_buffer = vertex_buffer;
+  view->vertex_buffer_buffer = vertex_buffer_buffer;
+  view->vertex_data = shm_data;
+  view->shader = shader;
+  view->texture = texture;
+  view->texture_buffer = texture_buffer;
+  view->texture_data = (uint8_t*)shm_data + vertex_buffer_size;
+  wl_list_init(&view->pool_link);
+
+  view->memory.texture_busy = true;
+  view->memory.active_ns = zsurf_get_time_ns();
+  wl_list_insert(&surface_display->memory.view_list, &view->memory.link);
+  zsurf_view_memory_update(view);
+
+  return view;
+
+err_mmap:
+  close(fd);
+
+err_fd:
+  free(view);
+
+err:
+  return NULL;
+}
+
+static void
+zsurf_view_destroy_unbound(struct zsurf_view* view)
+{
+  wl_list_remove(&view->pool_link);
+  wl_list_remove(&view->memory.link);
+  zsurf_view_memory_forget(view);
+  zgn_opengl_texture_destroy(view->texture);
+  zgn_opengl_shader_program_destroy(view->shader);
+  zgn_opengl_vertex_buffer_destroy(view->vertex_buffer);
+  wl_buffer_destroy(view->texture_buffer);
+  wl_buffer_destroy(view->vertex_buffer_buffer);
+  wl_shm_pool_destroy(view->pool);
+  munmap(view->shm_data, view->shm_size);
+  close(view->fd);
+  free(view);
+}
+
+int
+zsurf_view_pool_fill(struct zsurf_display* surface_display, uint32_t max)
+{
+  struct zsurf_view* view;
+
+  while (max-- > 0 &&
+         surface_display->view_pool.count < surface_display->view_pool.size) {
+    view = zsurf_view_create_unbound(surface_display);
+    if (view == NULL) return -1;
+
+    wl_list_insert(&surface_display->view_pool.list, &view->pool_link);
+    surface_display->view_pool.count++;
   }
 
-  zgn_opengl_shader_program_set_vertex_shader(
-      shader, vertex_shader_fd, strlen(vertex_shader));
-  zgn_opengl_shader_program_set_fragment_shader(
-      shader, fragment_shader_fd, strlen(fragment_shader));
+  return 0;
+}
 
-  zgn_opengl_shader_program_link(shader);
-  zgn_opengl_component_attach_shader_program(component, shader);
+void
+zsurf_view_pool_trim(struct zsurf_display* surface_display)
+{
+  struct zsurf_view* view;
 
-  zgn_opengl_texture_attach_2d(texture, texture_buffer);
-  zgn_opengl_component_attach_texture(component, texture);
+  while (surface_display->view_pool.count > surface_display->view_pool.size) {
+    view = wl_container_of(surface_display->view_pool.list.prev, view,
+        pool_link);
+    zsurf_view_destroy_unbound(view);
+    surface_display->view_pool.count--;
+  }
+}
+
+static struct zsurf_view*
+zsurf_view_pool_take(struct zsurf_display* surface_display)
+{
+  struct zsurf_view* view;
+
+  if (surface_display->view_pool.count == 0) return NULL;
+
+  view = wl_container_of(surface_display->view_pool.list.next, view, pool_link);
+  wl_list_remove(&view->pool_link);
+  wl_list_init(&view->pool_link);
+  surface_display->view_pool.count--;
+
+  return view;
+}
+
+/**
+ * return false when the view cannot be reused and must be torn down
+ */
+static bool
+zsurf_view_pool_give_back(struct zsurf_view* view)
+{
+  struct zsurf_display* surface_display = view->surface_display;
+
+  if (surface_display->view_pool.count >= surface_display->view_pool.size)
+    return false;
+
+  // large backing stores are not worth pinning while nobody uses them
+  if (view->shm_size > ZSURF_VIEW_POOL_MAX_SHM_SIZE) return false;
+
+  if (zsurf_view_resize_texture(
+          view, 1, 1, WL_SHM_FORMAT_ARGB8888, ZSURF_VIEW_SHADER_RGBA, 1) != 0)
+    return false;
+  view->memory.in_place = false;
+
+  if (memcmp(&view->color_transform, &zsurf_view_color_transform_identity,
+          sizeof view->color_transform) != 0)
+    zsurf_view_set_color_transform(view, 1.0f, NULL, NULL);
+
+  // the next owner must not see this view's quad before its first geometry
+  memset(view->vertex_data, 0, sizeof *view->vertex_data);
+  zgn_opengl_vertex_buffer_attach(
+      view->vertex_buffer, view->vertex_buffer_buffer);
+
+  wl_list_insert(&surface_display->view_pool.list, &view->pool_link);
+  surface_display->view_pool.count++;
+
+  return true;
+}
+
+WL_EXPORT struct zsurf_view*
+zsurf_view_create(struct zsurf_display* surface_display,
+    struct zsurf_toplevel* toplevel, struct zsurf_view* parent, void* user_data)
+{
+  struct zsurf_view* view;
+  struct zgn_opengl_component* component;
+
+  view = zsurf_view_pool_take(surface_display);
+  if (view == NULL) view = zsurf_view_create_unbound(surface_display);
+  if (view == NULL) return NULL;
+
+  component = zgn_opengl_create_opengl_component(
+      surface_display->opengl, toplevel->virtual_object);
+
+  zgn_opengl_component_attach_vertex_buffer(component, view->vertex_buffer);
+  zgn_opengl_component_attach_shader_program(component, view->shader);
+  zgn_opengl_component_attach_texture(component, view->texture);
 
   zgn_opengl_component_add_vertex_attribute(component, 0, 3,
       ZGN_OPENGL_VERTEX_ATTRIBUTE_TYPE_FLOAT, false, sizeof(struct vertex),
@@ -328,7 +1143,6 @@ zsurf_view_create(struct zsurf_display* surface_display,
       component, sizeof(struct view_rect) / sizeof(float));
   zgn_opengl_component_set_topology(component, ZGN_OPENGL_TOPOLOGY_TRIANGLES);
 
-  view->surface_display = surface_display;
   view->user_data = user_data;
   view->toplevel = toplevel;
   view->parent = parent;
@@ -338,23 +1152,11 @@ zsurf_view_create(struct zsurf_display* surface_display,
   view->space_geometry.half_size[1] = 0;
   view->space_geometry.center[0] = 0;
   view->space_geometry.center[1] = 0;
-  view->surface_geometry.width = 1;
-  view->surface_geometry.height = 1;
-  view->fd = fd;
-  view->vertex_shader_fd = vertex_shader_fd;
-  view->fragment_shader_fd = fragment_shader_fd;
-  view->shm_data = shm_data;
-  view->shm_size = shm_size;
-  view->pool = pool;
+  view->surface_geometry.sx = 0;
+  view->surface_geometry.sy = 0;
+  view->source.set = false;
+  view->atlas.toplevel = toplevel;
   view->component = component;
-  view->vertex_buffer = vertex_buffer;
-  view->vertex_buffer_buffer = vertex_buffer_buffer;
-  view->vertex_data = shm_data;
-  view->shader = shader;
-  view->texture = texture;
-  view->texture_buffer = texture_buffer;
-  view->texture_data =
-      (struct zsurf_color_bgra*)((uint8_t*)shm_data + vertex_buffer_size);
 
   zsurf_signal_init(&view->commit_signal);
   zsurf_signal_init(&view->destroy_signal);
@@ -367,21 +1169,6 @@ zsurf_view_create(struct zsurf_display* surface_display,
     wl_list_init(&view->parent_geometry_listener.link);
 
   return view;
-
-err_mmap:
-  close(fragment_shader_fd);
-
-err_fragment_shader_fd:
-  close(vertex_shader_fd);
-
-err_vertex_shader_fd:
-  close(fd);
-
-err_fd:
-  free(view);
-
-err:
-  return NULL;
 }
 
 WL_EXPORT void
@@ -389,18 +1176,12 @@ zsurf_view_destroy(struct zsurf_view* view)
 {
   wl_list_remove(&view->parent_geometry_listener.link);
   zsurf_signal_emit(&view->destroy_signal, NULL);
-  zgn_opengl_texture_destroy(view->texture);
-  zgn_opengl_shader_program_destroy(view->shader);
-  zgn_opengl_vertex_buffer_destroy(view->vertex_buffer);
-  wl_buffer_destroy(view->texture_buffer);
-  wl_buffer_destroy(view->vertex_buffer_buffer);
   zgn_opengl_component_destroy(view->component);
-  wl_shm_pool_destroy(view->pool);
-  munmap(view->shm_data, view->shm_size);
-  close(view->vertex_shader_fd);
-  close(view->fragment_shader_fd);
-  close(view->fd);
-  free(view);
+  view->component = NULL;
+  if (view->atlas.page) zsurf_atlas_remove(&view->atlas);
+  zsurf_atlas_release(&view->atlas);
+
+  if (!zsurf_view_pool_give_back(view)) zsurf_view_destroy_unbound(view);
 }
 
 static const char* vertex_shader =
@@ -417,12 +1198,97 @@ static const char* vertex_shader =
     "  gl_Position = zMVP * rotate * position;\n"
     "}\n";
 
-static const char* fragment_shader =
-    "#version 410 core\n"
-    "uniform sampler2D userTexture;\n"
-    "in vec2 v2UVcoords;\n"
-    "out vec4 outputColor;\n"
-    "void main()\n"
-    "{\n"
-    "  outputColor = texture(userTexture, v2UVcoords);\n"
-    "}\n";
+// uniforms and the color transform every fragment shader ends with
+#define FRAGMENT_SHADER_PRELUDE                                    \
+  "#version 410 core\n"                                            \
+  "uniform sampler2D userTexture;\n"                               \
+  "uniform vec4 colorMultiply;\n"                                  \
+  "uniform vec4 colorAdd;\n"                                       \
+  "uniform float opacity;\n"                                       \
+  "in vec2 v2UVcoords;\n"                                          \
+  "out vec4 outputColor;\n"                                        \
+  "vec4 colorTransform(vec4 color)\n"                              \
+  "{\n"                                                            \
+  "  color = clamp(color * colorMultiply + colorAdd, 0.0, 1.0);\n" \
+  "  return vec4(color.rgb, color.a * opacity);\n"                 \
+  "}\n"
+
+#define FRAGMENT_SHADER_YUV_PRELUDE                                       \
+  "const mat3 yuvToRgb = mat3(1.164, 1.164, 1.164, 0.0, -0.391, 2.018,\n" \
+  "    1.596, -0.813, 0.0);\n"
+
+static const char* fragment_shaders[ZSURF_VIEW_SHADER_COUNT] = {
+    [ZSURF_VIEW_SHADER_RGBA] =
+        FRAGMENT_SHADER_PRELUDE
+        "void main()\n"
+        "{\n"
+        "  outputColor = colorTransform(texture(userTexture, v2UVcoords));\n"
+        "}\n",
+    [ZSURF_VIEW_SHADER_OPAQUE] =
+        FRAGMENT_SHADER_PRELUDE
+        "void main()\n"
+        "{\n"
+        "  vec3 color = texture(userTexture, v2UVcoords).rgb;\n"
+        "  outputColor = colorTransform(vec4(color, 1.0));\n"
+        "}\n",
+    [ZSURF_VIEW_SHADER_GRAY] =
+        FRAGMENT_SHADER_PRELUDE
+        "void main()\n"
+        "{\n"
+        "  vec3 color = texture(userTexture, v2UVcoords).rrr;\n"
+        "  outputColor = colorTransform(vec4(color, 1.0));\n"
+        "}\n",
+    [ZSURF_VIEW_SHADER_NV12] =
+        FRAGMENT_SHADER_PRELUDE
+        FRAGMENT_SHADER_YUV_PRELUDE
+        "void main()\n"
+        "{\n"
+        "  ivec2 size = textureSize(userTexture, 0);\n"
+        "  int height = size.y * 2 / 3;\n"
+        "  ivec2 p = clamp(ivec2(v2UVcoords * vec2(size.x, height)),\n"
+        "      ivec2(0), ivec2(size.x - 1, height - 1));\n"
+        "  ivec2 c = ivec2(p.x / 2 * 2, height + p.y / 2);\n"
+        "  vec3 yuv = vec3(texelFetch(userTexture, p, 0).r,\n"
+        "      texelFetch(userTexture, c, 0).r,\n"
+        "      texelFetch(userTexture, c + ivec2(1, 0), 0).r);\n"
+        "  yuv -= vec3(16.0 / 255.0, 0.5, 0.5);\n"
+        "  outputColor = colorTransform(vec4(yuvToRgb * yuv, 1.0));\n"
+        "}\n",
+    [ZSURF_VIEW_SHADER_I420] =
+        FRAGMENT_SHADER_PRELUDE
+        FRAGMENT_SHADER_YUV_PRELUDE
+        "void main()\n"
+        "{\n"
+        "  ivec2 size = textureSize(userTexture, 0);\n"
+        "  int height = size.y * 2 / 3;\n"
+        "  ivec2 p = clamp(ivec2(v2UVcoords * vec2(size.x, height)),\n"
+        "      ivec2(0), ivec2(size.x - 1, height - 1));\n"
+        "  ivec2 c = ivec2(p.x / 2, height + p.y / 2);\n"
+        "  vec3 yuv = vec3(texelFetch(userTexture, p, 0).r,\n"
+        "      texelFetch(userTexture, c, 0).r,\n"
+        "      texelFetch(userTexture, c + ivec2(size.x / 2, 0), 0).r);\n"
+        "  yuv -= vec3(16.0 / 255.0, 0.5, 0.5);\n"
+        "  outputColor = colorTransform(vec4(yuvToRgb * yuv, 1.0));\n"
+        "}\n",
+    [ZSURF_VIEW_SHADER_LAYERS] =
+        FRAGMENT_SHADER_PRELUDE
+        "uniform float layerCount;\n"
+        "void main()\n"
+        "{\n"
+        "  int count = max(int(layerCount), 1);\n"
+        "  ivec2 size = textureSize(userTexture, 0);\n"
+        "  int height = size.y / count;\n"
+        "  ivec2 p = clamp(ivec2(v2UVcoords * vec2(size.x, height)),\n"
+        "      ivec2(0), ivec2(size.x - 1, height - 1));\n"
+        "  vec4 color = vec4(0.0);\n"
+        "  for (int i = 0; i < count; i++) {\n"
+        "    ivec2 q = p + ivec2(0, i * height);\n"
+        "    vec4 layer = texelFetch(userTexture, q, 0);\n"
+        "    float a = layer.a + color.a * (1.0 - layer.a);\n"
+        "    vec3 rgb = layer.rgb * layer.a +\n"
+        "        color.rgb * color.a * (1.0 - layer.a);\n"
+        "    color = vec4(a > 0.0 ? rgb / a : vec3(0.0), a);\n"
+        "  }\n"
+        "  outputColor = colorTransform(color);\n"
+        "}\n",
+};